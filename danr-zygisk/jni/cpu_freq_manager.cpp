@@ -1,17 +1,72 @@
 #include "cpu_freq_manager.h"
-#include <fstream>
+#include "stress/monotonic_clock.h"
+#include "stress/sysfs_accessor.h"
+#include "stress/tunable_arbiter.h"
 #include <sstream>
 #include <unistd.h>
 #include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <android/log.h>
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-CPUFreqMgr", __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-CPUFreqMgr", __VA_ARGS__)
 
 namespace danr {
 
+static const std::string CPU_SYSFS = "/sys/devices/system/cpu";
+
+// Writes through sysfs from userspace (PerfHAL, thermal HAL) raise inotify
+// events, but limits the kernel applies itself (thermal cooling devices,
+// freq QoS) change scaling_max_freq silently, so a fallback poll remains.
+// It tightens to the minimum after an override and backs off while quiet.
+static const long MIN_POLL_MS = 50;
+static const long MAX_POLL_MS = 1500;
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "cpufreq";
+
+static void appendLongArray(std::ostringstream& ss, const std::vector<long>& values) {
+    ss << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << values[i];
+    }
+    ss << "]";
+}
+
+static void appendFreqPairs(std::ostringstream& ss, const std::vector<std::pair<long, long>>& pairs) {
+    ss << "[";
+    for (size_t i = 0; i < pairs.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << "{\"freq\":" << pairs[i].first << ",\"ms\":" << pairs[i].second << "}";
+    }
+    ss << "]";
+}
+
+static void appendResidency(std::ostringstream& ss, const FreqResidencyStats& residency) {
+    ss << "{";
+    ss << "\"elapsedMs\":" << residency.elapsedMs << ",";
+    ss << "\"source\":\"" << residency.source << "\",";
+    ss << "\"effectiveFreq\":" << residency.effectiveFreq << ",";
+    ss << "\"meanCapFreq\":" << residency.meanCapFreq << ",";
+    ss << "\"effectiveVsCapPercent\":" << residency.effectiveVsCapPercent << ",";
+    ss << "\"atCapPercent\":" << residency.atCapPercent << ",";
+    ss << "\"transitions\":" << residency.transitions << ",";
+    ss << "\"samples\":" << residency.samples << ",";
+    ss << "\"timeInState\":";
+    appendFreqPairs(ss, residency.timeInStateMs);
+    ss << ",";
+    ss << "\"curFreqHistogram\":";
+    appendFreqPairs(ss, residency.curFreqHistogramMs);
+    ss << "}";
+}
+
 // JSON helper for CPUFreqStatus
 std::string CPUFreqStatus::toJson() const {
     std::ostringstream ss;
@@ -21,14 +76,48 @@ std::string CPUFreqStatus::toJson() const {
     ss << "\"actualMaxFreq\":" << actualMaxFreq << ",";
     ss << "\"originalMaxFreq\":" << originalMaxFreq << ",";
     ss << "\"cores\":" << cores << ",";
-    ss << "\"availableFreqs\":[";
-    for (size_t i = 0; i < availableFreqs.size(); i++) {
+    ss << "\"availableFreqs\":";
+    appendLongArray(ss, availableFreqs);
+    ss << ",";
+    ss << "\"autoRestoreMs\":" << autoRestoreMs << ",";
+    ss << "\"remainingRestoreMs\":" << remainingRestoreMs << ",";
+    ss << "\"enforcement\":\"" << enforcement << "\",";
+    ss << "\"pollIntervalMs\":" << pollIntervalMs << ",";
+    ss << "\"clusters\":[";
+    for (size_t i = 0; i < clusters.size(); i++) {
+        const CPUFreqClusterStatus& cluster = clusters[i];
         if (i > 0) ss << ",";
-        ss << availableFreqs[i];
+        ss << "{";
+        ss << "\"policy\":" << cluster.policy << ",";
+        ss << "\"cpus\":[";
+        for (size_t j = 0; j < cluster.cpus.size(); j++) {
+            if (j > 0) ss << ",";
+            ss << cluster.cpus[j];
+        }
+        ss << "],";
+        ss << "\"isLimited\":" << (cluster.isLimited ? "true" : "false") << ",";
+        ss << "\"targetMaxFreq\":" << cluster.targetMaxFreq << ",";
+        ss << "\"actualMaxFreq\":" << cluster.actualMaxFreq << ",";
+        ss << "\"originalMaxFreq\":" << cluster.originalMaxFreq << ",";
+        ss << "\"availableFreqs\":";
+        appendLongArray(ss, cluster.availableFreqs);
+        ss << ",";
+        ss << "\"overrides\":" << cluster.overrides << ",";
+        ss << "\"overridesSeenByWatch\":" << cluster.overridesSeenByWatch << ",";
+        ss << "\"overridesSeenByPoll\":" << cluster.overridesSeenByPoll << ",";
+        ss << "\"lastOverrideFreq\":" << cluster.lastOverrideFreq << ",";
+        ss << "\"lastOverrideMs\":" << cluster.lastOverrideMs << ",";
+        ss << "\"avgOverrideMs\":" << cluster.avgOverrideMs << ",";
+        ss << "\"maxOverrideMs\":" << cluster.maxOverrideMs << ",";
+        ss << "\"residency\":";
+        if (cluster.hasResidency) {
+            appendResidency(ss, cluster.residency);
+        } else {
+            ss << "null";
+        }
+        ss << "}";
     }
-    ss << "],";
-    ss << "\"autoRestoreMs\":" << autoRestoreMs << ",";
-    ss << "\"remainingRestoreMs\":" << remainingRestoreMs;
+    ss << "]";
     ss << "}";
     return ss.str();
 }
@@ -39,73 +128,124 @@ CPUFreqManager& CPUFreqManager::getInstance() {
 }
 
 CPUFreqManager::CPUFreqManager() {
-    // Read initial original max freq
-    originalMaxFreq_.store(getHardwareMaxFreq(0));
-    LOGD("CPUFreqManager initialized, original max freq: %ld kHz", originalMaxFreq_.load());
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    discoverPolicies();
+    for (const Policy& policy : policies_) {
+        originalMaxFreq_.store(std::max(originalMaxFreq_.load(), policy.hardwareMaxFreq));
+    }
+    LOGD("CPUFreqManager initialized, %zu clusters, original max freq: %ld kHz",
+         policies_.size(), originalMaxFreq_.load());
 }
 
 CPUFreqManager::~CPUFreqManager() {
     stopWorker();
     restore();
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+    }
 }
 
-bool CPUFreqManager::setMaxFrequency(long frequency, const std::vector<int>& cores, long autoRestoreMs) {
+bool CPUFreqManager::setMaxFrequency(long frequency, const std::vector<int>& cores, long autoRestoreMs,
+                                     int policy, int priority) {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    int numCores = getNumCores();
-    std::vector<int> targetCores = cores.empty() ?
-        std::vector<int>() : cores;
-
-    // If no specific cores, target all cores
-    if (targetCores.empty()) {
-        for (int i = 0; i < numCores; i++) {
-            targetCores.push_back(i);
+    // A core can't be limited on its own: the whole policy it belongs to is
+    std::vector<Policy*> targets;
+    for (Policy& candidate : policies_) {
+        bool selected;
+        if (policy >= 0) {
+            selected = candidate.id == policy;
+        } else if (!cores.empty()) {
+            selected = std::any_of(cores.begin(), cores.end(), [&candidate](int cpu) {
+                return std::find(candidate.cpus.begin(), candidate.cpus.end(), cpu) != candidate.cpus.end();
+            });
+        } else {
+            selected = true;
         }
+        if (selected) targets.push_back(&candidate);
     }
 
-    // Save original settings if this is the first time limiting
-    if (!isLimited_.load()) {
-        originalSettings_.clear();
-        for (int cpu : targetCores) {
-            std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                              "/cpufreq/scaling_max_freq";
-            long origFreq = getCurrentMaxFreq(cpu);
-            if (origFreq > 0) {
-                originalSettings_[path] = std::to_string(origFreq);
-            }
+    if (targets.empty()) {
+        LOGE("No cpufreq policy matches the request");
+        return false;
+    }
+
+    // Start the override accounting of clusters limited for the first time
+    // afresh. Their original settings are kept by the arbiter.
+    std::vector<Policy*> fresh;
+    for (Policy* target : targets) {
+        if (!target->isLimited) {
+            fresh.push_back(target);
+            target->overrides = 0;
+            target->overridesSeenByWatch = 0;
+            target->overridesSeenByPoll = 0;
+            target->lastOverrideFreq = 0;
+            target->lastOverrideMs = 0;
+            target->totalOverrideUs = 0;
+            target->maxOverrideUs = 0;
         }
-        originalMaxFreq_.store(getHardwareMaxFreq(0));
     }
 
-    // Apply frequency to all target cores
     bool allSuccess = true;
-    for (int cpu : targetCores) {
-        if (!setCpuMaxFreq(cpu, frequency)) {
-            LOGE("Failed to set frequency for CPU%d", cpu);
+    for (Policy* target : targets) {
+        long clusterFreq = snapFrequency(*target, frequency);
+        if (!setPolicyMaxFreq(*target, clusterFreq, priority)) {
+            LOGE("Failed to set frequency for policy%d", target->id);
             allSuccess = false;
+            continue;
+        }
+        target->isLimited = true;
+        target->targetMaxFreq = clusterFreq;
+        LOGD("Set policy%d (%zu cpus) max frequency to %ld kHz",
+             target->id, target->cpus.size(), clusterFreq);
+    }
+
+    // Residency is measured from the moment the cap is in place
+    for (Policy* target : fresh) {
+        if (target->isLimited) {
+            target->residency->start();
         }
     }
 
     if (allSuccess) {
-        targetCores_ = targetCores;
         targetMaxFreq_.store(frequency);
         autoRestoreMs_.store(autoRestoreMs);
         limitStartTimeMs_.store(getCurrentTimeMs());
-        isLimited_.store(true);
+    }
+    updateSummary();
 
-        LOGD("Set max frequency to %ld kHz for %zu cores, auto-restore: %ld ms",
-             frequency, targetCores.size(), autoRestoreMs);
+    if (isLimited_.load()) {
+        LOGD("Set max frequency to %ld kHz for %zu clusters, auto-restore: %ld ms",
+             frequency, targets.size(), autoRestoreMs);
 
-        // Start worker thread if not running
+        // Start worker thread if not running, otherwise have it watch the
+        // new clusters right away
+        pollIntervalMs_.store(MIN_POLL_MS);
         if (!workerRunning_.load()) {
             startWorker();
+        } else {
+            wakeWorker();
         }
     }
 
     return allSuccess;
 }
 
-bool CPUFreqManager::restore() {
+bool CPUFreqManager::restore(int policy) {
+    if (policy >= 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Policy* target = findPolicy(policy);
+        if (!target) {
+            LOGE("Unknown cpufreq policy %d", policy);
+            return false;
+        }
+        bool success = restorePolicy(*target);
+        updateSummary();
+        // The worker drops the watch, and exits once no cluster is limited
+        wakeWorker();
+        return success;
+    }
+
     // Stop worker thread first (outside of mutex to avoid potential deadlock)
     stopWorker();
 
@@ -117,21 +257,16 @@ bool CPUFreqManager::restore() {
 
     LOGD("Restoring original CPU frequencies");
 
-    // Restore all saved settings
-    for (const auto& kv : originalSettings_) {
-        writeSysFile(kv.first, kv.second);
-        LOGD("Restored %s to %s", kv.first.c_str(), kv.second.c_str());
+    bool allSuccess = true;
+    for (Policy& target : policies_) {
+        if (!restorePolicy(target)) {
+            allSuccess = false;
+        }
     }
-
-    originalSettings_.clear();
-    targetCores_.clear();
-    targetMaxFreq_.store(0);
-    autoRestoreMs_.store(0);
-    limitStartTimeMs_.store(0);
-    isLimited_.store(false);
+    updateSummary();
 
     LOGD("CPU frequencies restored");
-    return true;
+    return allSuccess;
 }
 
 CPUFreqStatus CPUFreqManager::getStatus() const {
@@ -141,8 +276,8 @@ CPUFreqStatus CPUFreqManager::getStatus() const {
     status.targetMaxFreq = targetMaxFreq_.load();
     status.originalMaxFreq = originalMaxFreq_.load();
     status.cores = getNumCores();
-    status.availableFreqs = getAvailableFrequencies(0);
     status.autoRestoreMs = autoRestoreMs_.load();
+    status.actualMaxFreq = 0;
 
     // Calculate remaining restore time
     if (status.isLimited && status.autoRestoreMs > 0) {
@@ -152,15 +287,55 @@ CPUFreqStatus CPUFreqManager::getStatus() const {
         status.remainingRestoreMs = 0;
     }
 
-    // Read actual current max freq (average across cores or just cpu0)
-    status.actualMaxFreq = getCurrentMaxFreq(0);
+    status.enforcement = "poll";
+    status.pollIntervalMs = status.isLimited ? pollIntervalMs_.load() : 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Policy& policy : policies_) {
+        if (policy.isLimited && policy.watch >= 0) {
+            status.enforcement = "watch";
+        }
+
+        CPUFreqClusterStatus cluster;
+        cluster.policy = policy.id;
+        cluster.cpus = policy.cpus;
+        cluster.isLimited = policy.isLimited;
+        cluster.targetMaxFreq = policy.targetMaxFreq;
+        cluster.actualMaxFreq = getCurrentMaxFreq(policy);
+        cluster.originalMaxFreq = policy.hardwareMaxFreq;
+        cluster.availableFreqs = policy.availableFreqs;
+        cluster.overrides = policy.overrides;
+        cluster.overridesSeenByWatch = policy.overridesSeenByWatch;
+        cluster.overridesSeenByPoll = policy.overridesSeenByPoll;
+        cluster.lastOverrideFreq = policy.lastOverrideFreq;
+        cluster.lastOverrideMs = policy.lastOverrideMs;
+        cluster.avgOverrideMs = policy.overrides > 0 ?
+            policy.totalOverrideUs / 1000.0 / policy.overrides : 0;
+        cluster.maxOverrideMs = policy.maxOverrideUs / 1000.0;
+        cluster.hasResidency = policy.residency->started();
+        cluster.residency = policy.residency->stats();
+        status.clusters.push_back(cluster);
+
+        // The summary shows the fastest cluster, and every frequency any
+        // cluster accepts
+        status.actualMaxFreq = std::max(status.actualMaxFreq, cluster.actualMaxFreq);
+        status.availableFreqs.insert(status.availableFreqs.end(),
+                                     policy.availableFreqs.begin(), policy.availableFreqs.end());
+    }
+    std::sort(status.availableFreqs.begin(), status.availableFreqs.end());
+    status.availableFreqs.erase(std::unique(status.availableFreqs.begin(), status.availableFreqs.end()),
+                                status.availableFreqs.end());
 
     return status;
 }
 
 void CPUFreqManager::tick() {
+    enforce(Trigger::Poll, monotonicUs());
+}
+
+bool CPUFreqManager::enforce(Trigger trigger, long triggeredUs) {
     if (!isLimited_.load()) {
-        return;
+        return false;
     }
 
     // Check auto-restore timeout
@@ -170,25 +345,62 @@ void CPUFreqManager::tick() {
         if (elapsed >= autoRestore) {
             LOGD("Auto-restore timeout reached, restoring frequencies");
             restore();
-            return;
+            return false;
         }
     }
 
-    // Re-apply frequency to counter system changes
-    long targetFreq = targetMaxFreq_.load();
-    std::vector<int> cores;
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        cores = targetCores_;
-    }
-
-    for (int cpu : cores) {
-        long currentFreq = getCurrentMaxFreq(cpu);
-        if (currentFreq != targetFreq) {
-            LOGD("CPU%d freq changed to %ld, re-applying %ld", cpu, currentFreq, targetFreq);
-            setCpuMaxFreq(cpu, targetFreq);
+    // Re-apply frequency to counter system changes. The arbiter may hold
+    // the cluster below our target on another controller's behalf; that
+    // isn't an override. Neither is reading back less than is held: since
+    // 5.3 scaling_max_freq shows the policy max after every limit, so a
+    // thermal cooling device clamping below the cap shows up there, and
+    // rewriting the cap can't lift it.
+    TunableArbiter& arbiter = TunableArbiter::getInstance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool overridden = false;
+    long previousCheckUs = lastCheckUs_;
+    for (Policy& policy : policies_) {
+        if (!policy.isLimited) continue;
+        policy.residency->sample();
+        long currentFreq = getCurrentMaxFreq(policy);
+        long heldFreq = arbiter.effectiveLong(policy.scalingMaxFreq->path(), policy.targetMaxFreq);
+        if (currentFreq <= heldFreq) continue;
+
+        arbiter.enforce(policy.scalingMaxFreq->path());
+        long nowUs = monotonicUs();
+
+        // A watched write is timed from its notification; a polled change
+        // happened some time since the last check, so that bounds it
+        long sinceUs = trigger == Trigger::Watch ? triggeredUs : previousCheckUs;
+        long exposureUs = std::max(0L, nowUs - sinceUs);
+
+        overridden = true;
+        policy.overrides++;
+        if (trigger == Trigger::Watch) {
+            policy.overridesSeenByWatch++;
+        } else {
+            policy.overridesSeenByPoll++;
         }
+        policy.lastOverrideFreq = currentFreq;
+        policy.lastOverrideMs = getCurrentTimeMs();
+        policy.totalOverrideUs += exposureUs;
+        policy.maxOverrideUs = std::max(policy.maxOverrideUs, exposureUs);
+
+        LOGD("policy%d freq changed to %ld (%s), re-applied %ld after %ld us",
+             policy.id, currentFreq, trigger == Trigger::Watch ? "watch" : "poll",
+             heldFreq, exposureUs);
     }
+    lastCheckUs_ = monotonicUs();
+
+    // The rewrites above raised IN_MODIFY on the watches too; left queued,
+    // they would wake the worker for a pass with nothing to do. The event
+    // is queued by the time write() returns, so this drops only our own
+    // (and anything racing it, which the next poll still catches).
+    if (overridden && inotifyFd_ >= 0) {
+        char events[4096];
+        while (read(inotifyFd_, events, sizeof(events)) > 0) {}
+    }
+    return overridden;
 }
 
 void CPUFreqManager::startWorker() {
@@ -207,28 +419,107 @@ void CPUFreqManager::startWorker() {
 }
 
 void CPUFreqManager::stopWorker() {
-    if (!workerRunning_.load()) {
+    // Auto-restore runs on the worker itself, which can't join itself; it
+    // is joined by the next start or stop instead
+    if (workerThread_.get_id() == std::this_thread::get_id()) {
+        workerRunning_.store(false);
         return;
     }
 
-    workerRunning_.store(false);
+    bool wasRunning = workerRunning_.exchange(false);
+    wakeWorker();
     if (workerThread_.joinable()) {
         workerThread_.join();
     }
-    LOGD("Worker thread stopped");
+    if (wasRunning) {
+        LOGD("Worker thread stopped");
+    }
+}
+
+void CPUFreqManager::wakeWorker() {
+    if (wakeFd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void CPUFreqManager::updateWatches() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Policy& policy : policies_) {
+        if (policy.isLimited && policy.watch < 0 && inotifyFd_ >= 0) {
+            const std::string& path = policy.scalingMaxFreq->path();
+            policy.watch = inotify_add_watch(inotifyFd_, path.c_str(), IN_MODIFY);
+            if (policy.watch < 0) {
+                LOGE("Cannot watch %s: %s, polling only", path.c_str(), strerror(errno));
+            }
+        } else if (!policy.isLimited && policy.watch >= 0) {
+            inotify_rm_watch(inotifyFd_, policy.watch);
+            policy.watch = -1;
+        }
+    }
 }
 
 void CPUFreqManager::workerFunction() {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        LOGE("inotify unavailable: %s, polling only", strerror(errno));
+    }
+    lastCheckUs_ = monotonicUs();
+
     while (workerRunning_.load()) {
-        tick();
+        updateWatches();
+
+        long timeoutMs = pollIntervalMs_.load();
+        long autoRestore = autoRestoreMs_.load();
+        if (autoRestore > 0) {
+            long remaining = autoRestore - (getCurrentTimeMs() - limitStartTimeMs_.load());
+            timeoutMs = std::max(0L, std::min(timeoutMs, remaining));
+        }
+
+        struct pollfd fds[2] = {
+            { inotifyFd_, POLLIN, 0 },
+            { wakeFd_, POLLIN, 0 },
+        };
+        int ready = poll(fds, 2, static_cast<int>(timeoutMs));
+        long triggeredUs = monotonicUs();
+
+        bool watched = false;
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            char events[4096];
+            while (read(inotifyFd_, events, sizeof(events)) > 0) {}
+            watched = true;
+        }
+        if (ready > 0 && (fds[1].revents & POLLIN)) {
+            uint64_t count;
+            ssize_t ignored = read(wakeFd_, &count, sizeof(count));
+            (void)ignored;
+        }
+        if (!workerRunning_.load()) {
+            break;
+        }
+
+        bool overridden = enforce(watched ? Trigger::Watch : Trigger::Poll, triggeredUs);
 
         // If no longer limited, stop the worker
         if (!isLimited_.load()) {
             break;
         }
 
-        // Sleep for 1.5 seconds before next tick
-        usleep(1500000);
+        // Someone fighting the limit tends to do it again soon
+        long interval = overridden ? MIN_POLL_MS : std::min(pollIntervalMs_.load() * 2, MAX_POLL_MS);
+        pollIntervalMs_.store(interval);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Policy& policy : policies_) {
+            policy.watch = -1;
+        }
+        if (inotifyFd_ >= 0) {
+            close(inotifyFd_);
+            inotifyFd_ = -1;
+        }
     }
 
     workerRunning_.store(false);
@@ -237,7 +528,7 @@ void CPUFreqManager::workerFunction() {
 
 int CPUFreqManager::getNumCores() const {
     int count = 0;
-    DIR* dir = opendir("/sys/devices/system/cpu/");
+    DIR* dir = opendir(CPU_SYSFS.c_str());
     if (dir) {
         struct dirent* entry;
         while ((entry = readdir(dir)) != nullptr) {
@@ -254,89 +545,167 @@ int CPUFreqManager::getNumCores() const {
     return count > 0 ? count : sysconf(_SC_NPROCESSORS_CONF);
 }
 
-long CPUFreqManager::getCurrentMaxFreq(int cpu) const {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_max_freq";
-    std::string value = readSysFile(path);
-    if (value.empty()) return 0;
-    try {
-        return std::stol(value);
-    } catch (...) {
-        LOGE("Failed to parse frequency from %s: %s", path.c_str(), value.c_str());
-        return 0;
+void CPUFreqManager::discoverPolicies() {
+    policies_.clear();
+
+    DIR* dir = opendir((CPU_SYSFS + "/cpufreq").c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strncmp(entry->d_name, "policy", 6) != 0) continue;
+            char* endptr;
+            long id = strtol(entry->d_name + 6, &endptr, 10);
+            if (*endptr != '\0' || id < 0) continue;
+
+            Policy policy;
+            policy.id = static_cast<int>(id);
+            policy.path = CPU_SYSFS + "/cpufreq/" + entry->d_name;
+            policies_.push_back(std::move(policy));
+        }
+        closedir(dir);
     }
-}
 
-long CPUFreqManager::getHardwareMaxFreq(int cpu) const {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/cpuinfo_max_freq";
-    std::string value = readSysFile(path);
-    if (value.empty()) return 0;
-    try {
-        return std::stol(value);
-    } catch (...) {
-        LOGE("Failed to parse hardware max freq from %s: %s", path.c_str(), value.c_str());
-        return 0;
+    // Kernels before 4.3 have no policy directories; each cpuN/cpufreq is a
+    // link into its policy owner's, so keep one per distinct related_cpus
+    if (policies_.empty()) {
+        int numCores = getNumCores();
+        std::vector<bool> covered(static_cast<size_t>(numCores), false);
+        for (int cpu = 0; cpu < numCores; cpu++) {
+            if (covered[static_cast<size_t>(cpu)]) continue;
+            std::string path = CPU_SYSFS + "/cpu" + std::to_string(cpu) + "/cpufreq";
+            if (SysfsAccessor::readFile(path + "/cpuinfo_max_freq").empty()) continue;
+
+            Policy policy;
+            policy.id = cpu;
+            policy.path = path;
+            policies_.push_back(std::move(policy));
+            for (int related : SysfsAccessor::parseCpuList(SysfsAccessor::readFile(path + "/related_cpus"))) {
+                if (related >= 0 && related < numCores) covered[static_cast<size_t>(related)] = true;
+            }
+        }
     }
-}
 
-std::vector<long> CPUFreqManager::getAvailableFrequencies(int cpu) const {
-    std::vector<long> freqs;
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_available_frequencies";
-    std::string value = readSysFile(path);
+    for (Policy& policy : policies_) {
+        policy.cpus = SysfsAccessor::parseCpuList(SysfsAccessor::readFile(policy.path + "/related_cpus"));
+        if (policy.cpus.empty()) {
+            policy.cpus = SysfsAccessor::parseCpuList(SysfsAccessor::readFile(policy.path + "/affected_cpus"));
+        }
+        policy.scalingMaxFreq = SysfsAccessor::getInstance().attribute(policy.path + "/scaling_max_freq");
+        policy.residency.reset(new FreqResidency(policy.path));
+        policy.hardwareMinFreq = readFreq(policy.path + "/cpuinfo_min_freq");
+        policy.hardwareMaxFreq = readFreq(policy.path + "/cpuinfo_max_freq");
 
-    if (!value.empty()) {
-        std::istringstream iss(value);
+        std::istringstream iss(SysfsAccessor::readFile(policy.path + "/scaling_available_frequencies"));
         long freq;
         while (iss >> freq) {
-            freqs.push_back(freq);
+            policy.availableFreqs.push_back(freq);
         }
-        std::sort(freqs.begin(), freqs.end());
+        std::sort(policy.availableFreqs.begin(), policy.availableFreqs.end());
+
+        LOGD("policy%d: %zu cpus, %ld-%ld kHz, %zu frequencies", policy.id, policy.cpus.size(),
+             policy.hardwareMinFreq, policy.hardwareMaxFreq, policy.availableFreqs.size());
     }
 
-    return freqs;
+    std::sort(policies_.begin(), policies_.end(), [](const Policy& a, const Policy& b) {
+        return a.id < b.id;
+    });
 }
 
-bool CPUFreqManager::setCpuMaxFreq(int cpu, long frequency) {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_max_freq";
-    return writeSysFile(path, std::to_string(frequency));
+CPUFreqManager::Policy* CPUFreqManager::findPolicy(int id) {
+    for (Policy& policy : policies_) {
+        if (policy.id == id) return &policy;
+    }
+    return nullptr;
 }
 
-std::string CPUFreqManager::readSysFile(const std::string& path) const {
-    std::ifstream file(path);
-    if (!file.is_open()) return "";
+long CPUFreqManager::readFreq(const std::string& path) const {
+    std::string value = SysfsAccessor::readFile(path);
+    if (value.empty()) return 0;
+    try {
+        return std::stol(value);
+    } catch (...) {
+        LOGE("Failed to parse frequency from %s: %s", path.c_str(), value.c_str());
+        return 0;
+    }
+}
 
-    std::string content;
-    std::getline(file, content);
+long CPUFreqManager::getCurrentMaxFreq(const Policy& policy) const {
+    return policy.scalingMaxFreq->readLong(0L);
+}
 
-    // Trim whitespace
-    size_t start = content.find_first_not_of(" \t\n\r");
-    size_t end = content.find_last_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
+long CPUFreqManager::snapFrequency(const Policy& policy, long frequency) const {
+    // Highest step not above the request; a request below the table gets
+    // the lowest step, since the cluster can't go any slower
+    if (!policy.availableFreqs.empty()) {
+        auto it = std::upper_bound(policy.availableFreqs.begin(), policy.availableFreqs.end(), frequency);
+        return it == policy.availableFreqs.begin() ? policy.availableFreqs.front() : *(it - 1);
+    }
 
-    return content.substr(start, end - start + 1);
+    // Drivers without a table (e.g. intel_pstate) take anything in range
+    long snapped = frequency;
+    if (policy.hardwareMaxFreq > 0) snapped = std::min(snapped, policy.hardwareMaxFreq);
+    if (policy.hardwareMinFreq > 0) snapped = std::max(snapped, policy.hardwareMinFreq);
+    return snapped;
 }
 
-bool CPUFreqManager::writeSysFile(const std::string& path, const std::string& value) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        LOGE("Failed to open %s for writing", path.c_str());
-        return false;
+bool CPUFreqManager::capFor(const std::string& owner, long frequency, const std::vector<int>& cores,
+                            std::vector<std::string>* paths, int priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bool anyCapped = false;
+    bool allSuccess = true;
+    for (const Policy& policy : policies_) {
+        bool selected = std::any_of(cores.begin(), cores.end(), [&policy](int cpu) {
+            return std::find(policy.cpus.begin(), policy.cpus.end(), cpu) != policy.cpus.end();
+        });
+        if (!selected) continue;
+
+        const std::string& path = policy.scalingMaxFreq->path();
+        if (TunableArbiter::getInstance().request(path, owner, snapFrequency(policy, frequency),
+                                                  TunableCombine::Min, priority)) {
+            paths->push_back(path);
+            anyCapped = true;
+        } else {
+            LOGE("Failed to cap policy%d for %s", policy.id, owner.c_str());
+            allSuccess = false;
+        }
     }
+    return anyCapped && allSuccess;
+}
 
-    file << value;
-    bool success = file.good();
-    file.close();
+bool CPUFreqManager::setPolicyMaxFreq(const Policy& policy, long frequency, int priority) {
+    return TunableArbiter::getInstance().request(policy.scalingMaxFreq->path(), ARBITER_OWNER, frequency,
+                                                 TunableCombine::Min, priority);
+}
 
-    if (!success) {
-        LOGE("Failed to write to %s", path.c_str());
+bool CPUFreqManager::restorePolicy(Policy& policy) {
+    if (!policy.isLimited) {
+        return true;
     }
 
+    policy.residency->stop();
+
+    // Back to the original value, or to another controller's cap
+    bool success = TunableArbiter::getInstance().release(policy.scalingMaxFreq->path(), ARBITER_OWNER);
+    LOGD("Released policy%d", policy.id);
+
+    policy.isLimited = false;
+    policy.targetMaxFreq = 0;
     return success;
 }
 
+void CPUFreqManager::updateSummary() {
+    bool anyLimited = std::any_of(policies_.begin(), policies_.end(), [](const Policy& policy) {
+        return policy.isLimited;
+    });
+    isLimited_.store(anyLimited);
+    if (!anyLimited) {
+        targetMaxFreq_.store(0);
+        autoRestoreMs_.store(0);
+        limitStartTimeMs_.store(0);
+    }
+}
+
 long CPUFreqManager::getCurrentTimeMs() const {
     auto now = std::chrono::system_clock::now();
     auto duration = now.time_since_epoch();
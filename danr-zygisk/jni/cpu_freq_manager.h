@@ -1,14 +1,45 @@
 #pragma once
 
+#include "stress/freq_residency.h"
 #include <string>
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
-#include <map>
 #include <mutex>
 
 namespace danr {
 
+class SysfsAttribute;
+
+// One cpufreq policy (frequency domain): all CPUs in it share a clock, so
+// limits are written once per policy rather than once per core
+struct CPUFreqClusterStatus {
+    int policy;
+    std::vector<int> cpus;
+    bool isLimited;
+    long targetMaxFreq;
+    long actualMaxFreq;
+    long originalMaxFreq;
+    std::vector<long> availableFreqs;
+
+    // Someone else (PerfHAL, a boost daemon, ...) raising the limit while
+    // we hold it, and how long each override stood. Reading back lower is
+    // a kernel clamp (e.g. thermal) and not counted.
+    long overrides;
+    long overridesSeenByWatch;
+    long overridesSeenByPoll;
+    long lastOverrideFreq;
+    long lastOverrideMs;
+    double avgOverrideMs;
+    double maxOverrideMs;
+
+    // Frequencies the cluster actually ran at since it was last limited,
+    // up to its restore
+    bool hasResidency;
+    FreqResidencyStats residency;
+};
+
 struct CPUFreqStatus {
     bool isLimited;
     long targetMaxFreq;
@@ -18,6 +49,9 @@ struct CPUFreqStatus {
     std::vector<long> availableFreqs;
     long autoRestoreMs;
     long remainingRestoreMs;
+    std::string enforcement;    // "watch" (inotify plus fallback poll) or "poll"
+    long pollIntervalMs;
+    std::vector<CPUFreqClusterStatus> clusters;
 
     std::string toJson() const;
 };
@@ -26,17 +60,31 @@ class CPUFreqManager {
 public:
     static CPUFreqManager& getInstance();
 
-    // Set max frequency for all cores (or specified cores)
+    // Set max frequency for all clusters (or the clusters containing the
+    // specified cores, or a single policy when policy >= 0). Each cluster
+    // gets the highest frequency from its own table not above the request.
     // autoRestoreMs: 0 = no auto-restore, >0 = auto-restore after this many ms
-    bool setMaxFrequency(long frequency, const std::vector<int>& cores = {}, long autoRestoreMs = 0);
+    // priority: against other controllers' caps (see TunableArbiter); at
+    // equal priority the lowest cap wins
+    bool setMaxFrequency(long frequency, const std::vector<int>& cores = {}, long autoRestoreMs = 0,
+                         int policy = -1, int priority = 0);
 
-    // Restore original frequency
-    bool restore();
+    // Restore original frequency of every cluster, or only of one policy
+    bool restore(int policy = -1);
+
+    // Caps the clusters of cores on another controller's behalf, under its
+    // own arbiter owner, leaving this manager's limit and enforcement
+    // alone. The scaling_max_freq files requested are appended to paths;
+    // release them from the arbiter with the same owner to undo.
+    bool capFor(const std::string& owner, long frequency, const std::vector<int>& cores,
+                std::vector<std::string>* paths, int priority = 0);
 
     // Get current status
     CPUFreqStatus getStatus() const;
 
-    // Called by webserver to update state (re-apply frequency, check timeouts)
+    // Re-applies overridden limits and checks the auto-restore timeout.
+    // The worker calls this whenever a watched file changes, and on an
+    // adaptive fallback interval for changes the kernel makes internally.
     void tick();
 
 private:
@@ -47,6 +95,32 @@ private:
     CPUFreqManager(const CPUFreqManager&) = delete;
     CPUFreqManager& operator=(const CPUFreqManager&) = delete;
 
+    struct Policy {
+        int id;
+        std::string path;               // .../cpufreq/policyN or .../cpuN/cpufreq
+        std::vector<int> cpus;          // related_cpus
+        long hardwareMinFreq = 0;
+        long hardwareMaxFreq = 0;
+        std::vector<long> availableFreqs;
+
+        bool isLimited = false;
+        long targetMaxFreq = 0;
+        SysfsAttribute* scalingMaxFreq = nullptr;
+        int watch = -1;                 // inotify watch on scaling_max_freq
+
+        long overrides = 0;
+        long overridesSeenByWatch = 0;
+        long overridesSeenByPoll = 0;
+        long lastOverrideFreq = 0;
+        long lastOverrideMs = 0;
+        long totalOverrideUs = 0;
+        long maxOverrideUs = 0;
+
+        std::unique_ptr<FreqResidency> residency;
+    };
+
+    enum class Trigger { Poll, Watch };
+
     // State
     mutable std::mutex mutex_;
     std::atomic<bool> isLimited_{false};
@@ -54,29 +128,35 @@ private:
     std::atomic<long> originalMaxFreq_{0};
     std::atomic<long> autoRestoreMs_{0};
     std::atomic<long> limitStartTimeMs_{0};
-    std::vector<int> targetCores_;
-    std::map<std::string, std::string> originalSettings_;
+    std::vector<Policy> policies_;
 
     // Background thread for re-applying frequency
     std::thread workerThread_;
     std::atomic<bool> workerRunning_{false};
+    std::atomic<long> pollIntervalMs_{0};
+    int inotifyFd_ = -1;    // Owned by the worker
+    int wakeFd_ = -1;       // eventfd: limits changed or worker should stop
+    long lastCheckUs_ = 0;
 
     void startWorker();
     void stopWorker();
+    void wakeWorker();
     void workerFunction();
+    void updateWatches();
+    bool enforce(Trigger trigger, long triggeredUs);
 
     // CPU control functions
     int getNumCores() const;
-    long getCurrentMaxFreq(int cpu) const;
-    long getHardwareMaxFreq(int cpu) const;
-    std::vector<long> getAvailableFrequencies(int cpu) const;
-    bool setCpuMaxFreq(int cpu, long frequency);
-
-    // File helpers
-    std::string readSysFile(const std::string& path) const;
-    bool writeSysFile(const std::string& path, const std::string& value);
-
-    // Time helper
+    void discoverPolicies();
+    Policy* findPolicy(int id);
+    long readFreq(const std::string& path) const;
+    long getCurrentMaxFreq(const Policy& policy) const;
+    long snapFrequency(const Policy& policy, long frequency) const;
+    bool setPolicyMaxFreq(const Policy& policy, long frequency, int priority);
+    bool restorePolicy(Policy& policy);
+    void updateSummary();
+
+    // Time helpers
     long getCurrentTimeMs() const;
 };
 
@@ -0,0 +1,231 @@
+#include "cpuidle_controller.h"
+#include "stress/monotonic_clock.h"
+#include "stress/sysfs_accessor.h"
+#include "stress/tunable_arbiter.h"
+#include <sstream>
+#include <unistd.h>
+#include <dirent.h>
+#include <android/log.h>
+#include <algorithm>
+#include <cstring>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-CpuIdle", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-CpuIdle", __VA_ARGS__)
+
+namespace danr {
+
+static const std::string CPU_SYSFS = "/sys/devices/system/cpu";
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "cpuidle";
+
+// Counters a kernel doesn't have stay at -1
+static long readCounter(SysfsAttribute* attribute) {
+    return attribute ? attribute->readLong(-1L) : -1;
+}
+
+std::string CpuIdleStatus::toJson() const {
+    std::ostringstream ss;
+    ss << "{";
+    ss << "\"driver\":\"" << driver << "\",";
+    ss << "\"governor\":\"" << governor << "\",";
+    ss << "\"windowMs\":" << windowMs << ",";
+    ss << "\"cores\":[";
+    for (size_t i = 0; i < cores.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << "{\"cpu\":" << cores[i].cpu << ",\"states\":[";
+        for (size_t j = 0; j < cores[i].states.size(); j++) {
+            const CpuIdleStateStatus& state = cores[i].states[j];
+            if (j > 0) ss << ",";
+            ss << "{";
+            ss << "\"index\":" << state.index << ",";
+            ss << "\"name\":\"" << state.name << "\",";
+            ss << "\"latencyUs\":" << state.latencyUs << ",";
+            ss << "\"residencyUs\":" << state.residencyUs << ",";
+            ss << "\"disabled\":" << (state.disabled ? "true" : "false") << ",";
+            ss << "\"isHeld\":" << (state.isHeld ? "true" : "false") << ",";
+            ss << "\"usage\":" << state.usage << ",";
+            ss << "\"timeUs\":" << state.timeUs << ",";
+            ss << "\"above\":" << state.above << ",";
+            ss << "\"below\":" << state.below << ",";
+            ss << "\"avgResidencyUs\":" << state.avgResidencyUs;
+            ss << "}";
+        }
+        ss << "]}";
+    }
+    ss << "]";
+    ss << "}";
+    return ss.str();
+}
+
+CpuIdleController& CpuIdleController::getInstance() {
+    static CpuIdleController instance;
+    return instance;
+}
+
+CpuIdleController::CpuIdleController() {
+    discover();
+    startWindow();
+}
+
+void CpuIdleController::discover() {
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+    for (int cpu : SysfsAccessor::parseCpuList(SysfsAccessor::readFile(CPU_SYSFS + "/present"))) {
+        Core core;
+        core.cpu = cpu;
+
+        std::string idlePath = CPU_SYSFS + "/cpu" + std::to_string(cpu) + "/cpuidle";
+        DIR* dir = opendir(idlePath.c_str());
+        if (!dir) continue;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strncmp(entry->d_name, "state", 5) != 0) continue;
+            char* endptr;
+            long index = strtol(entry->d_name + 5, &endptr, 10);
+            if (*endptr != '\0' || index < 0) continue;
+
+            std::string path = idlePath + "/" + entry->d_name;
+            State state;
+            state.index = static_cast<int>(index);
+            state.name = SysfsAccessor::readFile(path + "/name");
+            state.latencyUs = atol(SysfsAccessor::readFile(path + "/latency").c_str());
+            state.residencyUs = atol(SysfsAccessor::readFile(path + "/residency").c_str());
+            state.disablePath = path + "/disable";
+            state.usage = sysfs.attribute(path + "/usage");
+            state.time = sysfs.attribute(path + "/time");
+            // 5.x kernels and later
+            if (access((path + "/above").c_str(), F_OK) == 0) state.above = sysfs.attribute(path + "/above");
+            if (access((path + "/below").c_str(), F_OK) == 0) state.below = sysfs.attribute(path + "/below");
+            core.states.push_back(state);
+        }
+        closedir(dir);
+
+        std::sort(core.states.begin(), core.states.end(), [](const State& a, const State& b) {
+            return a.index < b.index;
+        });
+        if (!core.states.empty()) cores_.push_back(core);
+    }
+
+    LOGD("%zu cores with cpuidle states, driver %s", cores_.size(),
+         SysfsAccessor::readFile(CPU_SYSFS + "/cpuidle/current_driver").c_str());
+}
+
+std::vector<CpuIdleController::Core*> CpuIdleController::selectCores(const CpuIdleConfig& config) {
+    std::vector<int> cpus = config.cores;
+    if (cpus.empty() && config.policy >= 0) {
+        std::string policyPath = CPU_SYSFS + "/cpufreq/policy" + std::to_string(config.policy);
+        cpus = SysfsAccessor::parseCpuList(SysfsAccessor::readFile(policyPath + "/related_cpus"));
+        if (cpus.empty()) {
+            LOGE("No cpufreq policy %d", config.policy);
+            return {};
+        }
+    }
+
+    std::vector<Core*> selected;
+    for (Core& core : cores_) {
+        if (cpus.empty() || std::find(cpus.begin(), cpus.end(), core.cpu) != cpus.end()) {
+            selected.push_back(&core);
+        }
+    }
+    return selected;
+}
+
+bool CpuIdleController::set(const CpuIdleConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (config.states.empty() && config.minLatencyUs <= 0) {
+        LOGE("No idle states selected");
+        return false;
+    }
+
+    bool matched = false;
+    bool success = true;
+    for (Core* core : selectCores(config)) {
+        for (State& state : core->states) {
+            bool picked = config.minLatencyUs > 0 ?
+                state.latencyUs >= config.minLatencyUs :
+                std::find(config.states.begin(), config.states.end(), state.index) != config.states.end();
+            if (!picked) continue;
+            matched = true;
+
+            if (TunableArbiter::getInstance().request(state.disablePath, ARBITER_OWNER, config.disable ? "1" : "0",
+                                                      TunableCombine::Max, config.priority)) {
+                state.isHeld = true;
+            } else {
+                success = false;
+            }
+        }
+    }
+
+    if (!matched) {
+        LOGE("No idle state matches");
+        return false;
+    }
+    startWindow();
+    return success;
+}
+
+bool CpuIdleController::restore(const CpuIdleConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool success = true;
+    for (Core* core : selectCores(config)) {
+        for (State& state : core->states) {
+            if (!state.isHeld) continue;
+            if (!TunableArbiter::getInstance().release(state.disablePath, ARBITER_OWNER)) success = false;
+            state.isHeld = false;
+        }
+    }
+    startWindow();
+    return success;
+}
+
+void CpuIdleController::startWindow() {
+    for (Core& core : cores_) {
+        for (State& state : core.states) {
+            state.baseUsage = readCounter(state.usage);
+            state.baseTime = readCounter(state.time);
+            state.baseAbove = readCounter(state.above);
+            state.baseBelow = readCounter(state.below);
+        }
+    }
+    windowStartMs_ = monotonicMs();
+}
+
+CpuIdleStatus CpuIdleController::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CpuIdleStatus status;
+    status.driver = SysfsAccessor::readFile(CPU_SYSFS + "/cpuidle/current_driver");
+    status.governor = SysfsAccessor::readFile(CPU_SYSFS + "/cpuidle/current_governor_ro");
+    if (status.governor.empty()) {
+        status.governor = SysfsAccessor::readFile(CPU_SYSFS + "/cpuidle/current_governor");
+    }
+    status.windowMs = monotonicMs() - windowStartMs_;
+
+    auto delta = [](SysfsAttribute* attribute, long base) {
+        long value = readCounter(attribute);
+        return value >= 0 && base >= 0 ? std::max(0L, value - base) : -1L;
+    };
+
+    for (Core& core : cores_) {
+        CpuIdleCoreStatus coreStatus;
+        coreStatus.cpu = core.cpu;
+        for (State& state : core.states) {
+            CpuIdleStateStatus entry;
+            entry.index = state.index;
+            entry.name = state.name;
+            entry.latencyUs = state.latencyUs;
+            entry.residencyUs = state.residencyUs;
+            entry.disabled = SysfsAccessor::readFile(state.disablePath) == "1";
+            entry.isHeld = state.isHeld;
+            entry.usage = delta(state.usage, state.baseUsage);
+            entry.timeUs = delta(state.time, state.baseTime);
+            entry.above = delta(state.above, state.baseAbove);
+            entry.below = delta(state.below, state.baseBelow);
+            entry.avgResidencyUs = entry.usage > 0 ? static_cast<double>(entry.timeUs) / entry.usage : 0;
+            coreStatus.states.push_back(entry);
+        }
+        status.cores.push_back(coreStatus);
+    }
+    return status;
+}
+
+} // namespace danr
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace danr {
+
+class SysfsAttribute;
+
+// Which idle states of which cores to change. States are picked by index,
+// or by exit latency: minLatencyUs > 0 picks every state at least that
+// slow to leave, i.e. everything deeper than a shallow one.
+struct CpuIdleConfig {
+    std::vector<int> cores;     // Empty: all, unless policy is set
+    int policy = -1;            // Every core of this cpufreq policy
+    std::vector<int> states;
+    long minLatencyUs = 0;
+    bool disable = true;
+    int priority = 0;           // Against other controllers (TunableArbiter)
+};
+
+// Counters are deltas over the current window, which starts at each set
+// and restore, so consecutive windows compare states disabled and enabled
+struct CpuIdleStateStatus {
+    int index;
+    std::string name;
+    long latencyUs;             // Exit latency
+    long residencyUs;           // Target residency
+    bool disabled;
+    bool isHeld;                // Disabled or enabled by this controller
+    long usage;                 // Entries
+    long timeUs;
+    long above;                 // Too deep: woken before the target residency
+    long below;                 // Too shallow: a deeper state would have paid
+                                // off. Both -1 before 5.x kernels.
+    double avgResidencyUs;
+};
+
+struct CpuIdleCoreStatus {
+    int cpu;
+    std::vector<CpuIdleStateStatus> states;
+};
+
+struct CpuIdleStatus {
+    std::string driver;
+    std::string governor;
+    long windowMs;
+    std::vector<CpuIdleCoreStatus> cores;
+
+    std::string toJson() const;
+};
+
+// Enables and disables cpuidle states per core, so deep states' exit
+// latency can be taken out of (or put back into) the wakeup path. The
+// disable files go through the TunableArbiter, where disabling wins over
+// enabling, and are journaled like the other tunables.
+class CpuIdleController {
+public:
+    static CpuIdleController& getInstance();
+
+    // Returns false if nothing matched or a write failed
+    bool set(const CpuIdleConfig& config);
+
+    // Hands back the states of the selected cores (config.states and
+    // minLatencyUs are ignored)
+    bool restore(const CpuIdleConfig& config);
+
+    CpuIdleStatus getStatus();
+
+private:
+    CpuIdleController();
+    CpuIdleController(const CpuIdleController&) = delete;
+    CpuIdleController& operator=(const CpuIdleController&) = delete;
+
+    struct State {
+        int index;
+        std::string name;
+        long latencyUs;
+        long residencyUs;
+        std::string disablePath;
+        bool isHeld = false;
+        SysfsAttribute* usage = nullptr;
+        SysfsAttribute* time = nullptr;
+        SysfsAttribute* above = nullptr;
+        SysfsAttribute* below = nullptr;
+        long baseUsage = 0;
+        long baseTime = 0;
+        long baseAbove = 0;
+        long baseBelow = 0;
+    };
+
+    struct Core {
+        int cpu;
+        std::vector<State> states;
+    };
+
+    std::mutex mutex_;
+    std::vector<Core> cores_;
+    long windowStartMs_ = 0;
+
+    void discover();
+    std::vector<Core*> selectCores(const CpuIdleConfig& config);
+    void startWindow();
+};
+
+} // namespace danr
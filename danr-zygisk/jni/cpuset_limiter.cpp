@@ -0,0 +1,305 @@
+#include "cpuset_limiter.h"
+#include "stress/sysfs_accessor.h"
+#include "stress/tunable_arbiter.h"
+#include <sstream>
+#include <unistd.h>
+#include <dirent.h>
+#include <android/log.h>
+#include <algorithm>
+#include <iterator>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-CpusetLimiter", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-CpusetLimiter", __VA_ARGS__)
+
+namespace danr {
+
+static const std::string CPU_SYSFS = "/sys/devices/system/cpu";
+
+// Android mounts cpuset as v1 with noprefix; a unified hierarchy only
+// counts if the cpuset controller is enabled in it
+static const char* CPUSET_V1_ROOT = "/dev/cpuset";
+static const char* CGROUP_V2_ROOT = "/sys/fs/cgroup";
+
+static const char* DEFAULT_GROUPS[] = { "top-app", "foreground", "background" };
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "cpuset";
+
+static std::string formatCpuList(const std::vector<int>& cpus) {
+    // Sorted input; the kernel prints masks the same way, so a mask read
+    // back compares equal to the one written
+    std::ostringstream ss;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t end = i;
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) end++;
+        if (i > 0) ss << ",";
+        ss << cpus[i];
+        if (end > i) ss << "-" << cpus[end];
+        i = end + 1;
+    }
+    return ss.str();
+}
+
+static void appendIntArray(std::ostringstream& ss, const std::vector<int>& values) {
+    ss << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << values[i];
+    }
+    ss << "]";
+}
+
+std::string CpusetLimitStatus::toJson() const {
+    std::ostringstream ss;
+    ss << "{";
+    ss << "\"isLimited\":" << (isLimited ? "true" : "false") << ",";
+    ss << "\"hierarchy\":\"" << hierarchy << "\",";
+    ss << "\"totalCores\":" << totalCores << ",";
+    ss << "\"cpus\":";
+    appendIntArray(ss, cpus);
+    ss << ",";
+    ss << "\"groups\":[";
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << "{\"name\":\"" << groups[i].name << "\",\"cpus\":\"" << groups[i].cpus
+           << "\",\"isLimited\":" << (groups[i].isLimited ? "true" : "false") << "}";
+    }
+    ss << "]";
+    ss << "}";
+    return ss.str();
+}
+
+CpusetLimiter& CpusetLimiter::getInstance() {
+    static CpusetLimiter instance;
+    return instance;
+}
+
+CpusetLimiter::CpusetLimiter() {
+    detectHierarchy();
+}
+
+void CpusetLimiter::detectHierarchy() {
+    std::string v1 = CPUSET_V1_ROOT;
+    if (access((v1 + "/cpus").c_str(), F_OK) == 0) {
+        root_ = v1;
+        cpusFile_ = "cpus";
+    } else if (access((v1 + "/cpuset.cpus").c_str(), F_OK) == 0) {
+        root_ = v1;
+        cpusFile_ = "cpuset.cpus";
+    } else {
+        std::istringstream controllers(SysfsAccessor::readFile(std::string(CGROUP_V2_ROOT) + "/cgroup.controllers"));
+        std::string controller;
+        while (controllers >> controller) {
+            if (controller != "cpuset") continue;
+            root_ = CGROUP_V2_ROOT;
+            cpusFile_ = "cpuset.cpus";
+            isV2_ = true;
+        }
+    }
+
+    if (root_.empty()) {
+        LOGE("No cpuset hierarchy found");
+    } else {
+        LOGD("cpuset %s at %s", isV2_ ? "v2" : "v1", root_.c_str());
+    }
+}
+
+std::vector<int> CpusetLimiter::coresBySpeed() {
+    std::vector<int> cores = SysfsAccessor::parseCpuList(SysfsAccessor::readFile(CPU_SYSFS + "/present"));
+    if (cores.empty()) {
+        for (int cpu = 0; access((CPU_SYSFS + "/cpu" + std::to_string(cpu)).c_str(), F_OK) == 0; cpu++) {
+            cores.push_back(cpu);
+        }
+    }
+
+    std::vector<std::pair<long, int>> speeds;
+    for (int cpu : cores) {
+        std::string path = CPU_SYSFS + "/cpu" + std::to_string(cpu);
+        std::string value = SysfsAccessor::readFile(path + "/cpu_capacity");
+        if (value.empty()) value = SysfsAccessor::readFile(path + "/cpufreq/cpuinfo_max_freq");
+        speeds.push_back({ atol(value.c_str()), cpu });
+    }
+    std::sort(speeds.begin(), speeds.end());
+
+    std::vector<int> sorted;
+    for (const auto& speed : speeds) {
+        sorted.push_back(speed.second);
+    }
+    return sorted;
+}
+
+bool CpusetLimiter::selectCpus(const CpusetLimitConfig& config, std::vector<int>* cpus) {
+    std::vector<int> present = coresBySpeed();
+    if (!config.cpus.empty()) {
+        for (int cpu : config.cpus) {
+            if (std::find(present.begin(), present.end(), cpu) == present.end()) {
+                LOGE("No cpu%d", cpu);
+                return false;
+            }
+            cpus->push_back(cpu);
+        }
+    } else {
+        if (config.cores <= 0 || config.cores > static_cast<int>(present.size())) {
+            LOGE("Can't keep %d of %zu cores", config.cores, present.size());
+            return false;
+        }
+        if (config.preferBig) std::reverse(present.begin(), present.end());
+        cpus->assign(present.begin(), present.begin() + config.cores);
+    }
+    std::sort(cpus->begin(), cpus->end());
+    cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+    return true;
+}
+
+bool CpusetLimiter::limitGroups(const std::string& owner, const CpusetLimitConfig& config,
+                                const std::vector<int>& cpus, const std::vector<std::string>& groups,
+                                std::vector<std::string>* held) {
+    bool anyLimited = false;
+    bool success = true;
+    for (const std::string& group : groups) {
+        std::string path = root_ + "/" + group;
+        if (access((path + "/" + cpusFile_).c_str(), F_OK) != 0) {
+            LOGE("No cpuset %s", path.c_str());
+            success = false;
+            continue;
+        }
+        if (limitGroup(path, cpus, owner, config.priority, held)) {
+            anyLimited = true;
+        } else {
+            success = false;
+        }
+    }
+    return anyLimited && success;
+}
+
+bool CpusetLimiter::limit(const CpusetLimitConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (root_.empty()) return false;
+
+    // Each group's mask is taken from its own, so start from those
+    restoreLocked();
+
+    std::vector<int> cpus;
+    if (!selectCpus(config, &cpus)) return false;
+
+    std::vector<std::string> groups = config.groups;
+    if (groups.empty()) {
+        groups.assign(std::begin(DEFAULT_GROUPS), std::end(DEFAULT_GROUPS));
+    }
+
+    bool success = limitGroups(ARBITER_OWNER, config, cpus, groups, &held_);
+    if (held_.empty()) {
+        restoreLocked();
+        return false;
+    }
+
+    cpus_ = cpus;
+    groups_ = groups;
+    LOGD("Limited %zu cpusets to cpus %s", groups.size(), formatCpuList(cpus).c_str());
+    return success;
+}
+
+bool CpusetLimiter::limitFor(const std::string& owner, const CpusetLimitConfig& config,
+                             std::vector<std::string>* held) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (root_.empty()) return false;
+
+    std::vector<int> cpus;
+    if (!selectCpus(config, &cpus)) return false;
+
+    std::vector<std::string> groups = config.groups;
+    if (groups.empty()) {
+        groups.assign(std::begin(DEFAULT_GROUPS), std::end(DEFAULT_GROUPS));
+    }
+
+    size_t before = held->size();
+    bool success = limitGroups(owner, config, cpus, groups, held);
+    LOGD("Limited %zu cpusets to cpus %s for %s", held->size() - before, formatCpuList(cpus).c_str(),
+         owner.c_str());
+    return success;
+}
+
+bool CpusetLimiter::releaseFor(const std::string& owner, const std::vector<std::string>& held) {
+    // Parents widen before their children, the reverse of limiting
+    bool success = true;
+    for (auto it = held.rbegin(); it != held.rend(); ++it) {
+        if (!TunableArbiter::getInstance().release(*it, owner)) success = false;
+    }
+    return success;
+}
+
+bool CpusetLimiter::limitGroup(const std::string& path, const std::vector<int>& allowed, const std::string& owner,
+                               int priority, std::vector<std::string>* held) {
+    std::string maskPath = path + "/" + cpusFile_;
+    std::string current;
+    if (!SysfsAccessor::getInstance().attribute(maskPath)->readString(&current)) return false;
+
+    std::vector<int> baseline = SysfsAccessor::parseCpuList(current);
+    std::vector<int> mask;
+    std::set_intersection(baseline.begin(), baseline.end(), allowed.begin(), allowed.end(),
+                          std::back_inserter(mask));
+    if (mask.empty()) mask = allowed;
+
+    // v1 refuses a mask that would leave a child's cpus outside it, so the
+    // children go first. A v2 child with an empty mask follows its parent.
+    DIR* dir = opendir(path.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] == '.') continue;
+            std::string child = path + "/" + entry->d_name;
+            if (access((child + "/" + cpusFile_).c_str(), F_OK) != 0) continue;
+            if (isV2_ && SysfsAccessor::readFile(child + "/" + cpusFile_).empty()) continue;
+            limitGroup(child, mask, owner, priority, held);
+        }
+        closedir(dir);
+    }
+
+    if (!TunableArbiter::getInstance().request(maskPath, owner, formatCpuList(mask),
+                                               TunableCombine::Override, priority)) {
+        return false;
+    }
+    held->push_back(maskPath);
+    return true;
+}
+
+bool CpusetLimiter::restore() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return restoreLocked();
+}
+
+bool CpusetLimiter::restoreLocked() {
+    bool success = releaseFor(ARBITER_OWNER, held_);
+    if (!held_.empty()) {
+        LOGD("Restored %zu cpusets", held_.size());
+    }
+    held_.clear();
+    cpus_.clear();
+    groups_.clear();
+    return success;
+}
+
+CpusetLimitStatus CpusetLimiter::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CpusetLimitStatus status;
+    status.isLimited = !held_.empty();
+    status.hierarchy = root_.empty() ? "" : (isV2_ ? "v2" : "v1");
+    status.totalCores = static_cast<int>(coresBySpeed().size());
+    status.cpus = cpus_;
+
+    std::vector<std::string> groups = groups_;
+    if (groups.empty() && !root_.empty()) {
+        groups.assign(std::begin(DEFAULT_GROUPS), std::end(DEFAULT_GROUPS));
+    }
+    for (const std::string& group : groups) {
+        std::string maskPath = root_ + "/" + group + "/" + cpusFile_;
+        CpusetGroupStatus entry;
+        entry.name = group;
+        entry.cpus = SysfsAccessor::readFile(maskPath);
+        entry.isLimited = std::find(held_.begin(), held_.end(), maskPath) != held_.end();
+        status.groups.push_back(entry);
+    }
+    return status;
+}
+
+} // namespace danr
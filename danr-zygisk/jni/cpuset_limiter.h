@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace danr {
+
+struct CpusetLimitConfig {
+    int cores = 0;                      // Keep this many cores, the slowest
+    bool preferBig = false;             // ...or the fastest ones
+    std::vector<int> cpus;              // Or exactly these, overriding cores
+    std::vector<std::string> groups;    // Empty: top-app, foreground, background
+    int priority = 0;                   // Against other controllers (TunableArbiter)
+};
+
+struct CpusetGroupStatus {
+    std::string name;           // Relative to the hierarchy root, e.g. "top-app"
+    std::string cpus;           // Current mask in cpulist format
+    bool isLimited;
+};
+
+struct CpusetLimitStatus {
+    bool isLimited;
+    std::string hierarchy;      // "v1" (/dev/cpuset), "v2" (/sys/fs/cgroup) or "" if none
+    int totalCores;
+    std::vector<int> cpus;      // Cores kept, empty if not limited
+    std::vector<CpusetGroupStatus> groups;
+
+    std::string toJson() const;
+};
+
+// Emulates a device with fewer cores by narrowing the cpusets apps run
+// in, which unlike hotplug is instant, reversible and allowed on every
+// kernel. Each group keeps the part of its own mask that falls within the
+// chosen cores, so e.g. background stays on the little ones; a group
+// sharing none of them gets all of them. Masks go through the
+// TunableArbiter, which journals them and restores them on restore().
+class CpusetLimiter {
+public:
+    static CpusetLimiter& getInstance();
+
+    // Replaces any previous limit. Fails if there is no cpuset hierarchy or
+    // the cores requested don't exist. Returns false too if a group can't
+    // be limited; the others stay limited unless none could be.
+    bool limit(const CpusetLimitConfig& config);
+    bool restore();
+
+    // The same limit on another controller's behalf, under its own arbiter
+    // owner, leaving this limiter's limit alone. Mask files requested are
+    // appended to held in order; releaseFor() undoes them.
+    bool limitFor(const std::string& owner, const CpusetLimitConfig& config, std::vector<std::string>* held);
+    bool releaseFor(const std::string& owner, const std::vector<std::string>& held);
+
+    CpusetLimitStatus getStatus();
+
+    // Cores sorted by capacity, slowest first (cpu_capacity, or the
+    // cluster's cpuinfo_max_freq where the kernel doesn't expose it)
+    static std::vector<int> coresBySpeed();
+
+private:
+    CpusetLimiter();
+    CpusetLimiter(const CpusetLimiter&) = delete;
+    CpusetLimiter& operator=(const CpusetLimiter&) = delete;
+
+    std::mutex mutex_;
+    std::string root_;          // Hierarchy mount point, empty if none
+    std::string cpusFile_;      // "cpus", "cpuset.cpus" (v1 without noprefix, v2)
+    bool isV2_ = false;
+    std::vector<int> cpus_;
+    std::vector<std::string> groups_;
+    std::vector<std::string> held_;     // Mask files requested, in order
+
+    void detectHierarchy();
+    bool selectCpus(const CpusetLimitConfig& config, std::vector<int>* cpus);
+    bool limitGroups(const std::string& owner, const CpusetLimitConfig& config, const std::vector<int>& cpus,
+                     const std::vector<std::string>& groups, std::vector<std::string>* held);
+    bool limitGroup(const std::string& path, const std::vector<int>& allowed, const std::string& owner,
+                    int priority, std::vector<std::string>* held);
+    bool restoreLocked();
+};
+
+} // namespace danr
@@ -0,0 +1,390 @@
+#include "device_profile.h"
+#include "cpu_freq_manager.h"
+#include "cpuset_limiter.h"
+#include "stress/stress_manager.h"
+#include "stress/monotonic_clock.h"
+#include "stress/sysfs_accessor.h"
+#include "stress/tunable_arbiter.h"
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-DeviceProfile", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-DeviceProfile", __VA_ARGS__)
+
+namespace danr {
+
+static const char* DATA_MOUNT = "/data";
+static const char* PROBE_PATH = "/data/local/tmp/danr_storage_probe";
+
+// Big enough to get past the device's write cache, small enough to take a
+// fraction of a second on UFS
+static const size_t PROBE_SIZE = 64 * 1024 * 1024;
+static const size_t PROBE_CHUNK = 1024 * 1024;
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "profile";
+
+// The memory hold stops short rather than take MemAvailable below this;
+// past it the low memory killer starts on the system's own processes
+static const int MEMORY_FLOOR_MB = 300;
+
+static void appendIntArray(std::ostringstream& ss, const std::vector<int>& values) {
+    ss << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << values[i];
+    }
+    ss << "]";
+}
+
+std::string DeviceProfileStatus::toJson() const {
+    std::ostringstream ss;
+    ss << "{";
+    ss << "\"isActive\":" << (isActive ? "true" : "false") << ",";
+    ss << "\"profile\":\"" << profile << "\",";
+    ss << "\"remainingMs\":" << remainingMs << ",";
+    ss << "\"hostMemTotalMB\":" << hostMemTotalMB << ",";
+    ss << "\"hostCores\":" << hostCores << ",";
+    ss << "\"hostReadMBps\":" << hostReadMBps << ",";
+    ss << "\"hostWriteMBps\":" << hostWriteMBps << ",";
+    ss << "\"holdMB\":" << holdMB << ",";
+    ss << "\"heldMB\":" << heldMB << ",";
+    ss << "\"cpus\":";
+    appendIntArray(ss, cpus);
+    ss << ",";
+    ss << "\"maxFreqKHz\":" << maxFreqKHz << ",";
+    ss << "\"contentionMBps\":" << contentionMBps << ",";
+    ss << "\"readAheadKB\":" << readAheadKB << ",";
+    ss << "\"errors\":[";
+    for (size_t i = 0; i < errors.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << "\"" << errors[i] << "\"";
+    }
+    ss << "]";
+    ss << "}";
+    return ss.str();
+}
+
+DeviceProfileManager& DeviceProfileManager::getInstance() {
+    static DeviceProfileManager instance;
+    return instance;
+}
+
+DeviceProfileManager::~DeviceProfileManager() {
+    // Only the thread: the controllers may be gone already at exit, and
+    // the restore journal undoes what they held on the next start
+    stopTimer();
+}
+
+const std::vector<DeviceProfile>& DeviceProfileManager::profiles() {
+    // memoryMB is MemTotal, which is what's left of the nominal size after
+    // the kernel and carveouts
+    static const std::vector<DeviceProfile> builtIn = {
+        { "go-1gb", "Android Go: 1 GB, 4x Cortex-A53 at 1.3 GHz, eMMC 4.5", 900, 4, 1300000, 100, 128 },
+        { "entry-2gb", "Entry level: 2 GB, 4x Cortex-A53 at 1.5 GHz, eMMC 5.1", 1850, 4, 1500000, 200, 128 },
+        { "budget-3gb", "Budget: 3 GB, 8x Cortex-A53 at 1.8 GHz, eMMC 5.1", 2800, 8, 1800000, 250, 256 },
+        { "mid-4gb", "Mid range: 4 GB, 6 cores at 2.0 GHz, UFS 2.1", 3700, 6, 2000000, 500, 512 },
+    };
+    return builtIn;
+}
+
+bool DeviceProfileManager::apply(const DeviceProfileConfig& config) {
+    auto it = std::find_if(profiles().begin(), profiles().end(), [&](const DeviceProfile& profile) {
+        return profile.name == config.name;
+    });
+    if (it == profiles().end()) {
+        LOGE("Unknown profile %s", config.name.c_str());
+        return false;
+    }
+    if (config.durationMs <= 0) {
+        LOGE("Profile needs a duration");
+        return false;
+    }
+
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    DeviceProfile profile = *it;
+    if (config.memoryMB > 0) profile.memoryMB = config.memoryMB;
+    if (config.cores > 0) profile.cores = config.cores;
+    if (config.maxFreqKHz > 0) profile.maxFreqKHz = config.maxFreqKHz;
+    if (config.storageMBps > 0) profile.storageMBps = config.storageMBps;
+    if (config.readAheadKB > 0) profile.readAheadKB = config.readAheadKB;
+
+    status_ = DeviceProfileStatus();
+    status_.profile = profile.name;
+    status_.hostMemTotalMB = memTotalMB();
+    std::vector<int> cores = CpusetLimiter::coresBySpeed();
+    status_.hostCores = static_cast<int>(cores.size());
+
+    if (config.cpu) {
+        status_.cpus = cores;
+        if (profile.cores < status_.hostCores) {
+            CpusetLimitConfig limit;
+            limit.cores = profile.cores;
+            if (CpusetLimiter::getInstance().limitFor(ARBITER_OWNER, limit, &cpusetPaths_)) {
+                status_.cpus.resize(static_cast<size_t>(profile.cores));
+            } else {
+                status_.errors.push_back("cpuset");
+            }
+        }
+
+        // Only the clusters of the cores kept; the others run nothing
+        if (CPUFreqManager::getInstance().capFor(ARBITER_OWNER, profile.maxFreqKHz, status_.cpus, &freqPaths_)) {
+            status_.maxFreqKHz = profile.maxFreqKHz;
+        } else {
+            status_.errors.push_back("cpufreq");
+        }
+    }
+
+    if (config.storage) {
+        // Probed before the memory hold and the contention start, which
+        // would both slow it down
+        if (probeStorage(&status_.hostReadMBps, &status_.hostWriteMBps)) {
+            status_.contentionMBps = std::max(0L, static_cast<long>(status_.hostReadMBps) - profile.storageMBps);
+        } else {
+            status_.errors.push_back("storage probe");
+        }
+
+        if (status_.contentionMBps > 0) {
+            DiskStressConfig disk;
+            disk.mode = "data";
+            disk.throughputMBps = static_cast<int>(status_.contentionMBps);
+            disk.readPercent = 100;
+            disk.useDirectIO = true;
+            disk.workerCount = 2;
+            disk.chunkSizeKB = 512;
+            disk.fileCount = 2;
+            disk.fileSizeMB = 64;
+            disk.durationMs = config.durationMs;
+            if (StressManager::getInstance().startDiskStress(disk)) {
+                startedDisk_ = true;
+            } else {
+                status_.errors.push_back("disk contention (disk stress already running?)");
+            }
+        }
+
+        std::string path = readAheadPath(DATA_MOUNT);
+        if (!path.empty() && TunableArbiter::getInstance().request(path, ARBITER_OWNER, profile.readAheadKB,
+                                                                    TunableCombine::Min)) {
+            readAheadPath_ = path;
+            status_.readAheadKB = profile.readAheadKB;
+        } else {
+            status_.errors.push_back("read_ahead_kb");
+        }
+    }
+
+    if (config.memory) {
+        status_.holdMB = std::max(0L, status_.hostMemTotalMB - profile.memoryMB);
+        if (status_.holdMB > 0) {
+            // Locked, or zram would compress most of it away
+            MemoryStressConfig memory;
+            memory.holdMB = static_cast<int>(status_.holdMB);
+            memory.targetFreeMB = MEMORY_FLOOR_MB;
+            memory.chunkSizeMB = 16;
+            memory.lockMemory = true;
+            memory.durationMs = config.durationMs;
+            if (StressManager::getInstance().startMemoryStress(memory)) {
+                startedMemory_ = true;
+            } else {
+                status_.errors.push_back("memory hold (memory stress already running?)");
+            }
+        }
+    }
+
+    status_.isActive = true;
+    deadlineMs_ = monotonicMs() + config.durationMs;
+    cancelTimer_ = false;
+    timerThread_ = std::thread(&DeviceProfileManager::timerFunction, this);
+
+    LOGD("Applied %s: %ld MB to hold, %zu cores at %ld kHz, %ld MB/s contention, read-ahead %d KB, %zu errors",
+         profile.name.c_str(), status_.holdMB, status_.cpus.size(), status_.maxFreqKHz,
+         status_.contentionMBps, status_.readAheadKB, status_.errors.size());
+    return status_.errors.empty();
+}
+
+void DeviceProfileManager::stop() {
+    stopTimer();
+    std::lock_guard<std::mutex> lock(mutex_);
+    undoLocked();
+}
+
+void DeviceProfileManager::stopTimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelTimer_ = true;
+    }
+    timerCv_.notify_all();
+    if (timerThread_.joinable()) {
+        timerThread_.join();
+    }
+}
+
+void DeviceProfileManager::timerFunction() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cancelTimer_) {
+        long remainingMs = deadlineMs_ - monotonicMs();
+        if (remainingMs <= 0) {
+            LOGD("Profile %s expired", status_.profile.c_str());
+            undoLocked();
+            return;
+        }
+        timerCv_.wait_for(lock, std::chrono::milliseconds(remainingMs));
+    }
+}
+
+void DeviceProfileManager::undoLocked() {
+    if (!status_.isActive) return;
+
+    if (startedMemory_) StressManager::getInstance().stopMemoryStress();
+    if (startedDisk_) StressManager::getInstance().stopDiskStress();
+    for (const std::string& path : freqPaths_) TunableArbiter::getInstance().release(path, ARBITER_OWNER);
+    CpusetLimiter::getInstance().releaseFor(ARBITER_OWNER, cpusetPaths_);
+    if (!readAheadPath_.empty()) TunableArbiter::getInstance().release(readAheadPath_, ARBITER_OWNER);
+
+    startedMemory_ = startedDisk_ = false;
+    freqPaths_.clear();
+    cpusetPaths_.clear();
+    readAheadPath_.clear();
+    status_.isActive = false;
+    LOGD("Profile %s undone", status_.profile.c_str());
+}
+
+DeviceProfileStatus DeviceProfileManager::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DeviceProfileStatus status = status_;
+    status.remainingMs = status.isActive ? std::max(0L, deadlineMs_ - monotonicMs()) : 0;
+
+    // The hold builds up in the background, and stops short at the
+    // MemAvailable floor if the host has less to spare than the profile
+    // takes away
+    if (startedMemory_) {
+        StressStatus memory = StressManager::getInstance().getMemoryStatus();
+        if (memory.isRunning) {
+            status.heldMB = atol(memory.data["allocatedMB"].c_str());
+            long shortfallMB = atol(memory.data["shortfallMB"].c_str());
+            if (shortfallMB > 0) {
+                status.errors.push_back("memory hold " + std::to_string(shortfallMB) +
+                                        " MB short (MemAvailable floor)");
+            }
+        }
+    }
+    return status;
+}
+
+std::string DeviceProfileManager::toJson() {
+    std::ostringstream ss;
+    ss << "{\"profiles\":[";
+    for (size_t i = 0; i < profiles().size(); i++) {
+        const DeviceProfile& profile = profiles()[i];
+        if (i > 0) ss << ",";
+        ss << "{";
+        ss << "\"name\":\"" << profile.name << "\",";
+        ss << "\"description\":\"" << profile.description << "\",";
+        ss << "\"memoryMB\":" << profile.memoryMB << ",";
+        ss << "\"cores\":" << profile.cores << ",";
+        ss << "\"maxFreqKHz\":" << profile.maxFreqKHz << ",";
+        ss << "\"storageMBps\":" << profile.storageMBps << ",";
+        ss << "\"readAheadKB\":" << profile.readAheadKB;
+        ss << "}";
+    }
+    ss << "],\"status\":" << getStatus().toJson() << "}";
+    return ss.str();
+}
+
+bool DeviceProfileManager::probeStorage(double* readMBps, double* writeMBps) {
+    // Without O_DIRECT (some filesystems refuse it) the page cache is
+    // dropped before reading back instead
+    bool direct = true;
+    int fd = open(PROBE_PATH, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0600);
+    if (fd < 0 && errno == EINVAL) {
+        direct = false;
+        fd = open(PROBE_PATH, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    }
+    if (fd < 0) {
+        LOGE("Cannot create %s: %s", PROBE_PATH, strerror(errno));
+        return false;
+    }
+
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, PROBE_CHUNK) != 0) {
+        close(fd);
+        unlink(PROBE_PATH);
+        return false;
+    }
+    // Incompressible, for storage that compresses
+    unsigned int seed = static_cast<unsigned int>(monotonicMs());
+    for (size_t i = 0; i < PROBE_CHUNK / sizeof(int); i++) {
+        static_cast<int*>(buffer)[i] = rand_r(&seed);
+    }
+
+    bool success = true;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < PROBE_SIZE && success; offset += PROBE_CHUNK) {
+        success = pwrite(fd, buffer, PROBE_CHUNK, static_cast<off_t>(offset)) == static_cast<ssize_t>(PROBE_CHUNK);
+    }
+    success = success && fdatasync(fd) == 0;
+    double writeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double readSec = 0;
+    if (success) {
+        if (!direct) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < PROBE_SIZE && success; offset += PROBE_CHUNK) {
+            success = pread(fd, buffer, PROBE_CHUNK, static_cast<off_t>(offset)) == static_cast<ssize_t>(PROBE_CHUNK);
+        }
+        readSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    free(buffer);
+    close(fd);
+    unlink(PROBE_PATH);
+    if (!success || writeSec <= 0 || readSec <= 0) {
+        LOGE("Storage probe failed");
+        return false;
+    }
+
+    double sizeMB = static_cast<double>(PROBE_SIZE) / (1024 * 1024);
+    *writeMBps = sizeMB / writeSec;
+    *readMBps = sizeMB / readSec;
+    LOGD("Storage probe: read %.0f MB/s, write %.0f MB/s%s", *readMBps, *writeMBps, direct ? "" : " (buffered)");
+    return true;
+}
+
+long DeviceProfileManager::memTotalMB() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line)) {
+        if (line.find("MemTotal:") == 0) {
+            return atol(line.c_str() + 9) / 1024;
+        }
+    }
+    return 0;
+}
+
+std::string DeviceProfileManager::readAheadPath(const std::string& mountPoint) {
+    struct stat st;
+    if (stat(mountPoint.c_str(), &st) != 0) return "";
+
+    // The filesystem's own device: a partition, or a dm device (dm-crypt,
+    // dm-default-key) with a queue of its own. A partition's settings live
+    // on its disk.
+    std::string device = "/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" +
+        std::to_string(minor(st.st_dev));
+    std::string path = device + "/queue/read_ahead_kb";
+    if (access(path.c_str(), F_OK) == 0) return path;
+    path = device + "/../queue/read_ahead_kb";
+    return access(path.c_str(), F_OK) == 0 ? path : "";
+}
+
+} // namespace danr
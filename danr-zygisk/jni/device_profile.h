@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace danr {
+
+// A device to emulate, in absolute terms, so the same profile gives the
+// same baseline on every host it is applied to
+struct DeviceProfile {
+    std::string name;
+    std::string description;
+    int memoryMB;           // MemTotal the device would report
+    int cores;
+    long maxFreqKHz;        // Cap for the cores kept
+    int storageMBps;        // Sequential read bandwidth
+    int readAheadKB;
+};
+
+// Fields left at 0 take the profile's value
+struct DeviceProfileConfig {
+    std::string name;
+    long durationMs = 1800000;  // Everything is undone after this
+    int memoryMB = 0;
+    int cores = 0;
+    long maxFreqKHz = 0;
+    int storageMBps = 0;
+    int readAheadKB = 0;
+    bool memory = true;         // Which parts to apply
+    bool cpu = true;
+    bool storage = true;
+};
+
+// What the profile worked out on this host and applied
+struct DeviceProfileStatus {
+    bool isActive = false;
+    std::string profile;
+    long remainingMs = 0;
+
+    long hostMemTotalMB = 0;
+    int hostCores = 0;
+    double hostReadMBps = 0;        // From the probe, 0 if not run
+    double hostWriteMBps = 0;
+
+    long holdMB = 0;                // MemTotal minus this is the profile's
+    long heldMB = 0;                // So far; less if MemAvailable ran out
+    std::vector<int> cpus;          // Cores kept, slowest first
+    long maxFreqKHz = 0;
+    long contentionMBps = 0;        // Direct reads taking up the difference
+    int readAheadKB = 0;
+    std::vector<std::string> errors;    // Parts that couldn't be applied
+
+    std::string toJson() const;
+};
+
+// Applies a low-end device profile through the existing controllers:
+// MemoryStressor holds memory, CpusetLimiter keeps the slowest cores,
+// CPUFreqManager caps them, DiskStressor reads just enough to leave the
+// profile's storage bandwidth over, and the data partition's read-ahead
+// is lowered. The cpusets, caps and read-ahead are held in the
+// TunableArbiter under the profile's own owner, so limits set through
+// those controllers directly combine with it and outlive it. One profile
+// is active at a time.
+class DeviceProfileManager {
+public:
+    static DeviceProfileManager& getInstance();
+
+    static const std::vector<DeviceProfile>& profiles();
+
+    // Replaces the active profile. Parts that fail are listed in the
+    // status errors; returns false if the profile is unknown or any failed.
+    bool apply(const DeviceProfileConfig& config);
+    void stop();
+
+    DeviceProfileStatus getStatus();
+    std::string toJson();
+
+    // Writes and reads back a scratch file with O_DIRECT. Returns false if
+    // the file can't be written.
+    static bool probeStorage(double* readMBps, double* writeMBps);
+
+private:
+    DeviceProfileManager() = default;
+    ~DeviceProfileManager();
+    DeviceProfileManager(const DeviceProfileManager&) = delete;
+    DeviceProfileManager& operator=(const DeviceProfileManager&) = delete;
+
+    std::mutex mutex_;
+    std::condition_variable timerCv_;
+    std::thread timerThread_;
+    bool cancelTimer_ = false;
+    long deadlineMs_ = 0;
+    DeviceProfileStatus status_;
+
+    // What to undo
+    bool startedMemory_ = false;
+    bool startedDisk_ = false;
+    std::vector<std::string> cpusetPaths_;
+    std::vector<std::string> freqPaths_;
+    std::string readAheadPath_;
+
+    void timerFunction();
+    void stopTimer();
+    void undoLocked();
+
+    static long memTotalMB();
+    static std::string readAheadPath(const std::string& mountPoint);
+};
+
+} // namespace danr
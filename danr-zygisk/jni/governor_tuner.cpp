@@ -0,0 +1,392 @@
+#include "governor_tuner.h"
+#include "stress/sysfs_accessor.h"
+#include "stress/freq_residency.h"
+#include <sstream>
+#include <unistd.h>
+#include <dirent.h>
+#include <android/log.h>
+#include <algorithm>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-GovernorTuner", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-GovernorTuner", __VA_ARGS__)
+
+namespace danr {
+
+static const std::string CPU_SYSFS = "/sys/devices/system/cpu";
+static const std::string DEVFREQ_SYSFS = "/sys/class/devfreq";
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "governor";
+
+static long readLong(const std::string& path, long defaultValue) {
+    std::string value = SysfsAccessor::readFile(path);
+    char* end;
+    long parsed = strtol(value.c_str(), &end, 10);
+    return end != value.c_str() ? parsed : defaultValue;
+}
+
+static std::vector<std::string> readWords(const std::string& path) {
+    std::vector<std::string> words;
+    std::istringstream iss(SysfsAccessor::readFile(path));
+    std::string word;
+    while (iss >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+static void appendStringArray(std::ostringstream& ss, const std::vector<std::string>& values) {
+    ss << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << "\"" << values[i] << "\"";
+    }
+    ss << "]";
+}
+
+static void appendLongArray(std::ostringstream& ss, const std::vector<long>& values) {
+    ss << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) ss << ",";
+        ss << values[i];
+    }
+    ss << "]";
+}
+
+std::string GovernorStatus::toJson() const {
+    std::ostringstream ss;
+    ss << "{";
+    ss << "\"policies\":[";
+    for (size_t i = 0; i < policies.size(); i++) {
+        const GovernorPolicyStatus& policy = policies[i];
+        if (i > 0) ss << ",";
+        ss << "{";
+        ss << "\"policy\":" << policy.policy << ",";
+        ss << "\"governor\":\"" << policy.governor << "\",";
+        ss << "\"availableGovernors\":";
+        appendStringArray(ss, policy.availableGovernors);
+        ss << ",";
+        ss << "\"rateLimitUs\":" << policy.rateLimitUs << ",";
+        ss << "\"upRateLimitUs\":" << policy.upRateLimitUs << ",";
+        ss << "\"downRateLimitUs\":" << policy.downRateLimitUs << ",";
+        ss << "\"minFreq\":" << policy.minFreq << ",";
+        ss << "\"maxFreq\":" << policy.maxFreq << ",";
+        ss << "\"isTuned\":" << (policy.isTuned ? "true" : "false");
+        ss << "}";
+    }
+    ss << "],";
+    ss << "\"devices\":[";
+    for (size_t i = 0; i < devices.size(); i++) {
+        const DevfreqDeviceStatus& device = devices[i];
+        if (i > 0) ss << ",";
+        ss << "{";
+        ss << "\"name\":\"" << device.name << "\",";
+        ss << "\"governor\":\"" << device.governor << "\",";
+        ss << "\"availableGovernors\":";
+        appendStringArray(ss, device.availableGovernors);
+        ss << ",";
+        ss << "\"curFreq\":" << device.curFreq << ",";
+        ss << "\"minFreq\":" << device.minFreq << ",";
+        ss << "\"maxFreq\":" << device.maxFreq << ",";
+        ss << "\"availableFreqs\":";
+        appendLongArray(ss, device.availableFreqs);
+        ss << ",";
+        ss << "\"isTuned\":" << (device.isTuned ? "true" : "false");
+        ss << "}";
+    }
+    ss << "]";
+    ss << "}";
+    return ss.str();
+}
+
+GovernorTuner& GovernorTuner::getInstance() {
+    static GovernorTuner instance;
+    return instance;
+}
+
+GovernorTuner::GovernorTuner() {
+    discover();
+}
+
+void GovernorTuner::discover() {
+    for (const std::string& path : FreqResidency::policyPaths()) {
+        // "policyN" or, before 4.3, "cpuN"
+        std::string name = FreqResidency::policyName(path);
+        size_t digits = name.find_first_of("0123456789");
+        if (digits == std::string::npos) continue;
+
+        Policy policy;
+        policy.id = atoi(name.c_str() + digits);
+        policy.path = path;
+        policies_.push_back(policy);
+    }
+
+    DIR* dir = opendir(DEVFREQ_SYSFS.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] == '.') continue;
+
+            Device device;
+            device.name = entry->d_name;
+            device.path = DEVFREQ_SYSFS + "/" + entry->d_name;
+            std::istringstream iss(SysfsAccessor::readFile(device.path + "/available_frequencies"));
+            long freq;
+            while (iss >> freq) {
+                device.availableFreqs.push_back(freq);
+            }
+            std::sort(device.availableFreqs.begin(), device.availableFreqs.end());
+            devices_.push_back(device);
+        }
+        closedir(dir);
+    }
+    std::sort(devices_.begin(), devices_.end(), [](const Device& a, const Device& b) {
+        return a.name < b.name;
+    });
+
+    LOGD("%zu cpufreq policies, %zu devfreq devices", policies_.size(), devices_.size());
+}
+
+bool GovernorTuner::tunePolicies(const GovernorTunables& tunables, int policyId, int priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bool matched = false;
+    bool success = true;
+    for (Policy& policy : policies_) {
+        if (policyId >= 0 && policy.id != policyId) continue;
+        matched = true;
+
+        if (!tunables.governor.empty()) {
+            // The old governor's tunables directory goes away with it
+            if (SysfsAccessor::readFile(policy.path + "/scaling_governor") != tunables.governor &&
+                !release(policy.governorHeld)) {
+                success = false;
+            }
+            if (!request(policy.held, policy.path + "/scaling_governor", tunables.governor,
+                         TunableCombine::Override, priority)) {
+                success = false;
+            }
+        }
+
+        if (tunables.rateLimitUs >= 0) {
+            bool applied;
+            if (!governorTunable(policy, "rate_limit_us").empty()) {
+                applied = requestGovernorTunable(policy, "rate_limit_us", tunables.rateLimitUs, priority);
+            } else {
+                // Android kernels before 5.4 split it into a pair
+                applied = requestGovernorTunable(policy, "up_rate_limit_us", tunables.rateLimitUs, priority);
+                applied = requestGovernorTunable(policy, "down_rate_limit_us", tunables.rateLimitUs, priority) &&
+                    applied;
+            }
+            if (!applied) success = false;
+        }
+        if (tunables.upRateLimitUs >= 0 &&
+            !requestGovernorTunable(policy, "up_rate_limit_us", tunables.upRateLimitUs, priority)) {
+            success = false;
+        }
+        if (tunables.downRateLimitUs >= 0 &&
+            !requestGovernorTunable(policy, "down_rate_limit_us", tunables.downRateLimitUs, priority)) {
+            success = false;
+        }
+
+        // The governor picks the lowest table step at or above the floor
+        if (tunables.minFrequency > 0 &&
+            !request(policy.held, policy.path + "/scaling_min_freq", std::to_string(tunables.minFrequency),
+                     TunableCombine::Max, priority)) {
+            success = false;
+        }
+    }
+
+    if (!matched) {
+        LOGE("No cpufreq policy %d", policyId);
+        return false;
+    }
+    return success;
+}
+
+bool GovernorTuner::tuneDevfreq(const DevfreqTunables& tunables, const std::string& name, int priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (tunables.minFrequency > 0 && tunables.maxFrequency > 0 && tunables.minFrequency > tunables.maxFrequency) {
+        LOGE("Devfreq floor %ld Hz is above the cap %ld Hz", tunables.minFrequency, tunables.maxFrequency);
+        return false;
+    }
+
+    bool matched = false;
+    bool success = true;
+    for (Device& device : devices_) {
+        if (!name.empty() && device.name.find(name) == std::string::npos) continue;
+        matched = true;
+
+        if (!tunables.governor.empty() &&
+            !request(device.held, device.path + "/governor", tunables.governor, TunableCombine::Override,
+                     priority)) {
+            success = false;
+        }
+
+        long minFreq = tunables.minFrequency > 0 ? snapUp(device.availableFreqs, tunables.minFrequency) : 0;
+        long maxFreq = tunables.maxFrequency > 0 ? snapDown(device.availableFreqs, tunables.maxFrequency) : 0;
+        if (minFreq > 0 && maxFreq > 0) minFreq = std::min(minFreq, maxFreq);
+
+        // Kernels before 5.5 reject a max_freq below min_freq rather than
+        // clamping, so a cap under the current floor takes the floor along
+        long currentMin = readLong(device.path + "/min_freq", 0);
+        long currentMax = readLong(device.path + "/max_freq", 0);
+        if (maxFreq > 0 && minFreq == 0 && currentMin > maxFreq) minFreq = maxFreq;
+
+        // Whichever write lowers a limit goes first, so min <= max holds
+        // after each; restoring in reverse order keeps it too
+        bool maxFirst = maxFreq > 0 && maxFreq >= currentMax;
+        std::string maxPath = device.path + "/max_freq";
+        if (maxFirst && !request(device.held, maxPath, std::to_string(maxFreq), TunableCombine::Min, priority)) {
+            success = false;
+        }
+        if (minFreq > 0 && !request(device.held, device.path + "/min_freq", std::to_string(minFreq),
+                                    TunableCombine::Max, priority)) {
+            success = false;
+        }
+        if (maxFreq > 0 && !maxFirst &&
+            !request(device.held, maxPath, std::to_string(maxFreq), TunableCombine::Min, priority)) {
+            success = false;
+        }
+
+        LOGD("%s: governor %s, %ld-%ld Hz", device.name.c_str(),
+             SysfsAccessor::readFile(device.path + "/governor").c_str(),
+             readLong(device.path + "/min_freq", 0), readLong(maxPath, 0));
+    }
+
+    if (!matched) {
+        LOGE("No devfreq device matches \"%s\"", name.c_str());
+        return false;
+    }
+    return success;
+}
+
+bool GovernorTuner::restorePolicies(int policyId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool success = true;
+    for (Policy& policy : policies_) {
+        if (policyId >= 0 && policy.id != policyId) continue;
+        // Tunables first: restoring the governor may remove their directory
+        if (!release(policy.governorHeld)) success = false;
+        if (!release(policy.held)) success = false;
+    }
+    return success;
+}
+
+bool GovernorTuner::restoreDevfreq(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool success = true;
+    for (Device& device : devices_) {
+        if (!name.empty() && device.name.find(name) == std::string::npos) continue;
+        if (!release(device.held)) success = false;
+    }
+    return success;
+}
+
+GovernorStatus GovernorTuner::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GovernorStatus status;
+
+    for (const Policy& policy : policies_) {
+        GovernorPolicyStatus entry;
+        entry.policy = policy.id;
+        entry.governor = SysfsAccessor::readFile(policy.path + "/scaling_governor");
+        entry.availableGovernors = readWords(policy.path + "/scaling_available_governors");
+
+        std::string path = governorTunable(policy, "rate_limit_us");
+        entry.rateLimitUs = path.empty() ? -1 : readLong(path, -1);
+        path = governorTunable(policy, "up_rate_limit_us");
+        entry.upRateLimitUs = path.empty() ? -1 : readLong(path, -1);
+        path = governorTunable(policy, "down_rate_limit_us");
+        entry.downRateLimitUs = path.empty() ? -1 : readLong(path, -1);
+
+        entry.minFreq = readLong(policy.path + "/scaling_min_freq", 0);
+        entry.maxFreq = readLong(policy.path + "/scaling_max_freq", 0);
+        entry.isTuned = !policy.held.empty() || !policy.governorHeld.empty();
+        status.policies.push_back(entry);
+    }
+
+    for (const Device& device : devices_) {
+        DevfreqDeviceStatus entry;
+        entry.name = device.name;
+        entry.governor = SysfsAccessor::readFile(device.path + "/governor");
+        entry.availableGovernors = readWords(device.path + "/available_governors");
+        entry.curFreq = readLong(device.path + "/cur_freq", 0);
+        entry.minFreq = readLong(device.path + "/min_freq", 0);
+        entry.maxFreq = readLong(device.path + "/max_freq", 0);
+        entry.availableFreqs = device.availableFreqs;
+        entry.isTuned = !device.held.empty();
+        status.devices.push_back(entry);
+    }
+    return status;
+}
+
+bool GovernorTuner::request(std::vector<std::string>& held, const std::string& path, const std::string& value,
+                            TunableCombine combine, int priority) {
+    if (!TunableArbiter::getInstance().request(path, ARBITER_OWNER, value, combine, priority)) {
+        return false;
+    }
+    // Kept in order of the latest request, which is the order to undo in
+    held.erase(std::remove(held.begin(), held.end(), path), held.end());
+    held.push_back(path);
+    return true;
+}
+
+bool GovernorTuner::requestGovernorTunable(Policy& policy, const std::string& name, long value, int priority) {
+    std::string path = governorTunable(policy, name);
+    if (path.empty()) {
+        LOGE("policy%d: governor %s has no %s", policy.id,
+             SysfsAccessor::readFile(policy.path + "/scaling_governor").c_str(), name.c_str());
+        return false;
+    }
+    return request(policy.governorHeld, path, std::to_string(value), TunableCombine::Override, priority);
+}
+
+bool GovernorTuner::release(std::vector<std::string>& held) {
+    bool success = true;
+    for (auto it = held.rbegin(); it != held.rend(); ++it) {
+        // Global governor tunables are shared by every policy
+        if (heldElsewhere(&held, *it)) continue;
+        if (!TunableArbiter::getInstance().release(*it, ARBITER_OWNER)) success = false;
+    }
+    held.clear();
+    return success;
+}
+
+bool GovernorTuner::heldElsewhere(const std::vector<std::string>* held, const std::string& path) const {
+    for (const Policy& policy : policies_) {
+        for (const std::vector<std::string>* other : { &policy.held, &policy.governorHeld }) {
+            if (other != held && std::find(other->begin(), other->end(), path) != other->end()) return true;
+        }
+    }
+    return false;
+}
+
+std::string GovernorTuner::governorTunable(const Policy& policy, const std::string& name) {
+    std::string governor = SysfsAccessor::readFile(policy.path + "/scaling_governor");
+    if (governor.empty()) return "";
+
+    // In the policy directory when the driver sets governor_per_policy, as
+    // big.LITTLE SoCs do; otherwise one set for all policies
+    std::string path = policy.path + "/" + governor + "/" + name;
+    if (access(path.c_str(), F_OK) == 0) return path;
+    path = CPU_SYSFS + "/cpufreq/" + governor + "/" + name;
+    return access(path.c_str(), F_OK) == 0 ? path : "";
+}
+
+long GovernorTuner::snapDown(const std::vector<long>& freqs, long frequency) {
+    // Highest step not above the request, or the lowest step
+    if (freqs.empty()) return frequency;
+    auto it = std::upper_bound(freqs.begin(), freqs.end(), frequency);
+    return it == freqs.begin() ? freqs.front() : *(it - 1);
+}
+
+long GovernorTuner::snapUp(const std::vector<long>& freqs, long frequency) {
+    // Lowest step not below the request, or the highest step
+    if (freqs.empty()) return frequency;
+    auto it = std::lower_bound(freqs.begin(), freqs.end(), frequency);
+    return it == freqs.end() ? freqs.back() : *it;
+}
+
+} // namespace danr
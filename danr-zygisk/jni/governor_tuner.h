@@ -0,0 +1,118 @@
+#pragma once
+
+#include "stress/tunable_arbiter.h"
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace danr {
+
+// Settings for cpufreq policies. Fields left at their defaults aren't
+// touched; rate limits apply to whichever governor is active afterwards.
+struct GovernorTunables {
+    std::string governor;       // e.g. "schedutil", "powersave"
+    long rateLimitUs = -1;      // schedutil rate_limit_us; kernels with only
+                                // the up/down pair get both set
+    long upRateLimitUs = -1;    // Delay before ramping up
+    long downRateLimitUs = -1;  // Delay before ramping down
+    long minFrequency = 0;      // scaling_min_freq floor, kHz
+};
+
+// Settings for devfreq devices (GPU, DDR and cache buses, UFS, ...).
+// Frequencies are in Hz, as devfreq reports them.
+struct DevfreqTunables {
+    std::string governor;       // e.g. "powersave", "userspace"
+    long minFrequency = 0;
+    long maxFrequency = 0;
+};
+
+struct GovernorPolicyStatus {
+    int policy;
+    std::string governor;
+    std::vector<std::string> availableGovernors;
+    long rateLimitUs;           // -1 if the active governor has no such tunable
+    long upRateLimitUs;
+    long downRateLimitUs;
+    long minFreq;
+    long maxFreq;
+    bool isTuned;
+};
+
+struct DevfreqDeviceStatus {
+    std::string name;
+    std::string governor;
+    std::vector<std::string> availableGovernors;
+    long curFreq;
+    long minFreq;
+    long maxFreq;
+    std::vector<long> availableFreqs;
+    bool isTuned;
+};
+
+struct GovernorStatus {
+    std::vector<GovernorPolicyStatus> policies;
+    std::vector<DevfreqDeviceStatus> devices;
+
+    std::string toJson() const;
+};
+
+// Emulates sluggish governors and slow memory buses: schedutil rate
+// limits, scaling_min_freq floors and devfreq limits and governors. All
+// writes go through the TunableArbiter, so they are journaled like the
+// CPU frequency caps and combine with what other controllers hold.
+class GovernorTuner {
+public:
+    static GovernorTuner& getInstance();
+
+    // Applies to every policy, or to one when policy >= 0. priority is
+    // against other controllers (see TunableArbiter). Returns false if any
+    // setting couldn't be applied; the others stay applied.
+    bool tunePolicies(const GovernorTunables& tunables, int policy = -1, int priority = 0);
+
+    // Applies to every devfreq device whose name contains device (all of
+    // them when empty), e.g. "ddr", "gpu" or "llcc". Limits are snapped to
+    // each device's frequency table.
+    bool tuneDevfreq(const DevfreqTunables& tunables, const std::string& device = "", int priority = 0);
+
+    // Undo this controller's settings, in reverse order
+    bool restorePolicies(int policy = -1);
+    bool restoreDevfreq(const std::string& device = "");
+
+    GovernorStatus getStatus();
+
+private:
+    GovernorTuner();
+    GovernorTuner(const GovernorTuner&) = delete;
+    GovernorTuner& operator=(const GovernorTuner&) = delete;
+
+    struct Policy {
+        int id;
+        std::string path;
+        std::vector<std::string> held;            // Paths requested, oldest first
+        std::vector<std::string> governorHeld;    // The governor's own tunables,
+                                                  // which go away with it
+    };
+
+    struct Device {
+        std::string name;
+        std::string path;
+        std::vector<long> availableFreqs;
+        std::vector<std::string> held;
+    };
+
+    std::mutex mutex_;
+    std::vector<Policy> policies_;
+    std::vector<Device> devices_;
+
+    void discover();
+    bool request(std::vector<std::string>& held, const std::string& path, const std::string& value,
+                 TunableCombine combine, int priority);
+    bool requestGovernorTunable(Policy& policy, const std::string& name, long value, int priority);
+    bool release(std::vector<std::string>& held);
+    bool heldElsewhere(const std::vector<std::string>* held, const std::string& path) const;
+    static std::string governorTunable(const Policy& policy, const std::string& name);
+    static long snapDown(const std::vector<long>& freqs, long frequency);
+    static long snapUp(const std::vector<long>& freqs, long frequency);
+};
+
+} // namespace danr
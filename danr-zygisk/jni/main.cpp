@@ -1,16 +1,25 @@
 #include <jni.h>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <fstream>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cerrno>
 #include <cstring>
+#include <cstdint>
 #include <thread>
 #include <chrono>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <android/log.h>
 #include "zygisk.hpp"
 #include "json.hpp"
+#include "whitelist_matcher.h"
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-Zygisk", __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-Zygisk", __VA_ARGS__)
@@ -20,16 +29,242 @@ using zygisk::Api;
 using zygisk::AppSpecializeArgs;
 using zygisk::ServerSpecializeArgs;
 
+// The companion runs as root outside zygote, so it can't use getModuleDir()
+#define MODULE_DIR "/data/adb/modules/danr-zygisk"
+#define CONFIG_NAME "config.json"
+
+// Companion protocol. Query: uint32_t length, then the process name.
+// Reply: one status byte; QUERY_WHITELISTED is followed by the settings,
+// int64_t anrThresholdMs, uint8_t SETTING_* flags, uint16_t length and
+// the backend URL.
+enum : uint8_t {
+    QUERY_NOT_WHITELISTED = 0,
+    QUERY_WHITELISTED = 1,
+    QUERY_NO_CONFIG = 2,
+};
+
+enum : uint8_t {
+    SETTING_ENABLE_IN_RELEASE = 1 << 0,
+    SETTING_ENABLE_IN_DEBUG = 1 << 1,
+    SETTING_AUTO_START = 1 << 2,
+};
+
+static const uint32_t MAX_NAME_LENGTH = 1024;
+
+// Bounds how long a fork can wait on the companion before falling back
+static const int COMPANION_TIMEOUT_MS = 1000;
+
+// danrConfig values handed to DANRConfig, with the SDK's defaults
+struct DanrSettings {
+    std::string backendUrl = "http://localhost:8080";
+    long anrThresholdMs = 5000;
+    bool enableInRelease = true;
+    bool enableInDebug = true;
+    bool autoStart = true;
+};
+
+static bool readFully(int fd, void* buffer, size_t size) {
+    char* data = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size) {
+    const char* data = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readConfigFile(int fd, std::string* content) {
+    char buffer[4096];
+    ssize_t bytesRead;
+    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
+        content->append(buffer, bytesRead);
+    }
+
+    if (bytesRead < 0) {
+        LOGE("Failed to read config file: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool parseConfig(const std::string& content, std::vector<std::string>* whitelist, DanrSettings* settings) {
+    try {
+        json config = json::parse(content);
+
+        try {
+            auto& whitelistArray = config["whitelist"];
+            if (whitelistArray.is_array()) {
+                for (const auto& pkg : whitelistArray) {
+                    if (pkg.is_string()) {
+                        whitelist->push_back(pkg.get<std::string>());
+                    }
+                }
+            } else {
+                LOGD("WARNING: whitelist exists but is not an array!");
+            }
+        } catch (const std::exception& e) {
+            LOGD("WARNING: Exception accessing whitelist: %s", e.what());
+        } catch (...) {
+            LOGD("WARNING: Unknown exception accessing whitelist!");
+        }
+
+        try {
+            auto& danrCfg = config["danrConfig"];
+            if (danrCfg.is_object()) {
+                settings->backendUrl = danrCfg.value("backendUrl", settings->backendUrl);
+                settings->anrThresholdMs = danrCfg.value("anrThresholdMs", settings->anrThresholdMs);
+                settings->enableInRelease = danrCfg.value("enableInRelease", settings->enableInRelease);
+                settings->enableInDebug = danrCfg.value("enableInDebug", settings->enableInDebug);
+                settings->autoStart = danrCfg.value("autoStart", settings->autoStart);
+            }
+        } catch (...) {
+            LOGD("WARNING: danrConfig not found in config!");
+        }
+
+        return true;
+    } catch (const std::exception& e) {
+        LOGE("Failed to parse config: %s", e.what());
+        return false;
+    }
+}
+
+// Root companion: parses config.json once, re-parses it when inotify
+// reports it written or replaced, and answers each fork's query from
+// memory. A config that fails to parse leaves the previous one in place.
+struct CompanionConfig {
+    danr::WhitelistMatcher whitelist;
+    std::string reply;          // Sent to whitelisted packages as is
+};
+
+static std::mutex companionMutex;
+static std::shared_ptr<const CompanionConfig> companionConfig;
+
+static void reloadConfig() {
+    int configFd = open(MODULE_DIR "/" CONFIG_NAME, O_RDONLY | O_CLOEXEC);
+    if (configFd < 0) {
+        LOGE("Companion: failed to open config.json: %s", strerror(errno));
+        return;
+    }
+    std::string content;
+    bool readOk = readConfigFile(configFd, &content);
+    close(configFd);
+
+    std::vector<std::string> whitelist;
+    DanrSettings settings;
+    if (!readOk || !parseConfig(content, &whitelist, &settings)) return;
+
+    auto config = std::make_shared<CompanionConfig>();
+    config->whitelist = danr::WhitelistMatcher(whitelist);
+
+    int64_t anrThresholdMs = settings.anrThresholdMs;
+    uint8_t flags = (settings.enableInRelease ? SETTING_ENABLE_IN_RELEASE : 0) |
+                    (settings.enableInDebug ? SETTING_ENABLE_IN_DEBUG : 0) |
+                    (settings.autoStart ? SETTING_AUTO_START : 0);
+    uint16_t urlLength = static_cast<uint16_t>(std::min<size_t>(settings.backendUrl.size(), UINT16_MAX));
+    config->reply.push_back(static_cast<char>(QUERY_WHITELISTED));
+    config->reply.append(reinterpret_cast<const char*>(&anrThresholdMs), sizeof(anrThresholdMs));
+    config->reply.push_back(static_cast<char>(flags));
+    config->reply.append(reinterpret_cast<const char*>(&urlLength), sizeof(urlLength));
+    config->reply.append(settings.backendUrl, 0, urlLength);
+
+    std::lock_guard<std::mutex> lock(companionMutex);
+    companionConfig = config;
+    LOGD("Companion: loaded config, %zu names and %zu patterns whitelisted",
+         config->whitelist.exactCount(), config->whitelist.patternCount());
+}
+
+static void watchConfig() {
+    // The directory is watched rather than the file, so the watch survives
+    // the file being replaced by a rename
+    int inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (inotifyFd < 0 || inotify_add_watch(inotifyFd, MODULE_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        LOGE("Companion: inotify unavailable (%s), config changes need a reboot", strerror(errno));
+        if (inotifyFd >= 0) close(inotifyFd);
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) break;
+
+        bool changed = false;
+        for (char* ptr = buffer; ptr < buffer + length; ) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            if (event->mask & IN_IGNORED) {
+                LOGE("Companion: module directory removed, no longer watching config");
+                close(inotifyFd);
+                return;
+            }
+            if (event->len > 0 && strcmp(event->name, CONFIG_NAME) == 0) changed = true;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+        if (changed) reloadConfig();
+    }
+    close(inotifyFd);
+}
+
+static void companionHandler(int client) {
+    static std::once_flag started;
+    std::call_once(started, [] {
+        reloadConfig();
+        std::thread(watchConfig).detach();
+    });
+
+    uint32_t nameLength;
+    char name[MAX_NAME_LENGTH];
+    if (!readFully(client, &nameLength, sizeof(nameLength)) || nameLength > MAX_NAME_LENGTH ||
+        !readFully(client, name, nameLength)) {
+        LOGE("Companion: malformed query");
+        return;
+    }
+
+    std::shared_ptr<const CompanionConfig> config;
+    {
+        std::lock_guard<std::mutex> lock(companionMutex);
+        config = companionConfig;
+    }
+
+    if (!config) {
+        uint8_t status = QUERY_NO_CONFIG;
+        writeFully(client, &status, sizeof(status));
+    } else if (config->whitelist.matches(name, nameLength)) {
+        writeFully(client, config->reply.data(), config->reply.size());
+    } else {
+        uint8_t status = QUERY_NOT_WHITELISTED;
+        writeFully(client, &status, sizeof(status));
+    }
+}
+
+REGISTER_ZYGISK_COMPANION(companionHandler)
+
 class DanrModule : public zygisk::ModuleBase {
 private:
     Api *api;
     JNIEnv *env;
     JavaVM *jvm;
-    std::vector<std::string> whitelist;
-    json danrConfig;
+    danr::WhitelistMatcher whitelist;
+    DanrSettings settings;
     bool shouldInject = false;
     std::vector<char> dexData;
 
+    // Fallback for when the companion can't be reached: reads and parses
+    // config.json in this fork
     bool loadConfig() {
         // Use Zygisk API to get module directory (handles SELinux permissions)
         int dirfd = api->getModuleDir();
@@ -39,73 +274,74 @@ private:
         }
 
         // Open config.json relative to module directory
-        int configFd = openat(dirfd, "config.json", O_RDONLY);
+        int configFd = openat(dirfd, CONFIG_NAME, O_RDONLY);
         if (configFd < 0) {
             LOGE("Failed to open config.json: %s", strerror(errno));
             return false;
         }
 
-        // Read file contents
         std::string configContent;
-        char buffer[4096];
-        ssize_t bytesRead;
-        while ((bytesRead = read(configFd, buffer, sizeof(buffer))) > 0) {
-            configContent.append(buffer, bytesRead);
-        }
+        bool readOk = readConfigFile(configFd, &configContent);
         close(configFd);
 
-        if (bytesRead < 0) {
-            LOGE("Failed to read config file: %s", strerror(errno));
-            return false;
+        std::vector<std::string> entries;
+        if (!readOk || !parseConfig(configContent, &entries, &settings)) return false;
+        whitelist = danr::WhitelistMatcher(entries);
+        return true;
+    }
+
+    // Asks the companion whether packageName is whitelisted, filling in
+    // settings if it is. Returns a QUERY_* status, or -1 if the companion
+    // couldn't be reached.
+    int queryCompanion(const char* packageName) {
+        int fd = api->connectCompanion();
+        if (fd < 0) {
+            LOGE("Failed to connect to companion");
+            return -1;
         }
 
-        try {
-            json config = json::parse(configContent);
-
-            try {
-                auto& whitelistArray = config["whitelist"];
-                if (whitelistArray.is_array()) {
-                    for (const auto& pkg : whitelistArray) {
-                        if (pkg.is_string()) {
-                            std::string pkgName = pkg.get<std::string>();
-                            whitelist.push_back(pkgName);
-                        }
-                    }
-                } else {
-                    LOGD("WARNING: whitelist exists but is not an array!");
-                }
-            } catch (const std::exception& e) {
-                LOGD("WARNING: Exception accessing whitelist: %s", e.what());
-            } catch (...) {
-                LOGD("WARNING: Unknown exception accessing whitelist!");
-            }
+        struct timeval timeout = { COMPANION_TIMEOUT_MS / 1000, (COMPANION_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 
-            try {
-                auto& danrCfg = config["danrConfig"];
-                if (danrCfg.is_object()) {
-                    danrConfig = danrCfg;
-                }
-            } catch (...) {
-                LOGD("WARNING: danrConfig not found in config!");
-            }
+        uint32_t nameLength = static_cast<uint32_t>(std::min<size_t>(strlen(packageName), MAX_NAME_LENGTH));
+        uint8_t status;
+        if (!writeFully(fd, &nameLength, sizeof(nameLength)) || !writeFully(fd, packageName, nameLength) ||
+            !readFully(fd, &status, sizeof(status))) {
+            LOGE("Companion query failed: %s", strerror(errno));
+            close(fd);
+            return -1;
+        }
 
-            return true;
-        } catch (const std::exception& e) {
-            LOGE("Failed to parse config: %s", e.what());
-            return false;
+        if (status == QUERY_WHITELISTED) {
+            int64_t anrThresholdMs;
+            uint8_t flags;
+            uint16_t urlLength;
+            if (!readFully(fd, &anrThresholdMs, sizeof(anrThresholdMs)) || !readFully(fd, &flags, sizeof(flags)) ||
+                !readFully(fd, &urlLength, sizeof(urlLength))) {
+                LOGE("Companion reply truncated");
+                close(fd);
+                return -1;
+            }
+            settings.backendUrl.resize(urlLength);
+            if (!readFully(fd, &settings.backendUrl[0], urlLength)) {
+                LOGE("Companion reply truncated");
+                close(fd);
+                return -1;
+            }
+            settings.anrThresholdMs = static_cast<long>(anrThresholdMs);
+            settings.enableInRelease = flags & SETTING_ENABLE_IN_RELEASE;
+            settings.enableInDebug = flags & SETTING_ENABLE_IN_DEBUG;
+            settings.autoStart = flags & SETTING_AUTO_START;
         }
+
+        close(fd);
+        return status;
     }
 
     bool isWhitelisted(const char* packageName) {
         if (!packageName) return false;
 
-        std::string pkg(packageName);
-        for (const auto& whitelistedPkg : whitelist) {
-            if (pkg == whitelistedPkg) {
-                return true;
-            }
-        }
-        return false;
+        return whitelist.matches(packageName);
     }
 
 public:
@@ -126,13 +362,14 @@ public:
         const char* packageName = env->GetStringUTFChars(args->nice_name, nullptr);
         LOGD("Processing package: %s", packageName);
 
-        if (!loadConfig()) {
+        int status = queryCompanion(packageName);
+        if (status == QUERY_NO_CONFIG || (status < 0 && !loadConfig())) {
             LOGE("Failed to load config, skipping injection for %s", packageName);
             env->ReleaseStringUTFChars(args->nice_name, packageName);
             return;
         }
 
-        shouldInject = isWhitelisted(packageName);
+        shouldInject = status < 0 ? isWhitelisted(packageName) : status == QUERY_WHITELISTED;
 
         if (shouldInject) {
             LOGD("✓ Package '%s' IS whitelisted - will inject DANR", packageName);
@@ -405,12 +642,12 @@ private:
             return false;
         }
 
-        // Get config values from JSON (with defaults matching SDK)
-        std::string backendUrl = danrConfig.value("backendUrl", "http://localhost:8080");
-        long anrThresholdMs = danrConfig.value("anrThresholdMs", 5000L);
-        bool enableInRelease = danrConfig.value("enableInRelease", true);
-        bool enableInDebug = danrConfig.value("enableInDebug", true);
-        bool autoStart = danrConfig.value("autoStart", true);
+        // Config values from the companion or config.json (with defaults matching SDK)
+        const std::string& backendUrl = settings.backendUrl;
+        long anrThresholdMs = settings.anrThresholdMs;
+        bool enableInRelease = settings.enableInRelease;
+        bool enableInDebug = settings.enableInDebug;
+        bool autoStart = settings.autoStart;
 
         LOGD("  backendUrl: %s", backendUrl.c_str());
         LOGD("  anrThresholdMs: %ld", anrThresholdMs);
@@ -0,0 +1,175 @@
+#include "data_pattern.h"
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#elif defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+namespace danr {
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// ============================================================================
+// CRC32C
+// ============================================================================
+
+static uint32_t crcTable[256];
+
+static bool initCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+        crcTable[i] = crc;
+    }
+    return true;
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t* p, size_t n) {
+    static const bool tableReady = initCrcTable();
+    (void)tableReady;
+
+    while (n--) {
+        crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__aarch64__) && defined(__clang__)
+#define DANR_HAVE_HW_CRC32C 1
+
+__attribute__((target("crc")))
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t* p, size_t n) {
+    while (n >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __builtin_arm_crc32cd(crc, v);
+        p += 8;
+        n -= 8;
+    }
+    while (n--) {
+        crc = __builtin_arm_crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+static bool detectHardwareCrc() {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+#elif defined(__x86_64__) || defined(__i386__)
+#define DANR_HAVE_HW_CRC32C 1
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t* p, size_t n) {
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (n >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        n -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (n >= 4) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        n -= 4;
+    }
+    while (n--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+static bool detectHardwareCrc() {
+    return __builtin_cpu_supports("sse4.2");
+}
+#endif
+
+bool crc32cIsHardware() {
+#ifdef DANR_HAVE_HW_CRC32C
+    static const bool available = detectHardwareCrc();
+    return available;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFF;
+
+#ifdef DANR_HAVE_HW_CRC32C
+    if (crc32cIsHardware()) {
+        return ~crc32cHardware(crc, p, length);
+    }
+#endif
+
+    return ~crc32cSoftware(crc, p, length);
+}
+
+// ============================================================================
+// Block generation
+// ============================================================================
+
+void fillBlock(void* buffer, size_t length, uint64_t seed, uint64_t blockId, bool withCrc) {
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    size_t headerSize = length >= sizeof(BlockHeader) ? sizeof(BlockHeader) : 0;
+
+    // Payload words, independent of each other so the loop vectorizes
+    uint64_t base = splitmix64(seed ^ splitmix64(blockId));
+    size_t words = (length - headerSize) / sizeof(uint64_t);
+    uint64_t* out = reinterpret_cast<uint64_t*>(bytes + headerSize);
+    for (size_t i = 0; i < words; i++) {
+        out[i] = splitmix64(base + i);
+    }
+
+    // Tail bytes that do not fill a whole word
+    size_t tail = (length - headerSize) % sizeof(uint64_t);
+    if (tail > 0) {
+        uint64_t last = splitmix64(base + words);
+        memcpy(bytes + headerSize + words * sizeof(uint64_t), &last, tail);
+    }
+
+    if (headerSize == 0) return;
+
+    BlockHeader header;
+    header.magic = BLOCK_MAGIC;
+    header.seed = seed;
+    header.blockId = blockId;
+    header.length = static_cast<uint32_t>(length);
+    header.crc = withCrc ? crc32c(bytes + headerSize, length - headerSize) : 0;
+    memcpy(bytes, &header, sizeof(header));
+}
+
+BlockCheck verifyBlock(const void* buffer, size_t length) {
+    if (length < sizeof(BlockHeader)) return BlockCheck::NoHeader;
+
+    BlockHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != BLOCK_MAGIC) return BlockCheck::NoHeader;
+
+    if (header.length != length) return BlockCheck::Mismatch;
+
+    const uint8_t* payload = static_cast<const uint8_t*>(buffer) + sizeof(BlockHeader);
+    uint32_t crc = crc32c(payload, length - sizeof(BlockHeader));
+    return crc == header.crc ? BlockCheck::Ok : BlockCheck::Mismatch;
+}
+
+} // namespace danr
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace danr {
+
+// Header stamped at the start of every generated block. The payload that
+// follows is derived from (seed, blockId), so every I/O carries unique,
+// incompressible data and can be verified after reading it back.
+struct BlockHeader {
+    uint64_t magic;
+    uint64_t seed;
+    uint64_t blockId;
+    uint32_t length;     // Total block length including this header
+    uint32_t crc;        // CRC32C of the payload
+};
+
+static const uint64_t BLOCK_MAGIC = 0x44414e52424c4b31ULL;  // "DANRBLK1"
+
+enum class BlockCheck {
+    Ok,
+    Mismatch,
+    NoHeader     // Never written by us (e.g. freshly preallocated extent)
+};
+
+// Fills buffer with a header plus pseudo-random payload. The payload generator
+// is counter based (splitmix64 over the word index), which the compiler can
+// vectorize since no word depends on the previous one.
+void fillBlock(void* buffer, size_t length, uint64_t seed, uint64_t blockId, bool withCrc);
+
+// Recomputes the payload CRC and compares it with the stamped one
+BlockCheck verifyBlock(const void* buffer, size_t length);
+
+// CRC32C (Castagnoli) using ARMv8 CRC or SSE4.2 instructions when available
+uint32_t crc32c(const void* data, size_t length);
+bool crc32cIsHardware();
+
+} // namespace danr
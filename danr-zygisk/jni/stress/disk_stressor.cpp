@@ -1,17 +1,56 @@
 #include "disk_stressor.h"
+#include "data_pattern.h"
+#include "tunable_arbiter.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 #include <dirent.h>
 #include <android/log.h>
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-DiskStressor", __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-DiskStressor", __VA_ARGS__)
 
+#ifndef SYNC_FILE_RANGE_WAIT_BEFORE
+#define SYNC_FILE_RANGE_WAIT_BEFORE 1
+#define SYNC_FILE_RANGE_WRITE 2
+#define SYNC_FILE_RANGE_WAIT_AFTER 4
+#endif
+
 namespace danr {
 
+static const char* VM_DIRTY_RATIO = "/proc/sys/vm/dirty_ratio";
+static const char* VM_DIRTY_BACKGROUND_RATIO = "/proc/sys/vm/dirty_background_ratio";
+
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "disk";
+
+static bool isValidSyncMode(const std::string& mode) {
+    return mode == "none" || mode == "fsync" || mode == "fdatasync" || mode == "dsync" ||
+           mode == "sync_file_range" || mode == "syncfs";
+}
+
+static int syncFileRange(int fd, off_t offset, off_t length, unsigned int flags) {
+#if defined(__LP64__)
+    // Not exposed by bionic before API 26
+    return syscall(__NR_sync_file_range, fd, offset, length, flags);
+#else
+    // The 32-bit ABIs pass the 64-bit arguments in arch-specific register
+    // pairs, fall back to the coarser fdatasync there
+    (void)offset;
+    (void)length;
+    (void)flags;
+    return fdatasync(fd);
+#endif
+}
+
 DiskStressor::~DiskStressor() {
     stop();
 }
@@ -31,9 +70,31 @@ bool DiskStressor::start(const DiskStressConfig& config) {
         return false;
     }
 
+    if (config.mode != "mixed" && config.mode != "data" && config.mode != "metadata" &&
+        config.mode != "writeback") {
+        LOGE("Unknown disk stress mode: %s", config.mode.c_str());
+        return false;
+    }
+
+    if (!isValidSyncMode(config.syncMode)) {
+        LOGE("Unknown disk sync mode: %s", config.syncMode.c_str());
+        return false;
+    }
+
+    // Both size every buffer and offset; 0 would divide by zero in the
+    // data workers and a negative chunk wraps to a huge size_t
+    if (config.chunkSizeKB <= 0 || config.fileSizeMB <= 0) {
+        LOGE("Invalid disk chunk size %d KB or file size %d MB", config.chunkSizeKB, config.fileSizeMB);
+        return false;
+    }
+
     {
         std::lock_guard<std::mutex> lock(mutex_);
         config_ = config;
+        // syncWrites predates syncMode and means an fsync per write
+        if (config_.syncWrites && config_.syncMode == "none") {
+            config_.syncMode = "fsync";
+        }
     }
 
     if (!ensureDirectory(config.testPath)) {
@@ -45,11 +106,52 @@ bool DiskStressor::start(const DiskStressConfig& config) {
     markStarted();
     bytesWritten_.store(0);
     bytesRead_.store(0);
+    dataOps_.store(0);
+    metadataOps_.store(0);
+    dataOpsPerSec_.store(0);
+    metadataOpsPerSec_.store(0);
+
+    RateLimits limits;
+    limits.totalBytesPerSec = static_cast<long>(config.throughputMBps) * 1024 * 1024;
+    limits.readBytesPerSec = static_cast<long>(config.readKBps) * 1024;
+    limits.writeBytesPerSec = static_cast<long>(config.writeKBps) * 1024;
+    limits.readIops = config.readIops;
+    limits.writeIops = config.writeIops;
+    limiter_.configure(limits);
+
+    int workerCount = std::max(config.workerCount, 1);
+
+    LOGD("Starting disk stress (%s mode): %d workers, %d MB/s throughput, %d KB chunks for %ld ms",
+         config.mode.c_str(), workerCount, config.throughputMBps, config.chunkSizeKB,
+         config.durationMs);
+
+    // A fresh seed per run keeps blocks unique across runs as well
+    seed_ = static_cast<uint64_t>(config.seed);
+    if (seed_ == 0) {
+        seed_ = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+    verifiedBlocks_.store(0);
+    checksumErrors_.store(0);
 
-    LOGD("Starting disk stress: %d MB/s throughput, %d KB chunks for %ld ms",
-         config.throughputMBps, config.chunkSizeKB, config.durationMs);
+    applyDirtyRatios();
 
-    workerThread_ = std::thread(&DiskStressor::workerFunction, this);
+    flushes_.store(0);
+    lastFlushMs_.store(0);
+    maxFlushMs_.store(0);
+    {
+        std::lock_guard<std::mutex> lock(probeMutex_);
+        probeLatenciesUs_.clear();
+    }
+
+    activeWorkers_.store(workerCount);
+    workerThreads_.clear();
+    for (int i = 0; i < workerCount; i++) {
+        workerThreads_.emplace_back(&DiskStressor::workerFunction, this, i);
+    }
+
+    if (config.latencyProbe) {
+        probeThread_ = std::thread(&DiskStressor::probeFunction, this);
+    }
     return true;
 }
 
@@ -63,10 +165,18 @@ void DiskStressor::stop() {
 
     // Always try to join and cleanup, even if already stopped
     // (handles case where duration expired naturally)
-    if (workerThread_.joinable()) {
-        workerThread_.join();
+    for (auto& thread : workerThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    workerThreads_.clear();
+
+    if (probeThread_.joinable()) {
+        probeThread_.join();
     }
 
+    restoreDirtyRatios();
     cleanup();
 
     if (wasRunning) {
@@ -74,26 +184,23 @@ void DiskStressor::stop() {
     }
 }
 
-void DiskStressor::workerFunction() {
-    int throughputMBps;
+void DiskStressor::workerFunction(int workerId) {
+    std::string mode;
     int chunkSizeKB;
-    std::string testPath;
     bool useDirectIO;
-    bool syncWrites;
+    bool verify;
     long endTime;
 
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        throughputMBps = config_.throughputMBps;
+        mode = config_.mode;
         chunkSizeKB = config_.chunkSizeKB;
-        testPath = config_.testPath;
         useDirectIO = config_.useDirectIO;
-        syncWrites = config_.syncWrites;
+        verify = config_.verify;
         endTime = startTimeMs_.load() + durationMs_.load();
     }
 
     const size_t chunkSize = static_cast<size_t>(chunkSizeKB) * 1024;
-    const long targetBytesPerSecond = static_cast<long>(throughputMBps) * 1024 * 1024;
 
     // Allocate aligned buffer for O_DIRECT
     void* alignedBuffer = nullptr;
@@ -110,23 +217,74 @@ void DiskStressor::workerFunction() {
         buffer = new char[chunkSize];
     }
 
-    // Fill buffer with random data
-    for (size_t i = 0; i < chunkSize; i++) {
-        buffer[i] = static_cast<char>(rand() % 256);
+    // Initial contents, used as-is by the metadata mode payloads
+    fillBlock(buffer, chunkSize, seed_, static_cast<uint64_t>(workerId) << 48, verify);
+
+    if (workerId == 0) {
+        std::lock_guard<std::mutex> lock(rateMutex_);
+        rateWindowStartMs_ = getCurrentTimeMs();
+        rateWindowDataOps_ = 0;
+        rateWindowMetadataOps_ = 0;
+    }
+
+    if (mode == "data") {
+        runDataWorkload(workerId, buffer, chunkSize, endTime);
+    } else if (mode == "writeback") {
+        runWritebackWorkload(workerId, buffer, chunkSize, endTime);
+    } else if (mode == "metadata") {
+        runMetadataWorkload(workerId, buffer, endTime);
+    } else {
+        runMixedWorkload(workerId, buffer, chunkSize, endTime);
+    }
+
+    // Cleanup buffer
+    if (alignedBuffer) {
+        free(alignedBuffer);
+    } else {
+        delete[] buffer;
+    }
+
+    // Mark as stopped when duration expires naturally
+    markStopped();
+
+    // The last worker out removes the temp files, the others may still use them
+    if (activeWorkers_.fetch_sub(1) == 1) {
+        restoreDirtyRatios();
+        cleanup();
     }
 
+    LOGD("Disk stress worker %d completed", workerId);
+}
+
+void DiskStressor::runMixedWorkload(int workerId, char* buffer, size_t chunkSize, long endTime) {
+    std::string testPath;
+    bool useDirectIO;
+    std::string syncMode;
+    bool verify;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        testPath = config_.testPath;
+        useDirectIO = config_.useDirectIO;
+        syncMode = config_.syncMode;
+        verify = config_.verify;
+    }
+
+    const std::string filePrefix = testPath + "/stress_" + std::to_string(workerId) + "_";
     int fileCounter = 0;
-    long cycleStartTime = getCurrentTimeMs();
-    long bytesThisCycle = 0;
+    uint64_t blockCounter = 1;
 
     while (running_.load() && getCurrentTimeMs() < endTime) {
-        std::string filePath = testPath + "/stress_" + std::to_string(fileCounter++) + ".tmp";
+        std::string filePath = filePrefix + std::to_string(fileCounter++) + ".tmp";
 
         // Open file for writing
         int flags = O_WRONLY | O_CREAT | O_TRUNC;
         if (useDirectIO) {
             flags |= O_DIRECT;
         }
+        if (syncMode == "dsync") {
+            flags |= O_DSYNC;
+        }
 
         int fd = open(filePath.c_str(), flags, 0644);
         if (fd < 0) {
@@ -136,15 +294,15 @@ void DiskStressor::workerFunction() {
         }
 
         // Write data
+        fillBlock(buffer, chunkSize, seed_,
+                  (static_cast<uint64_t>(workerId) << 48) | blockCounter++, verify);
+        limiter_.acquire(RateLimiter::Op::Write, chunkSize);
         ssize_t written = write(fd, buffer, chunkSize);
         if (written > 0) {
             bytesWritten_.fetch_add(written);
-            bytesThisCycle += written;
         }
 
-        if (syncWrites) {
-            fsync(fd);
-        }
+        flushWrites(fd, syncMode, 0, chunkSize);
 
         close(fd);
 
@@ -156,10 +314,13 @@ void DiskStressor::workerFunction() {
 
         fd = open(filePath.c_str(), flags);
         if (fd >= 0) {
+            limiter_.acquire(RateLimiter::Op::Read, chunkSize);
             ssize_t readBytes = read(fd, buffer, chunkSize);
             if (readBytes > 0) {
                 bytesRead_.fetch_add(readBytes);
-                bytesThisCycle += readBytes;
+            }
+            if (verify && readBytes == static_cast<ssize_t>(chunkSize)) {
+                checkReadBack(buffer, chunkSize, filePath.c_str(), 0);
             }
             close(fd);
         }
@@ -167,39 +328,378 @@ void DiskStressor::workerFunction() {
         // Delete the file
         unlink(filePath.c_str());
 
-        // Throttle to achieve target throughput
-        long elapsed = getCurrentTimeMs() - cycleStartTime;
-        if (elapsed > 0) {
-            long expectedBytes = (targetBytesPerSecond * elapsed) / 1000;
-            if (bytesThisCycle > expectedBytes) {
-                long sleepMs = ((bytesThisCycle - expectedBytes) * 1000) / targetBytesPerSecond;
-                if (sleepMs > 0 && sleepMs < 1000) {
-                    usleep(sleepMs * 1000);
+        // Each iteration is a write + read pair and a create + unlink pair
+        dataOps_.fetch_add(2);
+        metadataOps_.fetch_add(2);
+        updateRates();
+    }
+}
+
+void DiskStressor::runDataWorkload(int workerId, char* buffer, size_t chunkSize, long endTime) {
+    std::string testPath;
+    bool useDirectIO;
+    std::string syncMode;
+    int fileCount;
+    off_t fileSize;
+    int readPercent;
+    bool verify;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        testPath = config_.testPath;
+        useDirectIO = config_.useDirectIO;
+        syncMode = config_.syncMode;
+        fileCount = std::max(config_.fileCount, 1);
+        fileSize = static_cast<off_t>(config_.fileSizeMB) * 1024 * 1024;
+        readPercent = std::min(std::max(config_.readPercent, 0), 100);
+        verify = config_.verify;
+    }
+
+    if (fileSize < static_cast<off_t>(chunkSize)) {
+        fileSize = static_cast<off_t>(chunkSize);
+    }
+    const long chunksPerFile = static_cast<long>(fileSize / chunkSize);
+
+    // Phase 1: Preallocate the file set so the measured phase does no allocation
+    std::vector<int> fds;
+    for (int i = 0; i < fileCount && running_.load(); i++) {
+        std::string filePath = testPath + "/stress_data_" + std::to_string(workerId) + "_" +
+                               std::to_string(i) + ".tmp";
+
+        int flags = O_RDWR | O_CREAT;
+        if (useDirectIO) {
+            flags |= O_DIRECT;
+        }
+        if (syncMode == "dsync") {
+            flags |= O_DSYNC;
+        }
+
+        int fd = open(filePath.c_str(), flags, 0644);
+        if (fd < 0) {
+            LOGE("Failed to create data file %s: %s", filePath.c_str(), strerror(errno));
+            continue;
+        }
+
+        if (fallocate(fd, 0, 0, fileSize) != 0) {
+            // Filesystem without fallocate support, write the extents out instead
+            LOGD("fallocate failed on %s (%s), filling file", filePath.c_str(), strerror(errno));
+            for (off_t off = 0; off + static_cast<off_t>(chunkSize) <= fileSize && running_.load();
+                 off += chunkSize) {
+                if (pwrite(fd, buffer, chunkSize, off) < 0) break;
+            }
+        }
+        fsync(fd);
+        fds.push_back(fd);
+    }
+
+    if (fds.empty()) {
+        LOGE("No data files could be preallocated");
+    } else {
+        LOGD("Preallocated %zu data files of %ld MB", fds.size(),
+             static_cast<long>(fileSize / (1024 * 1024)));
+    }
+
+    // Phase 2: In-place random I/O over the file set
+    uint64_t blockCounter = 1;
+    while (!fds.empty() && running_.load() && getCurrentTimeMs() < endTime) {
+        size_t fileIndex = rand() % fds.size();
+        int fd = fds[fileIndex];
+        off_t offset = static_cast<off_t>(rand() % chunksPerFile) * chunkSize;
+
+        if (rand() % 100 < readPercent) {
+            limiter_.acquire(RateLimiter::Op::Read, chunkSize);
+            ssize_t readBytes = pread(fd, buffer, chunkSize, offset);
+            if (readBytes > 0) {
+                bytesRead_.fetch_add(readBytes);
+            }
+            if (verify && readBytes == static_cast<ssize_t>(chunkSize)) {
+                std::string name = "stress_data_" + std::to_string(workerId) + "_" +
+                                   std::to_string(fileIndex) + ".tmp";
+                checkReadBack(buffer, chunkSize, name.c_str(), offset);
+            }
+        } else {
+            fillBlock(buffer, chunkSize, seed_,
+                      (static_cast<uint64_t>(workerId) << 48) | blockCounter++, verify);
+            limiter_.acquire(RateLimiter::Op::Write, chunkSize);
+            ssize_t written = pwrite(fd, buffer, chunkSize, offset);
+            if (written > 0) {
+                bytesWritten_.fetch_add(written);
+            }
+            flushWrites(fd, syncMode, offset, chunkSize);
+        }
+
+        dataOps_.fetch_add(1);
+        updateRates();
+    }
+
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+void DiskStressor::runMetadataWorkload(int workerId, char* buffer, long endTime) {
+    std::string testPath;
+    int fileCount;
+    int dirCount;
+    size_t payloadSize;
+    std::string syncMode;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        testPath = config_.testPath;
+        fileCount = std::max(config_.metadataFileCount, 1);
+        dirCount = std::max(config_.metadataDirCount, 1);
+        payloadSize = static_cast<size_t>(std::max(config_.metadataFileSizeKB, 0)) * 1024;
+        // The payload comes out of the shared chunk buffer
+        payloadSize = std::min(payloadSize, static_cast<size_t>(config_.chunkSizeKB) * 1024);
+        syncMode = config_.syncMode;
+    }
+
+    // Build the directory tree the files are spread across
+    std::vector<std::string> dirs;
+    for (int d = 0; d < dirCount; d++) {
+        std::string dir = testPath + "/stress_meta_" + std::to_string(workerId) + "_" +
+                          std::to_string(d);
+        if (!ensureDirectory(dir)) {
+            LOGE("Failed to create metadata directory: %s", dir.c_str());
+            continue;
+        }
+        dirs.push_back(dir);
+    }
+
+    if (dirs.empty()) {
+        return;
+    }
+
+    LOGD("Metadata storm: %d files across %zu directories", fileCount, dirs.size());
+
+    char src[512];
+    char dst[512];
+    struct stat st;
+
+    while (running_.load() && getCurrentTimeMs() < endTime) {
+        // Create
+        for (int i = 0; i < fileCount && running_.load(); i++) {
+            snprintf(src, sizeof(src), "%s/f_%d", dirs[i % dirs.size()].c_str(), i);
+            int fd = open(src, O_WRONLY | O_CREAT | O_TRUNC | (syncMode == "dsync" ? O_DSYNC : 0),
+                          0644);
+            if (fd < 0) continue;
+            if (payloadSize > 0) {
+                limiter_.acquire(RateLimiter::Op::Write, payloadSize);
+                ssize_t written = write(fd, buffer, payloadSize);
+                if (written > 0) {
+                    bytesWritten_.fetch_add(written);
                 }
             }
+            flushWrites(fd, syncMode, 0, payloadSize);
+            close(fd);
+            metadataOps_.fetch_add(1);
+            updateRates();
+        }
+
+        // Rename into the neighbouring directory
+        for (int i = 0; i < fileCount && running_.load(); i++) {
+            snprintf(src, sizeof(src), "%s/f_%d", dirs[i % dirs.size()].c_str(), i);
+            snprintf(dst, sizeof(dst), "%s/r_%d", dirs[(i + 1) % dirs.size()].c_str(), i);
+            if (rename(src, dst) == 0) {
+                metadataOps_.fetch_add(1);
+            }
+            updateRates();
         }
 
-        // Reset cycle counters every second
-        if (elapsed >= 1000) {
-            cycleStartTime = getCurrentTimeMs();
-            bytesThisCycle = 0;
+        // Stat
+        for (int i = 0; i < fileCount && running_.load(); i++) {
+            snprintf(dst, sizeof(dst), "%s/r_%d", dirs[(i + 1) % dirs.size()].c_str(), i);
+            if (stat(dst, &st) == 0) {
+                metadataOps_.fetch_add(1);
+            }
+            updateRates();
+        }
+
+        // Unlink (also sweeps up files left by an interrupted round)
+        for (int i = 0; i < fileCount; i++) {
+            snprintf(src, sizeof(src), "%s/f_%d", dirs[i % dirs.size()].c_str(), i);
+            snprintf(dst, sizeof(dst), "%s/r_%d", dirs[(i + 1) % dirs.size()].c_str(), i);
+            unlink(src);
+            if (unlink(dst) == 0) {
+                metadataOps_.fetch_add(1);
+            }
+            updateRates();
         }
     }
+}
 
-    // Cleanup buffer
-    if (alignedBuffer) {
-        free(alignedBuffer);
-    } else {
-        delete[] buffer;
+void DiskStressor::runWritebackWorkload(int workerId, char* buffer, size_t chunkSize, long endTime) {
+    std::string testPath;
+    std::string syncMode;
+    off_t dirtySetSize;
+    bool verify;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        testPath = config_.testPath;
+        syncMode = config_.syncMode;
+        dirtySetSize = static_cast<off_t>(std::max(config_.dirtySetMB, 1)) * 1024 * 1024;
+        verify = config_.verify;
     }
 
-    // Mark as stopped when duration expires naturally
-    markStopped();
+    // Buffered I/O only, the point is to build up dirty page cache
+    std::string filePath = testPath + "/stress_wb_" + std::to_string(workerId) + ".tmp";
+    int flags = O_RDWR | O_CREAT;
+    if (syncMode == "dsync") {
+        flags |= O_DSYNC;
+    }
 
-    // Clean up temp files
-    cleanup();
+    int fd = open(filePath.c_str(), flags, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open writeback file %s: %s", filePath.c_str(), strerror(errno));
+        return;
+    }
+
+    uint64_t blockCounter = 1;
+
+    while (running_.load() && getCurrentTimeMs() < endTime) {
+        // Phase 1: Dirty the whole set. With syncMode "none" the kernel's own
+        // writeback (balance_dirty_pages) is what throttles these writes.
+        for (off_t offset = 0; offset < dirtySetSize && running_.load(); offset += chunkSize) {
+            fillBlock(buffer, chunkSize, seed_,
+                      (static_cast<uint64_t>(workerId) << 48) | blockCounter++, verify);
+            limiter_.acquire(RateLimiter::Op::Write, chunkSize);
+            ssize_t written = pwrite(fd, buffer, chunkSize, offset);
+            if (written > 0) {
+                bytesWritten_.fetch_add(written);
+            }
+            dataOps_.fetch_add(1);
+            updateRates();
+        }
+
+        // Phase 2: Flush it in one go
+        auto flushStart = std::chrono::steady_clock::now();
+        flushWrites(fd, syncMode, 0, dirtySetSize);
+        long flushMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - flushStart).count();
+
+        if (syncMode != "none" && syncMode != "dsync") {
+            flushes_.fetch_add(1);
+            lastFlushMs_.store(flushMs);
+            long prevMax = maxFlushMs_.load();
+            while (flushMs > prevMax && !maxFlushMs_.compare_exchange_weak(prevMax, flushMs)) {
+            }
+        }
+    }
 
-    LOGD("Disk stress worker completed");
+    close(fd);
+}
+
+void DiskStressor::checkReadBack(const char* buffer, size_t length, const char* file, off_t offset) {
+    BlockCheck result = verifyBlock(buffer, length);
+    if (result == BlockCheck::Ok) {
+        verifiedBlocks_.fetch_add(1);
+    } else if (result == BlockCheck::Mismatch) {
+        checksumErrors_.fetch_add(1);
+        LOGE("Checksum mismatch in %s at offset %lld", file, static_cast<long long>(offset));
+    }
+}
+
+void DiskStressor::flushWrites(int fd, const std::string& syncMode, off_t offset, size_t length) {
+    if (syncMode == "fsync") {
+        fsync(fd);
+    } else if (syncMode == "fdatasync") {
+        fdatasync(fd);
+    } else if (syncMode == "sync_file_range") {
+        syncFileRange(fd, offset, length,
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                      SYNC_FILE_RANGE_WAIT_AFTER);
+    } else if (syncMode == "syncfs") {
+        syscall(__NR_syncfs, fd);
+    }
+    // "dsync" is handled by O_DSYNC at open time, "none" leaves it to the kernel
+}
+
+void DiskStressor::probeFunction() {
+    std::string testPath;
+    int intervalMs;
+    long endTime;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        testPath = config_.testPath;
+        intervalMs = std::max(config_.probeIntervalMs, 1);
+        endTime = startTimeMs_.load() + durationMs_.load();
+    }
+
+    std::string probePath = testPath + "/stress_probe.tmp";
+    int fd = open(probePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open latency probe file: %s", strerror(errno));
+        return;
+    }
+
+    // Small synchronous write, the same pattern as a SharedPreferences commit
+    char block[4096];
+    memset(block, 0x5A, sizeof(block));
+
+    while (running_.load() && getCurrentTimeMs() < endTime) {
+        auto start = std::chrono::steady_clock::now();
+        if (pwrite(fd, block, sizeof(block), 0) == static_cast<ssize_t>(sizeof(block))) {
+            fdatasync(fd);
+        }
+        long latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(probeMutex_);
+            if (probeLatenciesUs_.size() >= MAX_PROBE_SAMPLES) {
+                probeLatenciesUs_.erase(probeLatenciesUs_.begin());
+            }
+            probeLatenciesUs_.push_back(latencyUs);
+        }
+
+        usleep(intervalMs * 1000);
+    }
+
+    close(fd);
+    unlink(probePath.c_str());
+}
+
+void DiskStressor::applyDirtyRatios() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int dirtyRatio = config_.dirtyRatio;
+    int dirtyBackgroundRatio = config_.dirtyBackgroundRatio;
+
+    // The arbiter keeps the values found beforehand for restoreDirtyRatios
+    TunableArbiter& arbiter = TunableArbiter::getInstance();
+    if (dirtyRatio >= 0 &&
+        arbiter.request(VM_DIRTY_RATIO, ARBITER_OWNER, dirtyRatio, TunableCombine::Override)) {
+        LOGD("Set vm.dirty_ratio to %d", dirtyRatio);
+    }
+    if (dirtyBackgroundRatio >= 0 &&
+        arbiter.request(VM_DIRTY_BACKGROUND_RATIO, ARBITER_OWNER, dirtyBackgroundRatio, TunableCombine::Override)) {
+        LOGD("Set vm.dirty_background_ratio to %d", dirtyBackgroundRatio);
+    }
+}
+
+void DiskStressor::restoreDirtyRatios() {
+    TunableArbiter::getInstance().releaseAll(ARBITER_OWNER);
+}
+
+void DiskStressor::updateRates() {
+    // Whichever worker gets here first samples the window, the others skip
+    std::unique_lock<std::mutex> lock(rateMutex_, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+
+    long now = getCurrentTimeMs();
+    long elapsed = now - rateWindowStartMs_;
+    if (elapsed < 1000) return;
+
+    long dataOps = dataOps_.load();
+    long metadataOps = metadataOps_.load();
+    dataOpsPerSec_.store(((dataOps - rateWindowDataOps_) * 1000) / elapsed);
+    metadataOpsPerSec_.store(((metadataOps - rateWindowMetadataOps_) * 1000) / elapsed);
+
+    rateWindowStartMs_ = now;
+    rateWindowDataOps_ = dataOps;
+    rateWindowMetadataOps_ = metadataOps;
 }
 
 void DiskStressor::cleanup() {
@@ -214,7 +714,21 @@ void DiskStressor::cleanup() {
     if (dir) {
         struct dirent* entry;
         while ((entry = readdir(dir)) != nullptr) {
-            if (strstr(entry->d_name, "stress_") && strstr(entry->d_name, ".tmp")) {
+            if (strncmp(entry->d_name, "stress_meta_", 12) == 0) {
+                // Metadata mode directory tree, one level deep
+                std::string subPath = testPath + "/" + entry->d_name;
+                DIR* subDir = opendir(subPath.c_str());
+                if (subDir) {
+                    struct dirent* subEntry;
+                    while ((subEntry = readdir(subDir)) != nullptr) {
+                        if (subEntry->d_name[0] == '.') continue;
+                        std::string filePath = subPath + "/" + subEntry->d_name;
+                        unlink(filePath.c_str());
+                    }
+                    closedir(subDir);
+                }
+                rmdir(subPath.c_str());
+            } else if (strstr(entry->d_name, "stress_") && strstr(entry->d_name, ".tmp")) {
                 std::string filePath = testPath + "/" + entry->d_name;
                 unlink(filePath.c_str());
             }
@@ -245,6 +759,52 @@ StressStatus DiskStressor::getStatus() const {
         status.data["bytesWrittenMB"] = std::to_string(bytesWritten_.load() / (1024 * 1024));
         status.data["bytesReadMB"] = std::to_string(bytesRead_.load() / (1024 * 1024));
         status.data["throughputMBps"] = std::to_string(config_.throughputMBps);
+        status.data["mode"] = config_.mode;
+        status.data["dataOps"] = std::to_string(dataOps_.load());
+        status.data["dataOpsPerSec"] = std::to_string(dataOpsPerSec_.load());
+        status.data["metadataOps"] = std::to_string(metadataOps_.load());
+        status.data["metadataOpsPerSec"] = std::to_string(metadataOpsPerSec_.load());
+        status.data["workerCount"] = std::to_string(config_.workerCount);
+        status.data["syncMode"] = config_.syncMode;
+
+        if (config_.verify) {
+            status.data["verifiedBlocks"] = std::to_string(verifiedBlocks_.load());
+            status.data["checksumErrors"] = std::to_string(checksumErrors_.load());
+            status.data["crc32c"] = crc32cIsHardware() ? "hardware" : "software";
+        }
+
+        if (config_.mode == "writeback") {
+            status.data["dirtySetMB"] = std::to_string(config_.dirtySetMB);
+            status.data["flushes"] = std::to_string(flushes_.load());
+            status.data["lastFlushMs"] = std::to_string(lastFlushMs_.load());
+            status.data["maxFlushMs"] = std::to_string(maxFlushMs_.load());
+        }
+
+        if (config_.latencyProbe) {
+            std::vector<long> samples;
+            {
+                std::lock_guard<std::mutex> probeLock(probeMutex_);
+                samples = probeLatenciesUs_;
+            }
+            status.data["probeSamples"] = std::to_string(samples.size());
+            if (!samples.empty()) {
+                std::sort(samples.begin(), samples.end());
+                status.data["probeP50Us"] = std::to_string(samples[samples.size() / 2]);
+                status.data["probeP99Us"] = std::to_string(samples[(samples.size() * 99) / 100]);
+                status.data["probeMaxUs"] = std::to_string(samples.back());
+            }
+        }
+
+        RateLimits limits = limiter_.getLimits();
+        RateLimiterStats achieved = limiter_.getStats();
+        status.data["targetReadKBps"] = std::to_string(limits.readBytesPerSec / 1024);
+        status.data["targetWriteKBps"] = std::to_string(limits.writeBytesPerSec / 1024);
+        status.data["targetReadIops"] = std::to_string(limits.readIops);
+        status.data["targetWriteIops"] = std::to_string(limits.writeIops);
+        status.data["achievedReadKBps"] = std::to_string(achieved.readBytesPerSec / 1024);
+        status.data["achievedWriteKBps"] = std::to_string(achieved.writeBytesPerSec / 1024);
+        status.data["achievedReadIops"] = std::to_string(achieved.readIops);
+        status.data["achievedWriteIops"] = std::to_string(achieved.writeIops);
     }
 
     return status;
@@ -1,18 +1,53 @@
 #pragma once
 
 #include "stressor_base.h"
+#include "rate_limiter.h"
 #include <thread>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
 
 namespace danr {
 
 struct DiskStressConfig {
-    int throughputMBps = 5;       // Target throughput in MB/s
+    std::string mode = "mixed";   // "mixed", "data", "metadata" or "writeback"
+    int throughputMBps = 5;       // Combined read + write budget in MB/s, 0 = unlimited
+    int readKBps = 0;             // Read budget in KB/s, 0 = unlimited
+    int writeKBps = 0;            // Write budget in KB/s, 0 = unlimited
+    int readIops = 0;             // Read operations per second, 0 = unlimited
+    int writeIops = 0;            // Write operations per second, 0 = unlimited
+    int workerCount = 1;          // Parallel workers sharing the budgets above
     int chunkSizeKB = 100;        // Write chunk size in KB
     long durationMs = 300000;     // 5 minutes default
     std::string testPath = "/data/local/tmp/danr_stress";
     bool useDirectIO = false;     // Use O_DIRECT to bypass cache (root)
-    bool syncWrites = false;      // Force sync after each write
+    bool syncWrites = false;      // Force sync after each write (same as syncMode "fsync")
+    std::string syncMode = "none"; // "none", "fsync", "fdatasync", "dsync", "sync_file_range", "syncfs"
+
+    // Data mode: preallocated file set with in-place I/O
+    int fileCount = 4;            // Number of preallocated files
+    int fileSizeMB = 64;          // Size of each preallocated file
+    int readPercent = 50;         // Share of I/O operations that are reads (0-100)
+
+    // Metadata mode: create/rename/stat/unlink storm across a directory tree
+    int metadataFileCount = 2000; // Files created per round
+    int metadataDirCount = 16;    // Directories the files are spread across
+    int metadataFileSizeKB = 4;   // Payload written into each file (0 = empty)
+
+    // Writeback mode: dirty a large page set, then flush it with syncMode
+    int dirtySetMB = 256;         // Dirty data built up per worker before each flush
+    int dirtyRatio = -1;          // vm.dirty_ratio override, -1 = unchanged (root)
+    int dirtyBackgroundRatio = -1; // vm.dirty_background_ratio override, -1 = unchanged (root)
+
+    // Every write carries a seeded block header; verify checks read-back data
+    // against the CRC32C stamped in it
+    bool verify = false;
+    long seed = 0;                // 0 = new seed per run
+
+    // Small synchronous writes on a separate thread to measure writeback latency
+    bool latencyProbe = false;
+    int probeIntervalMs = 100;
 };
 
 class DiskStressor : public StressorBase {
@@ -30,11 +65,44 @@ public:
 
 private:
     DiskStressConfig config_;
-    std::thread workerThread_;
+    std::vector<std::thread> workerThreads_;
+    std::atomic<int> activeWorkers_{0};
+    RateLimiter limiter_;
+    std::thread probeThread_;
     std::atomic<long> bytesWritten_{0};
     std::atomic<long> bytesRead_{0};
+    std::atomic<long> dataOps_{0};
+    std::atomic<long> metadataOps_{0};
+    std::atomic<long> dataOpsPerSec_{0};
+    std::atomic<long> metadataOpsPerSec_{0};
+    std::atomic<long> verifiedBlocks_{0};
+    std::atomic<long> checksumErrors_{0};
+    uint64_t seed_ = 0;
+    std::atomic<long> flushes_{0};
+    std::atomic<long> lastFlushMs_{0};
+    std::atomic<long> maxFlushMs_{0};
+
+    static const size_t MAX_PROBE_SAMPLES = 4096;
+    mutable std::mutex probeMutex_;
+    std::vector<long> probeLatenciesUs_;
+
+    // Per-second rate sampling, done by whichever worker holds rateMutex_
+    std::mutex rateMutex_;
+    long rateWindowStartMs_ = 0;
+    long rateWindowDataOps_ = 0;
+    long rateWindowMetadataOps_ = 0;
 
-    void workerFunction();
+    void workerFunction(int workerId);
+    void runMixedWorkload(int workerId, char* buffer, size_t chunkSize, long endTime);
+    void runDataWorkload(int workerId, char* buffer, size_t chunkSize, long endTime);
+    void runMetadataWorkload(int workerId, char* buffer, long endTime);
+    void runWritebackWorkload(int workerId, char* buffer, size_t chunkSize, long endTime);
+    void checkReadBack(const char* buffer, size_t length, const char* file, off_t offset);
+    void flushWrites(int fd, const std::string& syncMode, off_t offset, size_t length);
+    void probeFunction();
+    void applyDirtyRatios();
+    void restoreDirtyRatios();
+    void updateRates();
     void cleanup();
     bool ensureDirectory(const std::string& path);
 };
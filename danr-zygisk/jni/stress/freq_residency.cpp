@@ -0,0 +1,200 @@
+#include "freq_residency.h"
+#include "monotonic_clock.h"
+#include "sysfs_accessor.h"
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-FreqResidency", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-FreqResidency", __VA_ARGS__)
+
+namespace danr {
+
+static const char* CPU_SYSFS = "/sys/devices/system/cpu";
+
+// One line per frequency; a big.LITTLE prime core has about 30
+static const size_t TIME_IN_STATE_BUFFER_SIZE = 4096;
+
+FreqResidency::FreqResidency(const std::string& policyPath) {
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+    curFreq_ = sysfs.attribute(policyPath + "/scaling_cur_freq");
+    maxFreq_ = sysfs.attribute(policyPath + "/scaling_max_freq");
+    timeInState_ = sysfs.attribute(policyPath + "/stats/time_in_state");
+    totalTrans_ = sysfs.attribute(policyPath + "/stats/total_trans");
+}
+
+void FreqResidency::start() {
+    baselineTicks_.clear();
+    readTimeInState(&baselineTicks_);
+    baselineTransitions_ = totalTrans_->readLong(-1L);
+
+    curFreqUs_.clear();
+    sampledUs_ = 0;
+    atCapUs_ = 0;
+    capFreqUs_ = 0;
+    samples_ = 0;
+
+    startUs_ = lastSampleUs_ = monotonicUs();
+    lastCurFreq_ = curFreq_->readLong(0L);
+    lastCapFreq_ = maxFreq_->readLong(0L);
+    started_ = true;
+    stopped_ = false;
+}
+
+void FreqResidency::stop() {
+    if (!started_ || stopped_) return;
+    sample();
+    finalTicks_.clear();
+    readTimeInState(&finalTicks_);
+    finalTransitions_ = totalTrans_->readLong(-1L);
+    stopUs_ = lastSampleUs_;
+    stopped_ = true;
+}
+
+void FreqResidency::sample() {
+    if (!started_ || stopped_) return;
+
+    // The frequency read last time is taken to have held until now
+    long nowUs = monotonicUs();
+    long intervalUs = nowUs - lastSampleUs_;
+    if (lastCurFreq_ > 0 && intervalUs > 0) {
+        curFreqUs_[lastCurFreq_] += intervalUs;
+        sampledUs_ += intervalUs;
+        capFreqUs_ += static_cast<double>(lastCapFreq_) * intervalUs;
+        if (lastCapFreq_ > 0 && lastCurFreq_ >= lastCapFreq_) {
+            atCapUs_ += intervalUs;
+        }
+    }
+
+    lastSampleUs_ = nowUs;
+    lastCurFreq_ = curFreq_->readLong(0L);
+    lastCapFreq_ = maxFreq_->readLong(0L);
+    samples_++;
+}
+
+FreqResidencyStats FreqResidency::stats() const {
+    FreqResidencyStats stats;
+    if (!started_) return stats;
+
+    stats.elapsedMs = ((stopped_ ? stopUs_ : monotonicUs()) - startUs_) / 1000;
+    stats.samples = samples_;
+
+    long transitions = stopped_ ? finalTransitions_ : totalTrans_->readLong(-1L);
+    stats.transitions = (transitions >= 0 && baselineTransitions_ >= 0) ?
+        std::max(0L, transitions - baselineTransitions_) : -1;
+
+    // time_in_state counts in USER_HZ ticks. A missing baseline entry (a
+    // frequency that only appeared after a table change) started at zero.
+    std::map<long, long> ticks;
+    if (stopped_) {
+        ticks = finalTicks_;
+    } else {
+        readTimeInState(&ticks);
+    }
+    long ticksPerSec = sysconf(_SC_CLK_TCK);
+    double weightedMs = 0;
+    long totalMs = 0;
+    if (ticksPerSec > 0) {
+        for (const auto& entry : ticks) {
+            auto baseline = baselineTicks_.find(entry.first);
+            long delta = entry.second - (baseline != baselineTicks_.end() ? baseline->second : 0);
+            long ms = std::max(0L, delta) * 1000 / ticksPerSec;
+            stats.timeInStateMs.push_back({ entry.first, ms });
+            weightedMs += static_cast<double>(entry.first) * ms;
+            totalMs += ms;
+        }
+    }
+
+    double weightedUs = 0;
+    for (const auto& entry : curFreqUs_) {
+        stats.curFreqHistogramMs.push_back({ entry.first, entry.second / 1000 });
+        weightedUs += static_cast<double>(entry.first) * entry.second;
+    }
+
+    if (totalMs > 0) {
+        stats.source = "time_in_state";
+        stats.effectiveFreq = static_cast<long>(weightedMs / totalMs);
+    } else if (sampledUs_ > 0) {
+        stats.source = "sampled";
+        stats.effectiveFreq = static_cast<long>(weightedUs / sampledUs_);
+    }
+
+    stats.meanCapFreq = sampledUs_ > 0 ? static_cast<long>(capFreqUs_ / sampledUs_) : lastCapFreq_;
+    if (stats.meanCapFreq > 0) {
+        stats.effectiveVsCapPercent = 100.0 * stats.effectiveFreq / stats.meanCapFreq;
+    }
+    if (sampledUs_ > 0) {
+        stats.atCapPercent = 100.0 * atCapUs_ / sampledUs_;
+    }
+    return stats;
+}
+
+bool FreqResidency::readTimeInState(std::map<long, long>* ticks) const {
+    char buffer[TIME_IN_STATE_BUFFER_SIZE];
+    if (timeInState_->readAll(buffer, sizeof(buffer)) <= 0) return false;
+
+    // "<kHz> <ticks>\n" per line
+    char* cursor = buffer;
+    while (*cursor) {
+        char* end;
+        long freq = strtol(cursor, &end, 10);
+        if (end == cursor) break;
+        cursor = end;
+        long count = strtol(cursor, &end, 10);
+        if (end == cursor) break;
+        cursor = end;
+        (*ticks)[freq] = count;
+    }
+    return !ticks->empty();
+}
+
+std::vector<std::string> FreqResidency::policyPaths() {
+    std::vector<std::string> paths;
+    std::string cpufreq = std::string(CPU_SYSFS) + "/cpufreq";
+    DIR* dir = opendir(cpufreq.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strncmp(entry->d_name, "policy", 6) == 0) {
+                paths.push_back(cpufreq + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    if (!paths.empty()) {
+        std::sort(paths.begin(), paths.end(), [](const std::string& a, const std::string& b) {
+            return atoi(a.c_str() + a.rfind("policy") + 6) < atoi(b.c_str() + b.rfind("policy") + 6);
+        });
+        return paths;
+    }
+
+    // Every CPU of a policy links to the same directory
+    std::vector<std::string> targets;
+    for (int cpu = 0;; cpu++) {
+        std::string cpuPath = std::string(CPU_SYSFS) + "/cpu" + std::to_string(cpu);
+        if (access(cpuPath.c_str(), F_OK) != 0) break;
+
+        std::string path = cpuPath + "/cpufreq";
+        char resolved[PATH_MAX];
+        if (!realpath(path.c_str(), resolved)) continue;
+        if (std::find(targets.begin(), targets.end(), resolved) != targets.end()) continue;
+        targets.push_back(resolved);
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+std::string FreqResidency::policyName(const std::string& policyPath) {
+    size_t slash = policyPath.rfind('/');
+    std::string last = slash == std::string::npos ? policyPath : policyPath.substr(slash + 1);
+    if (last != "cpufreq" || slash == std::string::npos || slash == 0) return last;
+
+    size_t parent = policyPath.rfind('/', slash - 1);
+    return policyPath.substr(parent + 1, slash - parent - 1);
+}
+
+} // namespace danr
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace danr {
+
+class SysfsAttribute;
+
+// Where a cpufreq policy actually ran between start() and the last sample.
+// scaling_max_freq only says what it was allowed to do.
+struct FreqResidencyStats {
+    long elapsedMs = 0;
+    long transitions = 0;                                   // stats/total_trans delta, -1 if unavailable
+    std::vector<std::pair<long, long>> timeInStateMs;       // (kHz, ms) from stats/time_in_state
+    std::vector<std::pair<long, long>> curFreqHistogramMs;  // (kHz, ms) from sampled scaling_cur_freq
+    long samples = 0;
+    std::string source;             // What effectiveFreq is computed from: "time_in_state" or "sampled"
+    long effectiveFreq = 0;         // Time-weighted mean frequency, kHz
+    long meanCapFreq = 0;           // Time-weighted mean scaling_max_freq, kHz
+    double effectiveVsCapPercent = 0;
+    double atCapPercent = 0;        // Sampled time spent at the cap
+};
+
+// Frequency residency of one policy. time_in_state (CONFIG_CPU_FREQ_STAT)
+// is exact but counts in 10 ms ticks and is missing on some kernels, so
+// scaling_cur_freq is also sampled into a time-weighted histogram. Not
+// thread-safe: the owner serializes calls with its own lock.
+class FreqResidency {
+public:
+    explicit FreqResidency(const std::string& policyPath);
+
+    // Takes the baseline and clears the histogram
+    void start();
+    void sample();
+    // Takes a last sample and freezes the stats at this point
+    void stop();
+    bool started() const { return started_; }
+
+    FreqResidencyStats stats() const;
+
+    // One cpufreq directory per policy: policyN, or on kernels before 4.3
+    // the distinct targets of the cpuN/cpufreq links
+    static std::vector<std::string> policyPaths();
+    // "policy4" for .../cpufreq/policy4, "cpu4" for .../cpu4/cpufreq
+    static std::string policyName(const std::string& policyPath);
+
+private:
+    SysfsAttribute* curFreq_;
+    SysfsAttribute* maxFreq_;
+    SysfsAttribute* timeInState_;
+    SysfsAttribute* totalTrans_;
+
+    bool started_ = false;
+    bool stopped_ = false;
+    long startUs_ = 0;
+    long stopUs_ = 0;
+    long lastSampleUs_ = 0;
+    long lastCurFreq_ = 0;
+    long lastCapFreq_ = 0;
+    long samples_ = 0;
+
+    std::map<long, long> baselineTicks_;
+    long baselineTransitions_ = -1;
+    std::map<long, long> finalTicks_;
+    long finalTransitions_ = -1;
+    std::map<long, long> curFreqUs_;
+    long sampledUs_ = 0;
+    long atCapUs_ = 0;
+    double capFreqUs_ = 0;
+
+    bool readTimeInState(std::map<long, long>* ticks) const;
+};
+
+} // namespace danr
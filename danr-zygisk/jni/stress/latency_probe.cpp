@@ -0,0 +1,190 @@
+#include "latency_probe.h"
+#include "monotonic_clock.h"
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <sys/fsuid.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-LatencyProbe", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-LatencyProbe", __VA_ARGS__)
+
+namespace danr {
+
+static const uint32_t UDP_MAGIC = 0x44414e52;  // "DANR"
+static const size_t PAYLOAD_SIZE = 56;         // Same as ping's default
+
+static uint16_t checksum(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += (bytes[i] << 8) | bytes[i + 1];
+    }
+    if (length & 1) {
+        sum += bytes[length - 1] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons(static_cast<uint16_t>(~sum));
+}
+
+LatencyProbe::~LatencyProbe() {
+    close();
+}
+
+bool LatencyProbe::open(const std::string& target, int port, const std::string& device, int uid,
+                        std::string* error) {
+    close();
+
+    memset(&target_, 0, sizeof(target_));
+    target_.sin_family = AF_INET;
+    target_.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, target.c_str(), &target_.sin_addr) != 1) {
+        if (error) *error = "invalid probe target " + target;
+        return false;
+    }
+    udp_ = port > 0;
+
+    // The socket's owner uid is taken from the fsuid at creation time.
+    // setfsuid only affects the calling thread.
+    int previousFsuid = -1;
+    if (uid >= 0) {
+        previousFsuid = setfsuid(static_cast<uid_t>(uid));
+    }
+
+    raw_ = false;
+    if (udp_) {
+        fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    } else {
+        fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_ICMP);
+        if (fd_ < 0) {
+            raw_ = true;
+            fd_ = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_ICMP);
+        }
+    }
+    int savedErrno = errno;
+
+    if (previousFsuid >= 0) {
+        setfsuid(static_cast<uid_t>(previousFsuid));
+    }
+
+    if (fd_ < 0) {
+        if (error) *error = std::string("probe socket: ") + strerror(savedErrno);
+        return false;
+    }
+
+    if (!device.empty() &&
+        setsockopt(fd_, SOL_SOCKET, SO_BINDTODEVICE, device.c_str(), device.size() + 1) < 0) {
+        if (error) *error = "bind probe to " + device + ": " + strerror(errno);
+        close();
+        return false;
+    }
+
+    if (udp_ && connect(fd_, reinterpret_cast<struct sockaddr*>(&target_), sizeof(target_)) < 0) {
+        if (error) *error = std::string("connect probe: ") + strerror(errno);
+        close();
+        return false;
+    }
+
+    id_ = static_cast<uint16_t>(getpid() ^ reinterpret_cast<uintptr_t>(this));
+    seq_ = 0;
+    LOGD("Probing %s via %s%s%s", target.c_str(), method(),
+         device.empty() ? "" : " on ", device.c_str());
+    return true;
+}
+
+void LatencyProbe::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+const char* LatencyProbe::method() const {
+    if (udp_) return "udp-echo";
+    return raw_ ? "icmp-raw" : "icmp";
+}
+
+bool LatencyProbe::matchReply(const char* data, size_t length) const {
+    if (udp_) {
+        uint32_t header[2];
+        if (length < sizeof(header)) return false;
+        memcpy(header, data, sizeof(header));
+        return ntohl(header[0]) == UDP_MAGIC &&
+               ntohl(header[1]) == ((static_cast<uint32_t>(id_) << 16) | seq_);
+    }
+
+    // Raw sockets deliver the IP header too, and every ICMP packet the host
+    // receives; ping sockets only the ICMP part of our own replies, with the
+    // id rewritten by the kernel
+    if (raw_) {
+        if (length < sizeof(struct iphdr)) return false;
+        size_t headerLength = reinterpret_cast<const struct iphdr*>(data)->ihl * 4;
+        if (length < headerLength) return false;
+        data += headerLength;
+        length -= headerLength;
+    }
+
+    struct icmphdr icmp;
+    if (length < sizeof(icmp)) return false;
+    memcpy(&icmp, data, sizeof(icmp));
+    if (icmp.type != ICMP_ECHOREPLY || ntohs(icmp.un.echo.sequence) != seq_) return false;
+    return !raw_ || ntohs(icmp.un.echo.id) == id_;
+}
+
+long LatencyProbe::measure(int timeoutMs) {
+    if (fd_ < 0) return -1;
+    seq_++;
+
+    char packet[sizeof(struct icmphdr) + PAYLOAD_SIZE];
+    memset(packet, 0, sizeof(packet));
+    ssize_t sent;
+
+    long start = monotonicUs();
+    if (udp_) {
+        uint32_t header[2] = { htonl(UDP_MAGIC), htonl((static_cast<uint32_t>(id_) << 16) | seq_) };
+        memcpy(packet, header, sizeof(header));
+        sent = send(fd_, packet, PAYLOAD_SIZE, 0);
+    } else {
+        struct icmphdr icmp;
+        memset(&icmp, 0, sizeof(icmp));
+        icmp.type = ICMP_ECHO;
+        icmp.un.echo.id = htons(id_);
+        icmp.un.echo.sequence = htons(seq_);
+        memcpy(packet, &icmp, sizeof(icmp));
+        icmp.checksum = checksum(packet, sizeof(packet));
+        memcpy(packet, &icmp, sizeof(icmp));
+        sent = sendto(fd_, packet, sizeof(packet), 0,
+                      reinterpret_cast<struct sockaddr*>(&target_), sizeof(target_));
+    }
+    if (sent < 0) {
+        // Counts as lost: an ENOBUFS here is the shaper pushing back
+        return -1;
+    }
+
+    long deadline = start + timeoutMs * 1000L;
+    char reply[2048];
+    for (;;) {
+        long remainingUs = deadline - monotonicUs();
+        if (remainingUs <= 0) return -1;
+
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        int ready = poll(&pfd, 1, static_cast<int>((remainingUs + 999) / 1000));
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return -1;
+
+        // Replies to earlier, timed out probes are drained here as well
+        ssize_t received = recv(fd_, reply, sizeof(reply), 0);
+        if (received > 0 && matchReply(reply, static_cast<size_t>(received))) {
+            return monotonicUs() - start;
+        }
+    }
+}
+
+} // namespace danr
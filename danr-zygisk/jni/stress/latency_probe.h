@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <netinet/in.h>
+
+namespace danr {
+
+// Echo-based round trip probe. Without a port it sends ICMP echo requests
+// (ping socket, or a raw socket when ping_group_range excludes us); with a
+// port it sends UDP datagrams to an RFC 862 echo service, which also works
+// where ICMP is filtered. IPv4 only.
+class LatencyProbe {
+public:
+    LatencyProbe() = default;
+    ~LatencyProbe();
+
+    LatencyProbe(const LatencyProbe&) = delete;
+    LatencyProbe& operator=(const LatencyProbe&) = delete;
+
+    // device pins the probe to the shaped interface (SO_BINDTODEVICE). The
+    // socket is created with the given uid as owner, so a uid classifier
+    // sorts probes into that app's class; -1 keeps our own uid.
+    bool open(const std::string& target, int port, const std::string& device, int uid,
+              std::string* error);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    // Sends one echo and waits up to timeoutMs for its reply. Returns the
+    // round trip in microseconds, or -1 if the reply did not arrive in time.
+    long measure(int timeoutMs);
+
+    const char* method() const;
+
+private:
+    int fd_ = -1;
+    bool raw_ = false;
+    bool udp_ = false;
+    uint16_t id_ = 0;
+    uint16_t seq_ = 0;
+    struct sockaddr_in target_;
+
+    bool matchReply(const char* data, size_t length) const;
+};
+
+} // namespace danr
@@ -39,8 +39,13 @@ bool MemoryStressor::start(const MemoryStressConfig& config) {
     markStarted();
     allocatedBytes_.store(0);
 
-    LOGD("Starting memory stress: target %d MB free, chunk size %d MB for %ld ms",
-         config.targetFreeMB, config.chunkSizeMB, config.durationMs);
+    if (config.holdMB > 0) {
+        LOGD("Starting memory stress: holding %d MB, at least %d MB left free, chunk size %d MB for %ld ms",
+             config.holdMB, config.targetFreeMB, config.chunkSizeMB, config.durationMs);
+    } else {
+        LOGD("Starting memory stress: target %d MB free, chunk size %d MB for %ld ms",
+             config.targetFreeMB, config.chunkSizeMB, config.durationMs);
+    }
 
     workerThread_ = std::thread(&MemoryStressor::workerFunction, this);
     return true;
@@ -69,6 +74,7 @@ void MemoryStressor::stop() {
 
 void MemoryStressor::workerFunction() {
     int targetFreeMB;
+    int holdMB;
     int chunkSizeMB;
     bool lockMemory;
     long endTime;
@@ -76,6 +82,7 @@ void MemoryStressor::workerFunction() {
     {
         std::lock_guard<std::mutex> lock(mutex_);
         targetFreeMB = config_.targetFreeMB;
+        holdMB = config_.holdMB;
         chunkSizeMB = config_.chunkSizeMB;
         lockMemory = config_.lockMemory;
         endTime = startTimeMs_.load() + durationMs_.load();
@@ -86,11 +93,21 @@ void MemoryStressor::workerFunction() {
     // Phase 1: Allocate memory until target free memory is reached
     LOGD("Phase 1: Allocating memory to reach target %d MB free", targetFreeMB);
 
+    shortfallMB_.store(0);
     while (running_.load() && getCurrentTimeMs() < endTime) {
         long availableMB = getAvailableMemoryMB();
 
+        if (holdMB > 0 && allocatedBytes_.load() >= holdMB * 1024L * 1024) {
+            break;
+        }
         if (availableMB <= targetFreeMB) {
-            // Target reached, maintain pressure
+            // Target reached, maintain pressure. A hold stops here too:
+            // going on would only feed the low memory killer.
+            if (holdMB > 0) {
+                shortfallMB_.store(holdMB - allocatedBytes_.load() / (1024 * 1024));
+                LOGE("Holding %ld MB, %ld MB short of %d MB: only %ld MB available",
+                     allocatedBytes_.load() / (1024 * 1024), shortfallMB_.load(), holdMB, availableMB);
+            }
             break;
         }
 
@@ -126,8 +143,9 @@ void MemoryStressor::workerFunction() {
     while (running_.load() && getCurrentTimeMs() < endTime) {
         long availableMB = getAvailableMemoryMB();
 
-        // If free memory increased significantly, allocate more
-        if (availableMB > targetFreeMB + chunkSizeMB) {
+        // If free memory increased significantly, allocate more. A fixed
+        // hold stays as it is.
+        if (holdMB == 0 && availableMB > targetFreeMB + chunkSizeMB) {
             void* ptr = allocateChunk(chunkSize);
             if (ptr != nullptr) {
                 memset(ptr, 0xAA, chunkSize);
@@ -249,6 +267,8 @@ StressStatus MemoryStressor::getStatus() const {
         std::lock_guard<std::mutex> lock(mutex_);
         status.data["allocatedMB"] = std::to_string(allocatedBytes_.load() / (1024 * 1024));
         status.data["targetFreeMB"] = std::to_string(config_.targetFreeMB);
+        status.data["holdMB"] = std::to_string(config_.holdMB);
+        status.data["shortfallMB"] = std::to_string(shortfallMB_.load());
         status.data["availableMB"] = std::to_string(getAvailableMemoryMB());
     }
 
@@ -8,6 +8,9 @@ namespace danr {
 
 struct MemoryStressConfig {
     int targetFreeMB = 100;       // Target free memory to maintain
+    int holdMB = 0;               // Hold exactly this much instead, e.g. to take
+                                  // MemTotal down to a smaller device's; stops
+                                  // short at targetFreeMB available
     int chunkSizeMB = 10;         // Allocation chunk size
     long durationMs = 300000;     // 5 minutes default
     bool useAnonymousMmap = true; // Use mmap for allocation
@@ -32,6 +35,7 @@ private:
     std::thread workerThread_;
     std::vector<void*> allocations_;
     std::atomic<long> allocatedBytes_{0};
+    std::atomic<long> shortfallMB_{0};    // Of holdMB, once the floor stopped it
 
     void workerFunction();
     void releaseMemory();
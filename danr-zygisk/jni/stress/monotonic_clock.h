@@ -0,0 +1,19 @@
+#pragma once
+
+#include <ctime>
+
+namespace danr {
+
+// CLOCK_MONOTONIC, for intervals and deadlines that must not jump with
+// the wall clock
+inline long monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+inline long monotonicMs() {
+    return monotonicUs() / 1000;
+}
+
+} // namespace danr
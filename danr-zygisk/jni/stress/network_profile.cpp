@@ -0,0 +1,243 @@
+#include "network_profile.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-NetworkProfile", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-NetworkProfile", __VA_ARGS__)
+
+namespace danr {
+
+// ============================================================================
+// Built-in traces
+// ============================================================================
+
+// Columns: timeMs, bandwidthKbps, delayMs, jitterMs, loss, duplicate, reorder, corrupt.
+// Each trace ends on its first sample so looping is seamless.
+
+// HSPA-class link with a cell handover dip around 40s
+static const NetworkProfilePoint TRACE_3G[] = {
+    {0,     1600, 120, 30,  0.5, 0, 0, 0},
+    {5000,  1200, 150, 40,  1.0, 0, 0, 0},
+    {10000, 800,  180, 60,  1.5, 0, 0, 0},
+    {15000, 384,  250, 80,  2.0, 0, 0, 0},
+    {20000, 384,  300, 100, 3.0, 0, 0, 0},
+    {25000, 900,  160, 40,  1.0, 0, 0, 0},
+    {30000, 1400, 130, 30,  0.5, 0, 0, 0},
+    {38000, 1000, 200, 70,  1.5, 0, 0, 0},
+    {39500, 150,  600, 200, 10.0, 0, 0.5, 0},
+    {41500, 150,  600, 200, 10.0, 0, 0.5, 0},
+    {43000, 1200, 150, 40,  1.0, 0, 0, 0},
+    {50000, 1600, 120, 30,  0.5, 0, 0, 0},
+    {60000, 1600, 120, 30,  0.5, 0, 0, 0},
+};
+
+// Busy LTE cell: throughput swings with deep bufferbloat and a handover at 30s
+static const NetworkProfilePoint TRACE_CONGESTED_LTE[] = {
+    {0,     8000, 50,  10,  0.1, 0, 0, 0},
+    {4000,  3000, 180, 40,  0.5, 0, 0, 0},
+    {8000,  1200, 350, 90,  1.5, 0, 0, 0},
+    {12000, 800,  450, 120, 2.5, 0, 0, 0},
+    {16000, 2500, 250, 60,  1.0, 0, 0, 0},
+    {20000, 6000, 80,  20,  0.3, 0, 0, 0},
+    {26000, 1500, 300, 80,  2.0, 0, 0, 0},
+    {29000, 300,  800, 200, 5.0, 0, 1.0, 0},
+    {30500, 300,  800, 200, 5.0, 0, 1.0, 0},
+    {31500, 4000, 120, 30,  0.5, 0, 0, 0},
+    {40000, 9000, 50,  10,  0.1, 0, 0, 0},
+    {45000, 2000, 280, 70,  1.5, 0, 0, 0},
+    {52000, 1000, 400, 100, 2.0, 0, 0, 0},
+    {60000, 8000, 50,  10,  0.1, 0, 0, 0},
+};
+
+// Fast but unreliable Wi-Fi: interference bursts, a short blackout at 11s and
+// the duplication/reordering/corruption typical of retransmitting radios
+static const NetworkProfilePoint TRACE_FLAKY_WIFI[] = {
+    {0,     20000, 5,   3,   0.2,   0.1, 0.5, 0.05},
+    {6000,  15000, 10,  8,   0.5,   0.2, 1.0, 0.1},
+    {9000,  2000,  80,  40,  10.0,  0.5, 3.0, 0.5},
+    {10500, 500,   200, 100, 60.0,  1.0, 5.0, 1.0},
+    {11000, 500,   300, 150, 100.0, 0,   0,   0},
+    {13000, 500,   300, 150, 100.0, 0,   0,   0},
+    {13500, 10000, 20,  15,  1.0,   0.2, 1.0, 0.1},
+    {20000, 20000, 5,   3,   0.2,   0.1, 0.5, 0.05},
+    {32000, 18000, 8,   5,   0.3,   0.1, 0.5, 0.05},
+    {35000, 3000,  60,  40,  8.0,   0.5, 3.0, 0.5},
+    {36500, 20000, 5,   3,   0.2,   0.1, 0.5, 0.05},
+    {48000, 12000, 15,  10,  1.0,   0.2, 1.0, 0.1},
+    {50000, 20000, 5,   3,   0.2,   0.1, 0.5, 0.05},
+    {60000, 20000, 5,   3,   0.2,   0.1, 0.5, 0.05},
+};
+
+struct BuiltinTrace {
+    const char* name;
+    const NetworkProfilePoint* points;
+    size_t count;
+};
+
+#define TRACE(name, points) { name, points, sizeof(points) / sizeof(points[0]) }
+
+static const BuiltinTrace BUILTIN_TRACES[] = {
+    TRACE("3g", TRACE_3G),
+    TRACE("congested_lte", TRACE_CONGESTED_LTE),
+    TRACE("flaky_wifi", TRACE_FLAKY_WIFI),
+};
+
+#undef TRACE
+
+// ============================================================================
+// NetworkProfilePoint
+// ============================================================================
+
+bool NetworkProfilePoint::operator==(const NetworkProfilePoint& other) const {
+    return bandwidthKbps == other.bandwidthKbps &&
+           delayMs == other.delayMs &&
+           jitterMs == other.jitterMs &&
+           lossPercent == other.lossPercent &&
+           duplicatePercent == other.duplicatePercent &&
+           reorderPercent == other.reorderPercent &&
+           corruptPercent == other.corruptPercent;
+}
+
+// ============================================================================
+// NetworkProfile
+// ============================================================================
+
+bool NetworkProfile::isBuiltin(const std::string& name) {
+    for (const auto& trace : BUILTIN_TRACES) {
+        if (name == trace.name) return true;
+    }
+    return false;
+}
+
+bool NetworkProfile::loadBuiltin(const std::string& name) {
+    for (const auto& trace : BUILTIN_TRACES) {
+        if (name == trace.name) {
+            name_ = name;
+            points_.assign(trace.points, trace.points + trace.count);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NetworkProfile::loadCsv(const std::string& path, std::string* error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+
+    std::vector<NetworkProfilePoint> points;
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        // Header line
+        if (!isdigit(static_cast<unsigned char>(line[first]))) {
+            if (points.empty()) continue;
+            if (error) *error = path + ":" + std::to_string(lineNumber) + ": unexpected text";
+            return false;
+        }
+
+        std::vector<double> values;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            values.push_back(atof(field.c_str()));
+        }
+
+        if (values.size() < 5) {
+            if (error) *error = path + ":" + std::to_string(lineNumber) + ": expected at least 5 columns";
+            return false;
+        }
+        values.resize(8, 0.0);
+
+        NetworkProfilePoint point;
+        point.timeMs = static_cast<long>(values[0]);
+        point.bandwidthKbps = static_cast<int>(values[1]);
+        point.delayMs = static_cast<int>(values[2]);
+        point.jitterMs = static_cast<int>(values[3]);
+        point.lossPercent = values[4];
+        point.duplicatePercent = values[5];
+        point.reorderPercent = values[6];
+        point.corruptPercent = values[7];
+
+        if (!points.empty() && point.timeMs < points.back().timeMs) {
+            if (error) *error = path + ":" + std::to_string(lineNumber) + ": timeMs goes backwards";
+            return false;
+        }
+        points.push_back(point);
+    }
+
+    if (points.empty()) {
+        if (error) *error = path + ": no samples";
+        return false;
+    }
+
+    name_ = path;
+    points_ = std::move(points);
+    LOGD("Loaded %zu samples (%ld ms) from %s", points_.size(), lengthMs(), path.c_str());
+    return true;
+}
+
+bool NetworkProfile::hasBandwidthLimit() const {
+    for (const auto& point : points_) {
+        if (point.bandwidthKbps > 0) return true;
+    }
+    return false;
+}
+
+static double lerp(double a, double b, double t) {
+    return a + (b - a) * t;
+}
+
+// Percentages are rounded to 0.01 so that slow ramps do not turn every tick
+// into a netlink update
+static double roundPercent(double value) {
+    return std::round(value * 100.0) / 100.0;
+}
+
+NetworkProfilePoint NetworkProfile::sample(long elapsedMs, bool loop) const {
+    if (points_.empty()) return NetworkProfilePoint();
+
+    long length = lengthMs();
+    long t = elapsedMs;
+    if (loop && length > 0) {
+        t = elapsedMs % length;
+    }
+
+    if (t <= points_.front().timeMs) return points_.front();
+    if (t >= points_.back().timeMs) return points_.back();
+
+    size_t next = 1;
+    while (points_[next].timeMs <= t) next++;
+    const NetworkProfilePoint& a = points_[next - 1];
+    const NetworkProfilePoint& b = points_[next];
+
+    // A bandwidth of 0 means unlimited, so never interpolate across it
+    double f = static_cast<double>(t - a.timeMs) / (b.timeMs - a.timeMs);
+
+    NetworkProfilePoint point;
+    point.timeMs = t;
+    point.bandwidthKbps = (a.bandwidthKbps == 0 || b.bandwidthKbps == 0)
+        ? a.bandwidthKbps
+        : static_cast<int>(std::lround(lerp(a.bandwidthKbps, b.bandwidthKbps, f)));
+    point.delayMs = static_cast<int>(std::lround(lerp(a.delayMs, b.delayMs, f)));
+    point.jitterMs = static_cast<int>(std::lround(lerp(a.jitterMs, b.jitterMs, f)));
+    point.lossPercent = roundPercent(lerp(a.lossPercent, b.lossPercent, f));
+    point.duplicatePercent = roundPercent(lerp(a.duplicatePercent, b.duplicatePercent, f));
+    point.reorderPercent = roundPercent(lerp(a.reorderPercent, b.reorderPercent, f));
+    point.corruptPercent = roundPercent(lerp(a.corruptPercent, b.corruptPercent, f));
+    return point;
+}
+
+} // namespace danr
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// One sample of a network condition trace. Values between two samples are
+// linearly interpolated.
+struct NetworkProfilePoint {
+    long timeMs = 0;              // Offset from the start of the trace
+    int bandwidthKbps = 0;        // 0 = unlimited
+    int delayMs = 0;
+    int jitterMs = 0;
+    double lossPercent = 0;
+    double duplicatePercent = 0;
+    double reorderPercent = 0;
+    double corruptPercent = 0;
+
+    bool operator==(const NetworkProfilePoint& other) const;
+    bool operator!=(const NetworkProfilePoint& other) const { return !(*this == other); }
+};
+
+// Time series of network conditions, either one of the built-in traces or a
+// CSV file with the columns
+//   timeMs,bandwidthKbps,delayMs,jitterMs,lossPercent[,duplicatePercent,reorderPercent,corruptPercent]
+// Lines starting with '#' and a header line are skipped.
+class NetworkProfile {
+public:
+    static bool isBuiltin(const std::string& name);
+
+    bool loadBuiltin(const std::string& name);
+    bool loadCsv(const std::string& path, std::string* error);
+
+    const std::string& name() const { return name_; }
+    bool empty() const { return points_.empty(); }
+    long lengthMs() const { return points_.empty() ? 0 : points_.back().timeMs; }
+    bool hasBandwidthLimit() const;
+
+    // Conditions at elapsedMs into the trace. When loop is false the last
+    // sample is held once the trace has ended.
+    NetworkProfilePoint sample(long elapsedMs, bool loop) const;
+
+private:
+    std::string name_;
+    std::vector<NetworkProfilePoint> points_;
+};
+
+} // namespace danr
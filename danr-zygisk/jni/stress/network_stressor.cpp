@@ -1,7 +1,16 @@
 #include "network_stressor.h"
+#include "uid_classifier.h"
+#include "route_monitor.h"
+#include "restore_journal.h"
 #include <unistd.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
 #include <sstream>
+#include <linux/pkt_sched.h>
 #include <android/log.h>
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-NetworkStressor", __VA_ARGS__)
@@ -9,6 +18,53 @@
 
 namespace danr {
 
+static const uint16_t ROOT_HANDLE_MAJOR = 1;
+static const uint32_t NETEM_HANDLE_MAJOR = 0x10;
+static const int MIN_PROFILE_UPDATE_MS = 50;
+
+// Probe cadence limits and the window the observed values are computed over
+static const int MIN_PROBE_INTERVAL_MS = 100;
+static const int PROBE_TIMEOUT_MS = 2000;
+static const int BASELINE_PROBES = 5;
+static const int BASELINE_TIMEOUT_MS = 1000;
+static const size_t PROBE_WINDOW = 20;
+static const size_t MIN_PROBES_FOR_VERDICT = 5;
+static const int STATS_INTERVAL_MS = 1000;
+
+// Downlink shaping device. Its ifalias records "danr:<interface>:<owned|shared>"
+// so cleanupStaleIngress can undo the redirect after a crash.
+static const char* IFB_NAME = "ifb_danr";
+static const char* IFB_ALIAS_PREFIX = "danr:";
+
+// Priority of the redirect filter; a clsact qdisc that already exists (netd
+// attaches some for its own BPF programs) is shared and only our filter removed
+static const uint16_t INGRESS_FILTER_PRIORITY = 0xDA;
+static const uint32_t INGRESS_PARENT = TC_H_MAKE(TC_H_CLSACT, TC_H_MIN_INGRESS);
+
+// Rate programmed into the shaper while a profile sample is unlimited
+static const uint64_t UNSHAPED_RATE_BYTES_PER_SEC = 10000000000ULL / 8;
+
+static std::string formatPercent(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", value);
+    return buffer;
+}
+
+static std::string joinNames(const std::vector<std::string>& names) {
+    std::string result;
+    for (const auto& name : names) {
+        if (!result.empty()) result += ",";
+        result += name;
+    }
+    return result;
+}
+
+static std::string formatMs(double us) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", us / 1000.0);
+    return buffer;
+}
+
 NetworkStressor::~NetworkStressor() {
     stop();
 }
@@ -28,24 +84,106 @@ bool NetworkStressor::start(const NetworkStressConfig& config) {
         return false;
     }
 
-    if (!checkTcAvailable()) {
-        LOGE("tc command not available - network stress requires root and busybox/tc");
+    // Threads of a run whose duration expired on its own
+    if (workerThread_.joinable()) {
+        workerThread_.join();
+    }
+    if (monitorThread_.joinable()) {
+        monitorThread_.join();
+    }
+
+    if (config.shaper != "htb" && config.shaper != "tbf") {
+        LOGE("Unknown bandwidth shaper: %s", config.shaper.c_str());
+        return false;
+    }
+
+    if (!TcNetlink::isKnownDistribution(config.delayDistribution)) {
+        LOGE("Unknown delay distribution: %s", config.delayDistribution.c_str());
+        return false;
+    }
+
+    if (config.lossModel != "random" && config.lossModel != "gemodel") {
+        LOGE("Unknown loss model: %s", config.lossModel.c_str());
+        return false;
+    }
+
+    if (!config.apps.empty() && config.shaper != "htb") {
+        LOGE("Per-app shaping requires the htb shaper");
+        return false;
+    }
+
+    if (!config.apps.empty() && config.shapeIngress) {
+        LOGE("Downlink shaping cannot be combined with per-app shaping");
+        return false;
+    }
+
+    std::vector<std::string> interfaces;
+    std::string error;
+    if (!resolveInterfaces(config.targetInterface, true, &interfaces, &error)) {
+        LOGE("%s", error.c_str());
+        return false;
+    }
+
+    std::vector<ShapingLane> lanes;
+    if (!buildLanes(config, interfaces, &lanes)) {
+        return false;
+    }
+
+    if (config.probe && !config.probeApp.empty() &&
+        std::none_of(lanes.begin(), lanes.end(),
+                     [&config](const ShapingLane& lane) { return lane.uid >= 0 && lane.name == config.probeApp; })) {
+        LOGE("probeApp %s is not one of the shaped apps", config.probeApp.c_str());
+        return false;
+    }
+
+    if (!netlink_.open()) {
+        LOGE("rtnetlink unavailable - network stress requires root (CAP_NET_ADMIN)");
         return false;
     }
 
+    cleanupStaleIngress();
+
     {
         std::lock_guard<std::mutex> lock(mutex_);
         config_ = config;
+        lastError_.clear();
+        lanes_ = lanes;
+        perApp_ = !config.apps.empty();
+        interfaces_ = interfaces;
+        interfaceIndexes_.clear();
+        for (const auto& iface : interfaces) {
+            interfaceIndexes_.push_back(TcNetlink::interfaceIndex(iface));
+        }
+        probeTarget_.clear();
+        probeMethod_.clear();
+        baselineRttUs_ = -1;
+        probeWindow_.clear();
+        probesSent_ = 0;
+        probesReceived_ = 0;
     }
+    profileUpdates_.store(0);
+    profileErrors_.store(0);
+    interfaceChanges_.store(0);
 
     setDuration(config.durationMs);
     markStarted();
 
-    LOGD("Starting network stress on %s: bandwidth=%d kbps, latency=%d ms, loss=%d%% for %ld ms",
-         config.targetInterface.c_str(), config.bandwidthLimitKbps,
+    LOGD("Starting network stress on %s (%s): bandwidth=%d kbps, latency=%d ms, loss=%d%% for %ld ms",
+         joinNames(interfaces).c_str(), config.targetInterface.c_str(), config.bandwidthLimitKbps,
          config.latencyMs, config.packetLossPercent, config.durationMs);
+    for (const auto& lane : lanes) {
+        if (lane.uid >= 0) {
+            LOGD("Shaping app %s (uid %d) in class %x", lane.name.c_str(), lane.uid, lane.classId);
+        }
+        if (!lane.profile.empty()) {
+            LOGD("Playing network profile %s for %s (%ld ms, update every %d ms)",
+                 lane.profile.name().c_str(), lane.name.c_str(), lane.profile.lengthMs(),
+                 config.profileUpdateMs);
+        }
+    }
 
     workerThread_ = std::thread(&NetworkStressor::workerFunction, this);
+    monitorThread_ = std::thread(&NetworkStressor::monitorFunction, this);
     return true;
 }
 
@@ -62,6 +200,9 @@ void NetworkStressor::stop() {
     if (workerThread_.joinable()) {
         workerThread_.join();
     }
+    if (monitorThread_.joinable()) {
+        monitorThread_.join();
+    }
 
     removeTcRules();
 
@@ -72,21 +213,64 @@ void NetworkStressor::stop() {
 
 void NetworkStressor::workerFunction() {
     long endTime;
+    bool useProfile;
+    bool loop;
+    int updateMs;
+    bool probe;
     {
         std::lock_guard<std::mutex> lock(mutex_);
         endTime = startTimeMs_.load() + durationMs_.load();
+        useProfile = std::any_of(lanes_.begin(), lanes_.end(),
+                                 [](const ShapingLane& lane) { return !lane.profile.empty(); });
+        loop = config_.profileLoop;
+        updateMs = std::max(config_.profileUpdateMs, MIN_PROFILE_UPDATE_MS);
+        probe = config_.probe;
+    }
+
+    // The reference RTT has to be taken while the path is still unshaped
+    if (probe) {
+        measureBaseline();
+    }
+
+    // Subscribe before the rules go in so no change slips through between
+    // resolving the interfaces and watching them
+    RouteMonitor routes;
+    if (!routes.open()) {
+        LOGE("Route monitor unavailable, interface changes will not be followed");
     }
 
     // Apply traffic control rules
+    profileStartMs_.store(getCurrentTimeMs());
     if (!applyTcRules()) {
         LOGE("Failed to apply tc rules");
         markStopped();
         return;
     }
 
-    // Wait for duration while monitoring
+    // Wait for duration while watching links and routes, or step through
+    // the profile
     while (running_.load() && getCurrentTimeMs() < endTime) {
-        usleep(1000000); // Check every second
+        if (routes.waitForChange(useProfile ? updateMs : 1000)) {
+            followInterfaces();
+        }
+        if (!useProfile) {
+            continue;
+        }
+
+        long elapsedMs = getCurrentTimeMs() - profileStartMs_.load();
+        for (size_t i = 0; i < lanes_.size(); i++) {
+            NetworkProfilePoint point;
+            bool changed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (lanes_[i].profile.empty()) continue;
+                point = lanes_[i].profile.sample(elapsedMs, loop);
+                changed = point != lanes_[i].applied;
+            }
+            if (changed) {
+                updateLane(i, point);
+            }
+        }
     }
 
     // Mark as stopped when duration expires naturally
@@ -98,132 +282,865 @@ void NetworkStressor::workerFunction() {
     LOGD("Network stress worker completed");
 }
 
+NetworkProfilePoint NetworkStressor::constantConditions(const NetworkStressConfig& config) {
+    NetworkProfilePoint point;
+    point.bandwidthKbps = config.bandwidthLimitKbps;
+    point.delayMs = config.latencyMs;
+    point.jitterMs = config.jitterMs;
+    point.lossPercent = config.packetLossPercent;
+    point.duplicatePercent = config.duplicatePercent;
+    point.reorderPercent = config.reorderPercent;
+    point.corruptPercent = config.corruptPercent;
+    return point;
+}
+
+static bool hasImpairment(const NetworkProfilePoint& point) {
+    return point.delayMs > 0 || point.jitterMs > 0 || point.lossPercent > 0 ||
+           point.duplicatePercent > 0 || point.reorderPercent > 0 || point.corruptPercent > 0;
+}
+
+bool NetworkStressor::resolveInterfaces(const std::string& spec, bool strict,
+                                        std::vector<std::string>* interfaces, std::string* error) {
+    interfaces->clear();
+    auto add = [interfaces](const std::string& name) {
+        if (std::find(interfaces->begin(), interfaces->end(), name) == interfaces->end()) {
+            interfaces->push_back(name);
+        }
+    };
+
+    std::stringstream ss(spec);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name.empty()) continue;
+
+        if (name == "auto") {
+            for (const auto& iface : RouteMonitor::defaultInterfaces()) add(iface);
+        } else if (TcNetlink::interfaceIndex(name) != 0) {
+            add(name);
+        } else if (strict) {
+            // Mid-test a named interface may come and go (cellular data
+            // sessions do); only a missing one at start is an error
+            if (error) *error = "Interface " + name + " not found";
+            return false;
+        }
+    }
+
+    if (strict && interfaces->empty()) {
+        if (error) *error = "No interface to shape: there is no default route, name targetInterface explicitly";
+        return false;
+    }
+    return true;
+}
+
+std::string NetworkStressor::primaryInterface() const {
+    // Caller holds mutex_
+    return interfaces_.empty() ? std::string() : interfaces_.front();
+}
+
+bool NetworkStressor::buildLanes(const NetworkStressConfig& config, const std::vector<std::string>& interfaces,
+                                 std::vector<ShapingLane>* lanes) {
+    NetworkProfile globalProfile;
+    if (!config.profile.empty() && !config.profilePath.empty()) {
+        LOGE("profile and profilePath are mutually exclusive");
+        return false;
+    }
+    if (!config.profile.empty() && !globalProfile.loadBuiltin(config.profile)) {
+        LOGE("Unknown network profile: %s", config.profile.c_str());
+        return false;
+    }
+    if (!config.profilePath.empty()) {
+        std::string error;
+        if (!globalProfile.loadCsv(config.profilePath, &error)) {
+            LOGE("Failed to load network profile: %s", error.c_str());
+            return false;
+        }
+    }
+
+    // Profiles always get a netem qdisc so later samples can change it
+    bool gemodel = config.lossModel == "gemodel";
+
+    if (config.apps.empty()) {
+        for (const auto& iface : interfaces) {
+            if (!config.shapeEgress) break;
+            ShapingLane lane;
+            lane.name = iface;
+            lane.device = iface;
+            lane.constant = constantConditions(config);
+            lane.profile = globalProfile;
+            lanes->push_back(lane);
+        }
+
+        // Every interface's ingress is redirected into the one IFB, so the
+        // downlink limit applies to their sum
+        if (config.shapeIngress && !interfaces.empty()) {
+            ShapingLane lane;
+            lane.name = "downlink";
+            lane.device = IFB_NAME;
+            lane.constant = constantConditions(config);
+            if (config.downlinkBandwidthLimitKbps >= 0) lane.constant.bandwidthKbps = config.downlinkBandwidthLimitKbps;
+            if (config.downlinkLatencyMs >= 0) lane.constant.delayMs = config.downlinkLatencyMs;
+            if (config.downlinkJitterMs >= 0) lane.constant.jitterMs = config.downlinkJitterMs;
+            if (config.downlinkPacketLossPercent >= 0) lane.constant.lossPercent = config.downlinkPacketLossPercent;
+
+            if (!config.downlinkProfile.empty()) {
+                if (!lane.profile.loadBuiltin(config.downlinkProfile)) {
+                    LOGE("Unknown network profile: %s", config.downlinkProfile.c_str());
+                    return false;
+                }
+            } else {
+                lane.profile = globalProfile;
+            }
+            lanes->push_back(lane);
+        }
+
+        for (auto& lane : *lanes) {
+            lane.shaping = lane.profile.empty() ? lane.constant.bandwidthKbps > 0
+                                                : lane.profile.hasBandwidthLimit();
+            lane.netem = !lane.profile.empty() || gemodel || hasImpairment(lane.constant);
+            lane.classId = config.shaper == "tbf" ? tcHandle(ROOT_HANDLE_MAJOR, 1)
+                                                  : tcHandle(ROOT_HANDLE_MAJOR, 0x12);
+            lane.netemHandle = tcHandle(NETEM_HANDLE_MAJOR, 0);
+        }
+        return true;
+    }
+
+    // One HTB class per app and interface, its minor being the app id the
+    // uid classifier returns; each class gets its own netem child. Lanes on
+    // further interfaces are named <package>@<interface>.
+    for (size_t n = 0; n < interfaces.size() * config.apps.size(); n++) {
+        size_t i = n % config.apps.size();
+        const std::string& iface = interfaces[n / config.apps.size()];
+        const NetworkAppConfig& app = config.apps[i];
+
+        ShapingLane lane;
+        lane.name = iface == interfaces.front() ? app.packageName : app.packageName + "@" + iface;
+        lane.device = iface;
+        lane.uid = app.uid >= 0 ? app.uid : packageUid(app.packageName);
+        if (lane.uid < 0) {
+            LOGE("Unknown package: %s", app.packageName.c_str());
+            return false;
+        }
+
+        int appId = appIdOf(lane.uid);
+        if (appId == 0 || appId > 0xFFFF) {
+            LOGE("uid %d of %s cannot be mapped to a traffic class", lane.uid, lane.name.c_str());
+            return false;
+        }
+        for (const auto& other : *lanes) {
+            if (other.device == lane.device && appIdOf(other.uid) == appId) {
+                LOGE("%s and %s share app id %d", other.name.c_str(), lane.name.c_str(), appId);
+                return false;
+            }
+        }
+
+        lane.constant = constantConditions(config);
+        if (app.bandwidthLimitKbps >= 0) lane.constant.bandwidthKbps = app.bandwidthLimitKbps;
+        if (app.latencyMs >= 0) lane.constant.delayMs = app.latencyMs;
+        if (app.jitterMs >= 0) lane.constant.jitterMs = app.jitterMs;
+        if (app.packetLossPercent >= 0) lane.constant.lossPercent = app.packetLossPercent;
+
+        if (!app.profile.empty()) {
+            if (!lane.profile.loadBuiltin(app.profile)) {
+                LOGE("Unknown network profile: %s", app.profile.c_str());
+                return false;
+            }
+        } else {
+            lane.profile = globalProfile;
+        }
+
+        // The class is what steers the app's packets away from the unshaped
+        // default path, so it exists even without a bandwidth limit
+        lane.shaping = true;
+        lane.netem = !lane.profile.empty() || gemodel || hasImpairment(lane.constant);
+        lane.classId = tcHandle(ROOT_HANDLE_MAJOR, static_cast<uint32_t>(appId));
+        lane.netemHandle = tcHandle(NETEM_HANDLE_MAJOR + static_cast<uint32_t>(i), 0);
+        lanes->push_back(lane);
+    }
+    return true;
+}
+
+NetemParams NetworkStressor::buildNetem(const NetworkStressConfig& config, const NetworkProfilePoint& point) {
+    NetemParams netem;
+    netem.delayUs = static_cast<long>(point.delayMs) * 1000;
+    netem.jitterUs = static_cast<long>(point.jitterMs) * 1000;
+    netem.distribution = config.delayDistribution;
+    netem.delayCorrelation = config.delayCorrelationPercent;
+    netem.lossPercent = point.lossPercent;
+    netem.lossCorrelation = config.lossCorrelationPercent;
+    netem.duplicatePercent = point.duplicatePercent;
+    netem.reorderPercent = point.reorderPercent;
+    netem.corruptPercent = point.corruptPercent;
+
+    if (config.lossModel == "gemodel") {
+        netem.gilbertElliott = true;
+        netem.geGoodToBad = config.geGoodToBadPercent;
+        netem.geBadToGood = config.geBadToGoodPercent;
+        netem.geBadLoss = config.geBadLossPercent;
+        netem.geGoodLoss = config.geGoodLossPercent;
+    }
+    return netem;
+}
+
+void NetworkStressor::queueShaping(const NetworkStressConfig& config, int ifindex,
+                                   const ShapingLane& lane, const NetworkProfilePoint& point, TcOp op) {
+    uint64_t rateBytesPerSec = point.bandwidthKbps > 0
+        ? static_cast<uint64_t>(point.bandwidthKbps) * 1000 / 8
+        : UNSHAPED_RATE_BYTES_PER_SEC;
+    uint32_t root = tcHandle(ROOT_HANDLE_MAJOR, 0);
+
+    if (lane.uid >= 0) {
+        // App class under the shared per-app HTB root
+        netlink_.addHtbClass(ifindex, root, lane.classId, rateBytesPerSec, rateBytesPerSec, op);
+    } else if (config.shaper == "tbf") {
+        netlink_.addTbfQdisc(ifindex, TC_H_ROOT, root, rateBytesPerSec,
+                             std::max(point.delayMs, 50) * 1000L, op);
+    } else {
+        // HTB root with a single default class carrying the limit
+        if (op == TcOp::Create) {
+            netlink_.addHtbQdisc(ifindex, TC_H_ROOT, root, TC_H_MIN(lane.classId));
+        }
+        netlink_.addHtbClass(ifindex, root, lane.classId, rateBytesPerSec, rateBytesPerSec, op);
+    }
+}
+
 bool NetworkStressor::applyTcRules() {
-    std::string iface;
-    int bandwidthKbps;
-    int latencyMs;
-    int packetLoss;
+    NetworkStressConfig config;
+    std::vector<ShapingLane> lanes;
+    std::vector<std::string> interfaces;
+    bool perApp;
 
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        iface = config_.targetInterface;
-        bandwidthKbps = config_.bandwidthLimitKbps;
-        latencyMs = config_.latencyMs;
-        packetLoss = config_.packetLossPercent;
+        config = config_;
+        lanes = lanes_;
+        interfaces = interfaces_;
+        perApp = perApp_;
     }
 
     // First remove any existing rules
     removeTcRules();
 
     // If no restrictions set, nothing to do
-    if (bandwidthKbps == 0 && latencyMs == 0 && packetLoss == 0) {
+    bool anyRules = std::any_of(lanes.begin(), lanes.end(),
+                                [](const ShapingLane& lane) { return lane.shaping || lane.netem; });
+    if (!anyRules) {
         LOGD("No network restrictions configured");
         tcRulesApplied_.store(true);
         return true;
     }
 
-    // Add root qdisc (HTB for bandwidth control)
-    if (bandwidthKbps > 0) {
-        std::stringstream cmd;
-        cmd << "tc qdisc add dev " << iface << " root handle 1: htb default 12";
-        if (!executeCommand(cmd.str())) {
-            LOGE("Failed to add root qdisc");
+    std::vector<int> ifindexes;
+    for (const auto& iface : interfaces) {
+        int ifindex = TcNetlink::interfaceIndex(iface);
+        if (ifindex == 0) {
+            LOGE("Interface %s not found", iface.c_str());
             return false;
         }
+        ifindexes.push_back(ifindex);
+    }
 
-        // Add class with bandwidth limit
-        cmd.str("");
-        cmd << "tc class add dev " << iface << " parent 1: classid 1:12 htb rate "
-            << bandwidthKbps << "kbit ceil " << bandwidthKbps << "kbit";
-        if (!executeCommand(cmd.str())) {
-            LOGE("Failed to add htb class");
-            removeTcRules();
-            return false;
+    // The IFB has to exist before its qdiscs can be part of the batch
+    bool ingress = std::any_of(lanes.begin(), lanes.end(), [](const ShapingLane& lane) {
+        return lane.device == IFB_NAME && (lane.shaping || lane.netem);
+    });
+    std::string error;
+    if (ingress && !setupIngress(interfaces, &error)) {
+        LOGE("Failed to set up ingress redirection on %s: %s",
+             joinNames(interfaces).c_str(), error.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastError_ = error;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shapedInterfaces_ = interfaces;
+    }
+
+    // Qdiscs on the IFB go away with the device, so only the interfaces'
+    // root qdiscs need journaling
+    std::vector<RestoreJournal::Entry> journal;
+    for (const auto& iface : interfaces) {
+        journal.push_back({ RestoreJournal::Kind::Qdisc, iface, "" });
+    }
+    RestoreJournal::getInstance().record(journal);
+
+    // Build the whole ruleset as one netlink batch. Per-app mode uses an HTB
+    // root whose default class does not exist, which HTB treats as "send
+    // directly": traffic the classifier does not match is never shaped.
+    uint32_t root = tcHandle(ROOT_HANDLE_MAJOR, 0);
+    if (perApp) {
+        for (int ifindex : ifindexes) {
+            netlink_.addHtbQdisc(ifindex, TC_H_ROOT, root, 0);
         }
     }
 
-    // Add netem for latency and packet loss
-    if (latencyMs > 0 || packetLoss > 0) {
-        std::stringstream cmd;
+    // Profiles resume where they are, which matters when rules are
+    // re-applied after an interface change
+    long elapsedMs = getCurrentTimeMs() - profileStartMs_.load();
+    std::vector<NetworkProfilePoint> points;
+    for (const auto& lane : lanes) {
+        NetworkProfilePoint point = lane.profile.empty() ? lane.constant
+                                                         : lane.profile.sample(elapsedMs, config.profileLoop);
+        points.push_back(point);
 
-        if (bandwidthKbps > 0) {
-            // Add as child of htb class
-            cmd << "tc qdisc add dev " << iface << " parent 1:12 handle 10: netem";
-        } else {
-            // Add as root qdisc
-            cmd << "tc qdisc add dev " << iface << " root netem";
+        int laneIfindex = TcNetlink::interfaceIndex(lane.device);
+        if (lane.shaping) {
+            queueShaping(config, laneIfindex, lane, point, TcOp::Create);
         }
 
-        if (latencyMs > 0) {
-            cmd << " delay " << latencyMs << "ms";
+        // Add netem for latency, jitter, loss and the other impairments
+        if (lane.netem) {
+            uint32_t parent = lane.shaping ? lane.classId : TC_H_ROOT;
+            netlink_.addNetemQdisc(laneIfindex, parent, lane.netemHandle, buildNetem(config, point));
         }
+    }
 
-        if (packetLoss > 0) {
-            cmd << " loss " << packetLoss << "%";
+    // Redirect last, once the IFB's qdiscs are in place
+    if (ingress) {
+        for (int ifindex : ifindexes) {
+            netlink_.addRedirectFilter(ifindex, INGRESS_PARENT, INGRESS_FILTER_PRIORITY,
+                                       TcNetlink::interfaceIndex(IFB_NAME));
         }
+    }
 
-        if (!executeCommand(cmd.str())) {
-            LOGE("Failed to add netem qdisc");
-            removeTcRules();
+    int classifierFd = -1;
+    if (perApp) {
+        classifierFd = loadUidClassifier(ROOT_HANDLE_MAJOR, &error);
+        if (classifierFd < 0) {
+            netlink_.discard();
+            std::lock_guard<std::mutex> lock(mutex_);
+            lastError_ = error;
             return false;
         }
+        for (int ifindex : ifindexes) {
+            netlink_.addBpfFilter(ifindex, root, 1, classifierFd, "danr_uid");
+        }
     }
 
+    // Whatever was created before a failure is torn down again, so the
+    // interfaces are either fully shaped or not shaped at all
     tcRulesApplied_.store(true);
+
+    bool committed = netlink_.commit(&error);
+
+    // The attached filters hold their own reference to the program
+    if (classifierFd >= 0) {
+        close(classifierFd);
+    }
+
+    if (!committed) {
+        LOGE("Failed to apply tc ruleset on %s: %s", joinNames(interfaces).c_str(), error.c_str());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lastError_ = error;
+        }
+        removeTcRules();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < lanes_.size() && i < points.size(); i++) {
+            lanes_[i].applied = points[i];
+        }
+    }
+
     LOGD("Network stress rules applied successfully");
     return true;
 }
 
-void NetworkStressor::removeTcRules() {
-    if (!tcRulesApplied_.load()) return;
+void NetworkStressor::followInterfaces() {
+    NetworkStressConfig config;
+    std::vector<std::string> current;
+    std::vector<int> currentIndexes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+        current = interfaces_;
+        currentIndexes = interfaceIndexes_;
+    }
 
-    std::string iface;
+    std::vector<std::string> wanted;
+    resolveInterfaces(config.targetInterface, false, &wanted, nullptr);
+    std::vector<int> wantedIndexes;
+    for (const auto& iface : wanted) {
+        wantedIndexes.push_back(TcNetlink::interfaceIndex(iface));
+    }
+    if (wanted == current && wantedIndexes == currentIndexes) return;
+
+    long started = getCurrentTimeMs();
+    std::vector<ShapingLane> lanes;
+    if (!buildLanes(config, wanted, &lanes)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastError_ = "cannot shape " + joinNames(wanted);
+        return;
+    }
+
+    // Rules on interfaces that went away vanished with them; the others are
+    // removed before the new set is installed
+    removeTcRules();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interfaces_ = wanted;
+        interfaceIndexes_ = wantedIndexes;
+        lanes_ = lanes;
+    }
+    interfaceChanges_++;
+
+    if (wanted.empty()) {
+        LOGD("No default interface left, shaping paused until one appears");
+        return;
+    }
+
+    if (applyTcRules()) {
+        LOGD("Interfaces changed from [%s] to [%s], rules re-applied in %ld ms",
+             joinNames(current).c_str(), joinNames(wanted).c_str(), getCurrentTimeMs() - started);
+    } else {
+        LOGE("Failed to re-apply rules on %s", joinNames(wanted).c_str());
+    }
+}
+
+bool NetworkStressor::updateLane(size_t index, const NetworkProfilePoint& point) {
+    NetworkStressConfig config;
+    ShapingLane lane;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+        lane = lanes_[index];
+    }
+
+    int ifindex = TcNetlink::interfaceIndex(lane.device);
+    if (ifindex == 0) {
+        LOGE("Interface %s not found", lane.device.c_str());
+        profileErrors_++;
+        return false;
+    }
+
+    // Change messages update the existing qdiscs in place, without the
+    // packet loss and queue reset a delete/re-add cycle would cause
+    if (lane.shaping) {
+        queueShaping(config, ifindex, lane, point, TcOp::Change);
+    }
+    uint32_t parent = lane.shaping ? lane.classId : TC_H_ROOT;
+    netlink_.addNetemQdisc(ifindex, parent, lane.netemHandle, buildNetem(config, point), TcOp::Change);
+
+    std::string error;
+    if (!netlink_.commit(&error)) {
+        LOGE("Failed to update tc ruleset for %s: %s", lane.name.c_str(), error.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastError_ = error;
+        profileErrors_++;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    lanes_[index].applied = point;
+    profileUpdates_++;
+    return true;
+}
+
+bool NetworkStressor::setupIngress(const std::vector<std::string>& interfaces, std::string* error) {
+    std::vector<IngressHook> hooks;
+    std::string alias = IFB_ALIAS_PREFIX;
+
+    for (const auto& iface : interfaces) {
+        // Reuse a clsact qdisc someone else already attached
+        netlink_.addClsactQdisc(TcNetlink::interfaceIndex(iface));
+        IngressHook hook;
+        hook.iface = iface;
+        if (netlink_.commit(error)) {
+            hook.ownsClsact = true;
+        } else if (netlink_.lastErrorCode() == EEXIST) {
+            hook.ownsClsact = false;
+        } else {
+            teardownIngress(netlink_, hooks);
+            return false;
+        }
+        hooks.push_back(hook);
+
+        if (hooks.size() > 1) alias += ",";
+        alias += iface + (hook.ownsClsact ? ":owned" : ":shared");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ingressHooks_ = hooks;
+    }
+
+    netlink_.addIfbLink(IFB_NAME, alias);
+    if (!netlink_.commit(error)) {
+        teardownIngress(netlink_, hooks);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ingressHooks_.clear();
+        return false;
+    }
+
+    LOGD("Redirecting ingress of %s to %s", joinNames(interfaces).c_str(), IFB_NAME);
+    return true;
+}
+
+void NetworkStressor::teardownIngress(TcNetlink& netlink, const std::vector<IngressHook>& hooks) {
+    // Drop the redirects before the IFB: mirred discards packets whose
+    // target device has gone away
+    for (const auto& hook : hooks) {
+        int ifindex = TcNetlink::interfaceIndex(hook.iface);
+        if (ifindex == 0) continue;
+        if (hook.ownsClsact) {
+            netlink.deleteQdisc(ifindex, TC_H_CLSACT);
+        } else {
+            netlink.deleteFilter(ifindex, INGRESS_PARENT, INGRESS_FILTER_PRIORITY);
+        }
+        netlink.commit();
+    }
+
+    if (TcNetlink::interfaceIndex(IFB_NAME) != 0) {
+        netlink.deleteLink(IFB_NAME);
+        netlink.commit();
+    }
+}
+
+void NetworkStressor::cleanupStaleIngress() {
+    if (TcNetlink::interfaceIndex(IFB_NAME) == 0) return;
+
+    std::string alias;
+    std::ifstream file(std::string("/sys/class/net/") + IFB_NAME + "/ifalias");
+    std::getline(file, alias);
+
+    // "danr:<interface>:<owned|shared>[,<interface>:<owned|shared>...]"
+    std::vector<IngressHook> hooks;
+    if (alias.compare(0, strlen(IFB_ALIAS_PREFIX), IFB_ALIAS_PREFIX) == 0) {
+        std::stringstream ss(alias.substr(strlen(IFB_ALIAS_PREFIX)));
+        std::string entry;
+        while (std::getline(ss, entry, ',')) {
+            size_t colon = entry.rfind(':');
+            IngressHook hook;
+            hook.iface = entry.substr(0, colon);
+            hook.ownsClsact = colon != std::string::npos && entry.substr(colon + 1) == "owned";
+            hooks.push_back(hook);
+        }
+    }
+
+    std::vector<std::string> names;
+    for (const auto& hook : hooks) names.push_back(hook.iface);
+    LOGD("Removing stale ingress redirect of %s", hooks.empty() ? "unknown interface" : joinNames(names).c_str());
+    TcNetlink netlink;
+    teardownIngress(netlink, hooks);
+}
+
+void NetworkStressor::removeTcRules() {
+    std::vector<IngressHook> hooks;
+    std::vector<std::string> shaped;
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        iface = config_.targetInterface;
+        hooks.swap(ingressHooks_);
+        shaped = shapedInterfaces_;
     }
 
-    // Remove root qdisc (removes all child qdiscs too)
-    std::string cmd = "tc qdisc del dev " + iface + " root 2>/dev/null";
-    executeCommand(cmd);
+    if (!hooks.empty()) {
+        teardownIngress(netlink_, hooks);
+        LOGD("Ingress redirection removed");
+    }
+
+    if (!tcRulesApplied_.load()) return;
 
+    // Remove root qdisc (removes all child qdiscs too). ENOENT just means
+    // nothing was installed.
+    std::vector<RestoreJournal::Entry> released;
+    for (const auto& iface : shaped) {
+        int ifindex = TcNetlink::interfaceIndex(iface);
+        if (ifindex != 0) {
+            netlink_.deleteQdisc(ifindex, TC_H_ROOT);
+            netlink_.commit();
+        }
+        released.push_back({ RestoreJournal::Kind::Qdisc, iface, "" });
+    }
+    RestoreJournal::getInstance().release(released);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shapedInterfaces_.clear();
+    }
     tcRulesApplied_.store(false);
     LOGD("Network stress rules removed");
 }
 
-bool NetworkStressor::executeCommand(const std::string& cmd, std::string* output) {
-    LOGD("Executing: %s", cmd.c_str());
+// ============================================================================
+// Verification
+// ============================================================================
 
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-        LOGE("Failed to execute command");
+std::vector<size_t> NetworkStressor::probedLanes() const {
+    // Probes from this process are classified like any other socket: per app
+    // they join the chosen app's class, otherwise they cross the uplink lane
+    // on the way out and the downlink lane on the way back. They only use the
+    // primary interface.
+    std::vector<size_t> result;
+    std::string primary = primaryInterface();
+    for (size_t i = 0; i < lanes_.size(); i++) {
+        const ShapingLane& lane = lanes_[i];
+        if (lane.device != primary && lane.device != IFB_NAME) continue;
+        if (!perApp_) {
+            result.push_back(i);
+        } else if (config_.probeApp.empty() ? result.empty() : lane.name == config_.probeApp) {
+            // Lanes on the primary interface carry the plain package name
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+bool NetworkStressor::openProbe(LatencyProbe& probe, const std::string& iface, std::string* error) {
+    std::string target;
+    int port;
+    int uid = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        target = config_.probeTarget;
+        port = config_.probePort;
+        for (size_t i : probedLanes()) {
+            if (lanes_[i].uid >= 0) uid = lanes_[i].uid;
+        }
+    }
+
+    if (target.empty()) {
+        target = RouteMonitor::defaultGateway(iface);
+        if (target.empty()) {
+            if (error) *error = "no default gateway on " + iface + ", set probeTarget";
+            return false;
+        }
+    }
+
+    if (!probe.open(target, port, iface, uid, error)) {
         return false;
     }
 
-    if (output) {
-        char buffer[256];
-        while (fgets(buffer, sizeof(buffer), pipe)) {
-            *output += buffer;
+    std::lock_guard<std::mutex> lock(mutex_);
+    probeTarget_ = target;
+    probeMethod_ = probe.method();
+    return true;
+}
+
+void NetworkStressor::measureBaseline() {
+    std::string iface;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        iface = primaryInterface();
+    }
+
+    LatencyProbe probe;
+    std::string error;
+    if (!openProbe(probe, iface, &error)) {
+        LOGE("Latency probe unavailable: %s", error.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastError_ = error;
+        return;
+    }
+
+    // The minimum is the best estimate of the unloaded path. Shaping waits
+    // for this, so a target that does not answer twice is given up on.
+    long best = -1;
+    for (int i = 0; i < BASELINE_PROBES && running_.load(); i++) {
+        long rtt = probe.measure(BASELINE_TIMEOUT_MS);
+        if (rtt >= 0 && (best < 0 || rtt < best)) best = rtt;
+        if (best < 0 && i >= 1) break;
+        usleep(MIN_PROBE_INTERVAL_MS * 1000);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    LOGD("Baseline RTT to %s: %ld us", probeTarget_.c_str(), best);
+    baselineRttUs_ = best;
+}
+
+void NetworkStressor::monitorFunction() {
+    bool probeEnabled;
+    int intervalMs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        probeEnabled = config_.probe;
+        intervalMs = probeEnabled ? std::max(config_.probeIntervalMs, MIN_PROBE_INTERVAL_MS)
+                                  : STATS_INTERVAL_MS;
+    }
+
+    // Nothing to observe until the worker has installed the rules
+    while (running_.load() && !tcRulesApplied_.load()) {
+        usleep(MIN_PROBE_INTERVAL_MS * 1000);
+    }
+    if (!running_.load()) return;
+
+    LatencyProbe probe;
+    std::string probeDevice;
+    bool firstProbe = true;
+
+    // A separate socket, so dumps never interleave with the worker's batches
+    TcNetlink statsNetlink;
+    std::vector<uint64_t> lastBytes;
+    long lastSampleMs = 0;
+    long nextStatsMs = 0;
+
+    while (running_.load()) {
+        long tickStart = getCurrentTimeMs();
+
+        // Follow the primary interface; the baseline was taken on the old
+        // path and no longer applies
+        std::string primary;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            primary = primaryInterface();
+        }
+        if (probeEnabled && primary != probeDevice) {
+            probe.close();
+            probeDevice = primary;
+            if (!firstProbe) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                baselineRttUs_ = -1;
+                probeWindow_.clear();
+            }
+            firstProbe = false;
+
+            std::string error;
+            if (!primary.empty() && !openProbe(probe, primary, &error)) {
+                LOGE("Latency probe unavailable: %s", error.c_str());
+                std::lock_guard<std::mutex> lock(mutex_);
+                lastError_ = error;
+            }
+        }
+
+        if (probe.isOpen()) {
+            long rtt = probe.measure(PROBE_TIMEOUT_MS);
+            std::lock_guard<std::mutex> lock(mutex_);
+            probesSent_++;
+            if (rtt >= 0) probesReceived_++;
+            probeWindow_.push_back(rtt);
+            if (probeWindow_.size() > PROBE_WINDOW) probeWindow_.pop_front();
         }
+
+        if (getCurrentTimeMs() >= nextStatsMs) {
+            readQdiscStats(statsNetlink, &lastBytes, &lastSampleMs);
+            nextStatsMs = getCurrentTimeMs() + STATS_INTERVAL_MS;
+        }
+
+        // Short sleeps keep stop() responsive with long intervals
+        while (running_.load() && getCurrentTimeMs() - tickStart < intervalMs) {
+            usleep(MIN_PROBE_INTERVAL_MS * 1000 / 2);
+        }
+    }
+}
+
+void NetworkStressor::readQdiscStats(TcNetlink& netlink, std::vector<uint64_t>* lastBytes,
+                                     long* lastSampleMs) {
+    std::vector<ShapingLane> lanes;
+    std::string shaper;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lanes = lanes_;
+        shaper = config_.shaper;
+    }
+
+    long now = getCurrentTimeMs();
+    long elapsedMs = now - *lastSampleMs;
+    bool haveRate = *lastSampleMs > 0 && elapsedMs > 0 && lastBytes->size() == lanes.size();
+    lastBytes->resize(lanes.size(), 0);
+    *lastSampleMs = now;
+
+    std::vector<TcStats> qdiscs;
+    std::vector<TcStats> classes;
+    std::string device;
+
+    for (size_t i = 0; i < lanes.size(); i++) {
+        ShapingLane& lane = lanes[i];
+
+        if (lane.device != device) {
+            int ifindex = TcNetlink::interfaceIndex(lane.device);
+            std::string error;
+            if (ifindex == 0 || !netlink.dumpQdiscStats(ifindex, &qdiscs, &error) ||
+                !netlink.dumpClassStats(ifindex, &classes, &error)) {
+                qdiscs.clear();
+                classes.clear();
+            }
+            device = lane.device;
+        }
+
+        // Where the lane's bandwidth limit lives: its HTB class, the TBF
+        // root, or (unshaped) the netem qdisc that carries all its packets
+        lane.shaperStats = TcStats();
+        lane.netemStats = TcStats();
+        bool inClass = lane.shaping && (lane.uid >= 0 || shaper == "htb");
+        uint32_t shaperHandle = lane.shaping && !inClass ? tcHandle(ROOT_HANDLE_MAJOR, 0) : 0;
+        for (const auto& stats : inClass ? classes : qdiscs) {
+            if (inClass && stats.handle == lane.classId) lane.shaperStats = stats;
+            if (!inClass && lane.shaping && stats.handle == shaperHandle) lane.shaperStats = stats;
+        }
+        for (const auto& stats : qdiscs) {
+            if (lane.netem && stats.handle == lane.netemHandle) lane.netemStats = stats;
+        }
+
+        uint64_t bytes = lane.shaping ? lane.shaperStats.bytes : lane.netemStats.bytes;
+        lane.throughputKbps = haveRate && bytes >= (*lastBytes)[i]
+            ? static_cast<long>((bytes - (*lastBytes)[i]) * 8 / elapsedMs)
+            : 0;
+        (*lastBytes)[i] = bytes;
     }
 
-    int status = pclose(pipe);
-    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < lanes_.size() && i < lanes.size(); i++) {
+        lanes_[i].shaperStats = lanes[i].shaperStats;
+        lanes_[i].netemStats = lanes[i].netemStats;
+        lanes_[i].throughputKbps = lanes[i].throughputKbps;
+    }
+}
+
+// Long-run loss rate of the configured model; for Gilbert-Elliott that is
+// the loss of each state weighted by the share of time spent in it
+static double expectedLossPercent(const NetworkStressConfig& config, const NetworkProfilePoint& point) {
+    if (config.lossModel != "gemodel") return point.lossPercent;
+
+    double enter = config.geGoodToBadPercent;
+    double leave = config.geBadToGoodPercent;
+    if (enter + leave <= 0) return config.geGoodLossPercent;
+    double bad = enter / (enter + leave);
+    return bad * config.geBadLossPercent + (1 - bad) * config.geGoodLossPercent;
 }
 
-bool NetworkStressor::checkTcAvailable() {
-    std::string output;
-    // Try to run tc without arguments to check if it exists
-    if (executeCommand("which tc 2>/dev/null", &output)) {
-        return !output.empty();
+// Time the standing queue of a rate-limited lane adds in front of a packet
+static double queueDelayUs(uint64_t backlogBytes, int bandwidthKbps) {
+    if (bandwidthKbps <= 0) return 0;
+    return backlogBytes * 8000.0 / bandwidthKbps;
+}
+
+std::string NetworkStressor::probeVerdict() const {
+    // Caller holds mutex_
+    if (probeMethod_.empty()) return "unavailable";
+    long received = 0;
+    double sum = 0;
+    for (long rtt : probeWindow_) {
+        if (rtt < 0) continue;
+        received++;
+        sum += rtt;
     }
+    if (probeWindow_.size() < MIN_PROBES_FOR_VERDICT) return "pending";
+    if (received == 0) return "unreachable";
 
-    // Try common locations
-    if (executeCommand("ls /system/bin/tc 2>/dev/null", &output)) {
-        return !output.empty();
+    double expectedDelayUs = 0;
+    double jitterUs = 0;
+    for (size_t i : probedLanes()) {
+        const ShapingLane& lane = lanes_[i];
+        // netem counts emulated losses as drops, so a qdisc that saw neither
+        // packets nor drops was bypassed (e.g. by a hardware offload)
+        if (lane.netem && lane.netemStats.packets == 0 && lane.netemStats.drops == 0) {
+            return "bypassed";
+        }
+        expectedDelayUs += lane.applied.delayMs * 1000.0 +
+            queueDelayUs(lane.shaperStats.backlogBytes + lane.netemStats.backlogBytes,
+                         lane.applied.bandwidthKbps);
+        jitterUs += lane.applied.jitterMs * 1000.0;
     }
+    if (baselineRttUs_ < 0) return "no-baseline";
 
-    return false;
+    double addedUs = sum / received - baselineRttUs_;
+    double tolerance = std::max(5000.0, expectedDelayUs * 0.2) + jitterUs;
+    return std::abs(addedUs - expectedDelayUs) <= tolerance ? "ok" : "mismatch";
 }
 
 StressStatus NetworkStressor::getStatus() const {
@@ -234,11 +1151,113 @@ StressStatus NetworkStressor::getStatus() const {
 
     if (status.isRunning) {
         std::lock_guard<std::mutex> lock(mutex_);
-        status.data["interface"] = config_.targetInterface;
+        status.data["interface"] = joinNames(interfaces_);
+        status.data["targetInterface"] = config_.targetInterface;
+        status.data["interfaceChanges"] = std::to_string(interfaceChanges_.load());
         status.data["bandwidthLimitKbps"] = std::to_string(config_.bandwidthLimitKbps);
         status.data["latencyMs"] = std::to_string(config_.latencyMs);
         status.data["packetLossPercent"] = std::to_string(config_.packetLossPercent);
         status.data["rulesApplied"] = tcRulesApplied_.load() ? "true" : "false";
+        status.data["shaper"] = config_.shaper;
+        status.data["jitterMs"] = std::to_string(config_.jitterMs);
+        status.data["delayDistribution"] = config_.delayDistribution;
+        status.data["lossModel"] = config_.lossModel;
+        status.data["profileUpdates"] = std::to_string(profileUpdates_.load());
+        status.data["profileErrors"] = std::to_string(profileErrors_.load());
+
+        std::string apps;
+        for (const auto& lane : lanes_) {
+            // The primary interface's uplink lane keeps the flat keys
+            bool uplink = lane.uid < 0 && lane.device == primaryInterface();
+            std::string prefix = uplink ? "" : lane.name + ".";
+
+            // Counters read back from the kernel, next to what was configured
+            status.data[prefix + "throughputKbps"] = std::to_string(lane.throughputKbps);
+            status.data[prefix + "qdiscDrops"] = std::to_string(lane.shaperStats.drops + lane.netemStats.drops);
+            status.data[prefix + "qdiscOverlimits"] = std::to_string(lane.shaperStats.overlimits);
+            status.data[prefix + "qdiscBacklogBytes"] =
+                std::to_string(lane.shaperStats.backlogBytes + lane.netemStats.backlogBytes);
+
+            if (uplink) {
+                if (!lane.profile.empty()) {
+                    status.data["profile"] = lane.profile.name();
+                    status.data["currentBandwidthKbps"] = std::to_string(lane.applied.bandwidthKbps);
+                    status.data["currentDelayMs"] = std::to_string(lane.applied.delayMs);
+                    status.data["currentJitterMs"] = std::to_string(lane.applied.jitterMs);
+                    status.data["currentLossPercent"] = formatPercent(lane.applied.lossPercent);
+                }
+                continue;
+            }
+
+            if (lane.uid >= 0) {
+                if (!apps.empty()) apps += ",";
+                apps += lane.name;
+                status.data[prefix + "uid"] = std::to_string(lane.uid);
+            }
+            status.data[prefix + "bandwidthKbps"] = std::to_string(lane.applied.bandwidthKbps);
+            status.data[prefix + "delayMs"] = std::to_string(lane.applied.delayMs);
+            status.data[prefix + "jitterMs"] = std::to_string(lane.applied.jitterMs);
+            status.data[prefix + "lossPercent"] = formatPercent(lane.applied.lossPercent);
+            if (!lane.profile.empty()) {
+                status.data[prefix + "profile"] = lane.profile.name();
+            }
+        }
+        if (perApp_) {
+            status.data["apps"] = apps;
+        }
+        status.data["ingress"] = ingressHooks_.empty() ? "false" : "true";
+
+        if (config_.probe) {
+            long received = 0;
+            double sum = 0;
+            double sumSquares = 0;
+            for (long rtt : probeWindow_) {
+                if (rtt < 0) continue;
+                received++;
+                sum += rtt;
+                sumSquares += static_cast<double>(rtt) * rtt;
+            }
+
+            // What the probe should see: the delays of every lane it crosses
+            // add up, plus the time to drain their queues; losses compound
+            double expectedDelayMs = 0;
+            double queueUs = 0;
+            double deliveredFraction = 1;
+            for (size_t i : probedLanes()) {
+                expectedDelayMs += lanes_[i].applied.delayMs;
+                queueUs += queueDelayUs(lanes_[i].shaperStats.backlogBytes + lanes_[i].netemStats.backlogBytes,
+                                        lanes_[i].applied.bandwidthKbps);
+                deliveredFraction *= 1 - expectedLossPercent(config_, lanes_[i].applied) / 100.0;
+            }
+
+            status.data["probeTarget"] = probeTarget_;
+            status.data["probeMethod"] = probeMethod_;
+            status.data["probeSent"] = std::to_string(probesSent_);
+            status.data["probeReceived"] = std::to_string(probesReceived_);
+            status.data["expectedDelayMs"] = std::to_string(static_cast<int>(expectedDelayMs));
+            status.data["queueDelayMs"] = formatMs(queueUs);
+            status.data["expectedLossPercent"] = formatPercent((1 - deliveredFraction) * 100);
+            if (baselineRttUs_ >= 0) {
+                status.data["baselineRttMs"] = formatMs(baselineRttUs_);
+            }
+            if (!probeWindow_.empty()) {
+                status.data["observedLossPercent"] =
+                    formatPercent(100.0 * (probeWindow_.size() - received) / probeWindow_.size());
+            }
+            if (received > 0) {
+                double mean = sum / received;
+                double variance = std::max(sumSquares / received - mean * mean, 0.0);
+                status.data["rttMs"] = formatMs(mean);
+                status.data["observedJitterMs"] = formatMs(std::sqrt(variance));
+                if (baselineRttUs_ >= 0) {
+                    status.data["observedDelayMs"] = formatMs(mean - baselineRttUs_);
+                }
+            }
+            status.data["probeVerdict"] = probeVerdict();
+        }
+        if (!lastError_.empty()) {
+            status.data["lastError"] = lastError_;
+        }
     }
 
     return status;
@@ -1,17 +1,91 @@
 #pragma once
 
 #include "stressor_base.h"
+#include "tc_netlink.h"
+#include "network_profile.h"
+#include "latency_probe.h"
+#include <deque>
 #include <thread>
 #include <string>
+#include <vector>
 
 namespace danr {
 
+// App whose traffic is shaped on its own. Values left at -1 inherit the
+// interface-wide settings of NetworkStressConfig.
+struct NetworkAppConfig {
+    std::string packageName;
+    int uid = -1;                 // Looked up in packages.list when -1
+    int bandwidthLimitKbps = -1;
+    int latencyMs = -1;
+    int jitterMs = -1;
+    int packetLossPercent = -1;
+    std::string profile;          // Built-in trace; empty inherits the global profile
+};
+
 struct NetworkStressConfig {
     int bandwidthLimitKbps = 0;   // 0 = unlimited, >0 = limit via tc
+    std::string shaper = "htb";   // Bandwidth qdisc: "htb" or "tbf"
     int latencyMs = 0;            // Added latency via tc netem
     int packetLossPercent = 0;    // Simulated packet loss (0-100)
     long durationMs = 300000;     // 5 minutes default
-    std::string targetInterface = "wlan0";
+
+    // Comma-separated interfaces, shaped alike. "auto" stands for whatever
+    // carries the default route and follows it when the device switches
+    // networks (e.g. Wi-Fi to rmnet_data*); "auto,wlan0" shapes both.
+    std::string targetInterface = "auto";
+
+    // Additional netem impairments
+    int jitterMs = 0;                        // Delay variation around latencyMs
+    std::string delayDistribution = "uniform"; // "uniform", "normal" or "pareto"
+    double delayCorrelationPercent = 0;
+    double lossCorrelationPercent = 0;
+    double duplicatePercent = 0;
+    double reorderPercent = 0;               // Needs latencyMs > 0
+    double corruptPercent = 0;
+
+    // "random" uses packetLossPercent; "gemodel" is two-state Gilbert-Elliott
+    // loss for bursty drops
+    std::string lossModel = "random";
+    double geGoodToBadPercent = 1;           // Chance to enter the bad state
+    double geBadToGoodPercent = 30;          // Chance to leave it again
+    double geBadLossPercent = 100;           // Loss while in the bad state
+    double geGoodLossPercent = 0;            // Loss while in the good state
+
+    // Time-varying conditions: a built-in trace ("3g", "congested_lte",
+    // "flaky_wifi") or a CSV file (see NetworkProfile). The trace replaces the
+    // constant bandwidth/latency/jitter/loss/duplicate/reorder/corrupt values.
+    std::string profile;
+    std::string profilePath;
+    bool profileLoop = true;
+    int profileUpdateMs = 250;               // Sampling cadence of the trace
+
+    // When set only these apps are shaped, each in its own HTB class picked by
+    // a uid classifier; all other traffic (adb, the control plane, other apps)
+    // bypasses shaping. Requires shaper "htb".
+    std::vector<NetworkAppConfig> apps;
+
+    // Downlink shaping: ingress traffic of targetInterface is redirected to an
+    // IFB device and shaped on its egress side. Values left at -1 reuse the
+    // uplink settings above. Whole-interface only, since received packets
+    // are not yet associated with an app's socket.
+    bool shapeEgress = true;                 // Set false for downlink-only tests
+    bool shapeIngress = false;
+    int downlinkBandwidthLimitKbps = -1;
+    int downlinkLatencyMs = -1;
+    int downlinkJitterMs = -1;
+    int downlinkPacketLossPercent = -1;
+    std::string downlinkProfile;             // Built-in trace; empty reuses the uplink profile
+
+    // Active verification. An echo probe through the shaped path measures
+    // RTT, jitter and loss against a baseline taken before the rules go in.
+    // It runs on the first interface. qdisc counters are read back while the
+    // test runs either way.
+    bool probe = false;
+    std::string probeTarget;                 // IPv4 echo target; empty = default gateway
+    int probePort = 0;                       // >0: UDP echo service instead of ICMP
+    int probeIntervalMs = 1000;
+    std::string probeApp;                    // Per-app mode: whose class to probe; empty = first app
 };
 
 class NetworkStressor : public StressorBase {
@@ -27,16 +101,88 @@ public:
 
     void setConfig(const NetworkStressConfig& config);
 
+    // Removes an ingress redirect and IFB device left behind by a previous
+    // process that died without stopping the test
+    static void cleanupStaleIngress();
+
 private:
     NetworkStressConfig config_;
     std::thread workerThread_;
     std::atomic<bool> tcRulesApplied_{false};
+    TcNetlink netlink_;
+    std::string lastError_;
+
+    // One independently shaped flow: the interface in one direction, or a
+    // single app
+    struct ShapingLane {
+        std::string name;
+        std::string device;           // Where the qdiscs live (interface or IFB)
+        int uid = -1;                 // -1 for the whole-interface lane
+        NetworkProfilePoint constant; // Conditions when there is no profile
+        NetworkProfile profile;
+        bool shaping = false;         // Has a bandwidth qdisc or class
+        bool netem = false;
+        uint32_t classId = 0;         // Parent of the netem qdisc when shaping
+        uint32_t netemHandle = 0;
+        NetworkProfilePoint applied;
+
+        // Read back from the kernel by the monitor
+        TcStats shaperStats;
+        TcStats netemStats;
+        long throughputKbps = 0;
+    };
+    std::vector<ShapingLane> lanes_;
+    bool perApp_ = false;
+    std::atomic<long> profileUpdates_{0};
+    std::atomic<long> profileErrors_{0};
+    std::atomic<long> profileStartMs_{0};
+
+    // Interfaces currently targeted, with their ifindex so a link that was
+    // removed and re-created under the same name is noticed
+    std::vector<std::string> interfaces_;
+    std::vector<int> interfaceIndexes_;
+    std::vector<std::string> shapedInterfaces_;  // May carry our root qdisc
+    std::atomic<long> interfaceChanges_{0};
+
+    // Interfaces whose ingress is redirected to the IFB
+    struct IngressHook {
+        std::string iface;
+        bool ownsClsact;
+    };
+    std::vector<IngressHook> ingressHooks_;
+
+    // Verification state, written by the monitor thread
+    std::thread monitorThread_;
+    std::string probeTarget_;
+    std::string probeMethod_;
+    long baselineRttUs_ = -1;
+    std::deque<long> probeWindow_;           // Recent RTTs in us, -1 for a lost probe
+    long probesSent_ = 0;
+    long probesReceived_ = 0;
 
     void workerFunction();
+    void monitorFunction();
+    void measureBaseline();
+    bool openProbe(LatencyProbe& probe, const std::string& device, std::string* error);
+    void readQdiscStats(TcNetlink& netlink, std::vector<uint64_t>* lastBytes, long* lastSampleMs);
+    std::vector<size_t> probedLanes() const;
+    std::string probeVerdict() const;
+    bool buildLanes(const NetworkStressConfig& config, const std::vector<std::string>& interfaces,
+                    std::vector<ShapingLane>* lanes);
     bool applyTcRules();
+    void followInterfaces();
+    std::string primaryInterface() const;
+    bool setupIngress(const std::vector<std::string>& interfaces, std::string* error);
+    bool updateLane(size_t index, const NetworkProfilePoint& point);
     void removeTcRules();
-    bool executeCommand(const std::string& cmd, std::string* output = nullptr);
-    bool checkTcAvailable();
+    void queueShaping(const NetworkStressConfig& config, int ifindex, const ShapingLane& lane,
+                      const NetworkProfilePoint& point, TcOp op);
+
+    static bool resolveInterfaces(const std::string& spec, bool strict,
+                                  std::vector<std::string>* interfaces, std::string* error);
+    static void teardownIngress(TcNetlink& netlink, const std::vector<IngressHook>& hooks);
+    static NetworkProfilePoint constantConditions(const NetworkStressConfig& config);
+    static NetemParams buildNetem(const NetworkStressConfig& config, const NetworkProfilePoint& point);
 };
 
 } // namespace danr
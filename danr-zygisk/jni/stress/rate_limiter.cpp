@@ -0,0 +1,110 @@
+#include "rate_limiter.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace danr {
+
+static const int64_t NS_PER_SEC = 1000000000LL;
+
+void TokenBucket::configure(double ratePerSec, double capacity, int64_t nowNs) {
+    ratePerSec_ = ratePerSec;
+    capacity_ = capacity;
+    tokens_ = capacity;
+    lastRefillNs_ = nowNs;
+}
+
+int64_t TokenBucket::reserve(double tokens, int64_t nowNs) {
+    if (!enabled()) return 0;
+
+    if (nowNs > lastRefillNs_) {
+        tokens_ += (nowNs - lastRefillNs_) * ratePerSec_ / NS_PER_SEC;
+        tokens_ = std::min(tokens_, capacity_);
+        lastRefillNs_ = nowNs;
+    }
+
+    tokens_ -= tokens;
+    if (tokens_ >= 0) return 0;
+
+    return static_cast<int64_t>(-tokens_ * NS_PER_SEC / ratePerSec_);
+}
+
+void RateLimiter::configure(const RateLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limits_ = limits;
+
+    int64_t now = nowNs();
+    double burstSec = std::max(limits.burstMs, 1) / 1000.0;
+
+    // IOPS buckets always hold at least one operation so an idle limiter
+    // grants the next request immediately
+    totalBytes_.configure(limits.totalBytesPerSec, limits.totalBytesPerSec * burstSec, now);
+    readBytes_.configure(limits.readBytesPerSec, limits.readBytesPerSec * burstSec, now);
+    writeBytes_.configure(limits.writeBytesPerSec, limits.writeBytesPerSec * burstSec, now);
+    readOps_.configure(limits.readIops, std::max(limits.readIops * burstSec, 1.0), now);
+    writeOps_.configure(limits.writeIops, std::max(limits.writeIops * burstSec, 1.0), now);
+
+    windowStartNs_ = now;
+    window_ = RateLimiterStats();
+    lastWindow_ = RateLimiterStats();
+}
+
+RateLimits RateLimiter::getLimits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limits_;
+}
+
+void RateLimiter::acquire(Op op, size_t bytes) {
+    int64_t waitNs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = nowNs();
+        rollWindow(now);
+
+        double amount = static_cast<double>(bytes);
+        waitNs = totalBytes_.reserve(amount, now);
+        if (op == Op::Read) {
+            waitNs = std::max(waitNs, readBytes_.reserve(amount, now));
+            waitNs = std::max(waitNs, readOps_.reserve(1, now));
+            window_.readBytesPerSec += bytes;
+            window_.readIops++;
+        } else {
+            waitNs = std::max(waitNs, writeBytes_.reserve(amount, now));
+            waitNs = std::max(waitNs, writeOps_.reserve(1, now));
+            window_.writeBytesPerSec += bytes;
+            window_.writeIops++;
+        }
+    }
+
+    if (waitNs > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+    }
+}
+
+RateLimiterStats RateLimiter::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rollWindow(nowNs());
+    return lastWindow_;
+}
+
+void RateLimiter::rollWindow(int64_t nowNs) const {
+    int64_t elapsed = nowNs - windowStartNs_;
+    if (elapsed < NS_PER_SEC) return;
+
+    if (elapsed < 2 * NS_PER_SEC) {
+        lastWindow_ = window_;
+        windowStartNs_ += NS_PER_SEC;
+    } else {
+        // No traffic for more than a full window
+        lastWindow_ = RateLimiterStats();
+        windowStartNs_ = nowNs;
+    }
+    window_ = RateLimiterStats();
+}
+
+int64_t RateLimiter::nowNs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+} // namespace danr
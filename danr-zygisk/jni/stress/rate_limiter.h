@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace danr {
+
+struct RateLimits {
+    long totalBytesPerSec = 0;    // Combined read + write budget, 0 = unlimited
+    long readBytesPerSec = 0;     // 0 = unlimited
+    long writeBytesPerSec = 0;    // 0 = unlimited
+    long readIops = 0;            // 0 = unlimited
+    long writeIops = 0;           // 0 = unlimited
+    int burstMs = 50;             // Idle credit a bucket may accumulate
+};
+
+struct RateLimiterStats {
+    // Achieved rates over the last complete one-second window
+    long readBytesPerSec = 0;
+    long writeBytesPerSec = 0;
+    long readIops = 0;
+    long writeIops = 0;
+};
+
+// Single token bucket refilled continuously at nanosecond resolution.
+// Requests may overdraw the bucket; the caller then waits for the debt to
+// be repaid, which paces consecutive requests evenly instead of bursting.
+class TokenBucket {
+public:
+    void configure(double ratePerSec, double capacity, int64_t nowNs);
+    bool enabled() const { return ratePerSec_ > 0; }
+
+    // Takes tokens and returns how many ns the caller must wait
+    int64_t reserve(double tokens, int64_t nowNs);
+
+private:
+    double ratePerSec_ = 0;
+    double capacity_ = 0;
+    double tokens_ = 0;
+    int64_t lastRefillNs_ = 0;
+};
+
+// Thread-safe I/O rate limiter shared by any number of workers. Every
+// request is charged against the combined byte budget, its direction's byte
+// budget and its direction's IOPS budget, and blocks until all three allow it.
+class RateLimiter {
+public:
+    enum class Op { Read, Write };
+
+    void configure(const RateLimits& limits);
+    RateLimits getLimits() const;
+
+    void acquire(Op op, size_t bytes);
+    RateLimiterStats getStats() const;
+
+private:
+    mutable std::mutex mutex_;
+    RateLimits limits_;
+    TokenBucket totalBytes_;
+    TokenBucket readBytes_;
+    TokenBucket writeBytes_;
+    TokenBucket readOps_;
+    TokenBucket writeOps_;
+
+    // Per-second accounting
+    mutable int64_t windowStartNs_ = 0;
+    mutable RateLimiterStats window_;
+    mutable RateLimiterStats lastWindow_;
+
+    void rollWindow(int64_t nowNs) const;
+    static int64_t nowNs();
+};
+
+} // namespace danr
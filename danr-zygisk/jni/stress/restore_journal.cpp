@@ -0,0 +1,303 @@
+#include "restore_journal.h"
+#include "sysfs_accessor.h"
+#include "tc_netlink.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <linux/pkt_sched.h>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-RestoreJournal", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-RestoreJournal", __VA_ARGS__)
+
+namespace danr {
+
+// Next to config.json; a module update replaces the directory, but it
+// also takes a reboot, which resets everything the journal would. Tests
+// point it elsewhere.
+#ifndef DANR_JOURNAL_DIR
+#define DANR_JOURNAL_DIR "/data/adb/modules/danr-zygisk"
+#endif
+static const char* JOURNAL_DIR = DANR_JOURNAL_DIR;
+static const char* JOURNAL_PATH = DANR_JOURNAL_DIR "/restore.journal";
+static const char* JOURNAL_TEMP_PATH = DANR_JOURNAL_DIR "/restore.journal.tmp";
+
+// Released entries leave tombstones behind; past this many lines the live
+// entries are rewritten into a fresh file
+static const size_t MAX_APPENDED_LINES = 512;
+
+static const char* kindName(RestoreJournal::Kind kind) {
+    return kind == RestoreJournal::Kind::Sysfs ? "sysfs" : "qdisc";
+}
+
+static bool syncDirectory() {
+    int fd = open(JOURNAL_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool success = fsync(fd) == 0;
+    close(fd);
+    return success;
+}
+
+static bool writeFully(int fd, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t written = write(fd, data.data() + offset, data.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+RestoreJournal& RestoreJournal::getInstance() {
+    static RestoreJournal instance;
+    return instance;
+}
+
+RestoreJournal::~RestoreJournal() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool RestoreJournal::ensureOpen() {
+    if (fd_ >= 0) return true;
+    if (failed_) return false;
+
+    bool existed = access(JOURNAL_PATH, F_OK) == 0;
+    fd_ = open(JOURNAL_PATH, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        LOGE("Cannot open %s: %s, changes won't survive a crash", JOURNAL_PATH, strerror(errno));
+        failed_ = true;
+        return false;
+    }
+    // A new file only survives power loss once its directory entry does
+    if (!existed) {
+        syncDirectory();
+    }
+    return true;
+}
+
+bool RestoreJournal::append(const std::string& lines) {
+    if (lines.empty()) return true;
+    if (!ensureOpen()) return false;
+
+    if (!writeFully(fd_, lines) || fdatasync(fd_) != 0) {
+        LOGE("Failed to write %s: %s", JOURNAL_PATH, strerror(errno));
+        return false;
+    }
+    for (char c : lines) {
+        if (c == '\n') appendedLines_++;
+    }
+    return true;
+}
+
+void RestoreJournal::compact() {
+    if (fd_ < 0) return;
+
+    if (live_.empty()) {
+        if (ftruncate(fd_, 0) == 0) {
+            fdatasync(fd_);
+            appendedLines_ = 0;
+        }
+        return;
+    }
+    if (appendedLines_ <= MAX_APPENDED_LINES) return;
+
+    std::string lines;
+    for (const Entry& entry : live_) {
+        lines += formatLine('+', entry);
+    }
+
+    // Rename over the old file, so a crash leaves one journal or the other
+    int fd = open(JOURNAL_TEMP_PATH, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    bool success = writeFully(fd, lines) && fsync(fd) == 0;
+    close(fd);
+    if (!success || rename(JOURNAL_TEMP_PATH, JOURNAL_PATH) != 0) {
+        unlink(JOURNAL_TEMP_PATH);
+        return;
+    }
+    syncDirectory();
+
+    close(fd_);
+    fd_ = -1;
+    appendedLines_ = live_.size();
+    ensureOpen();
+}
+
+RestoreJournal::Entry* RestoreJournal::find(Kind kind, const std::string& target) {
+    for (Entry& entry : live_) {
+        if (entry.kind == kind && entry.target == target) return &entry;
+    }
+    return nullptr;
+}
+
+bool RestoreJournal::record(const std::vector<Entry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string lines;
+    for (const Entry& entry : entries) {
+        if (find(entry.kind, entry.target)) continue;
+        if (entry.target.find_first_of("\t\n") != std::string::npos ||
+            entry.value.find_first_of("\t\n") != std::string::npos) {
+            LOGE("Not journaling %s: unsupported characters", entry.target.c_str());
+            continue;
+        }
+        live_.push_back(entry);
+        lines += formatLine('+', entry);
+    }
+    return append(lines);
+}
+
+bool RestoreJournal::recordSysfs(const std::string& path, const std::string& original) {
+    return record({ { Kind::Sysfs, path, original } });
+}
+
+bool RestoreJournal::recordQdisc(const std::string& iface) {
+    return record({ { Kind::Qdisc, iface, "" } });
+}
+
+void RestoreJournal::release(const std::vector<Entry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string lines;
+    for (const Entry& entry : entries) {
+        Entry* live = find(entry.kind, entry.target);
+        if (!live) continue;
+        lines += formatLine('-', *live);
+        live_.erase(live_.begin() + (live - live_.data()));
+    }
+    if (lines.empty()) return;
+
+    // Nothing left to undo: truncating says so without the tombstones
+    if (!live_.empty()) {
+        append(lines);
+    }
+    compact();
+}
+
+void RestoreJournal::releaseSysfs(const std::string& path) {
+    release({ { Kind::Sysfs, path, "" } });
+}
+
+void RestoreJournal::releaseQdisc(const std::string& iface) {
+    release({ { Kind::Qdisc, iface, "" } });
+}
+
+size_t RestoreJournal::replay() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::ifstream file(JOURNAL_PATH);
+    if (!file) return 0;
+    std::vector<Entry> pending = pendingEntries(file);
+    file.close();
+
+    for (const Entry& entry : pending) {
+        bool success = undo(entry);
+        LOGD("Replayed %s %s%s%s", kindName(entry.kind), entry.target.c_str(),
+             entry.value.empty() ? "" : " = ", entry.value.c_str());
+        if (!success) {
+            LOGE("Failed to undo %s %s", kindName(entry.kind), entry.target.c_str());
+        }
+    }
+
+    // Everything is back to how it was before the previous instance, or as
+    // close as it will get; retrying on every start wouldn't help
+    live_.clear();
+    appendedLines_ = 0;
+    if (ensureOpen() && ftruncate(fd_, 0) == 0) {
+        fdatasync(fd_);
+    }
+    if (!pending.empty()) {
+        LOGD("Restored %zu settings left behind by a previous instance", pending.size());
+    }
+    return pending.size();
+}
+
+std::vector<RestoreJournal::Entry> RestoreJournal::pendingEntries(std::istream& in) {
+    // Only newline-terminated records count. A torn last line (crash
+    // mid-append) may still parse, e.g. with its value cut short, but its
+    // change was never made, since the record is written first.
+    std::vector<Entry> pending;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (in.eof()) break;
+
+        char op;
+        Entry entry;
+        if (!parseLine(line, &op, &entry)) continue;
+
+        auto it = pending.begin();
+        while (it != pending.end() && !(it->kind == entry.kind && it->target == entry.target)) ++it;
+        if (op == '+' && it == pending.end()) {
+            pending.push_back(entry);
+        } else if (op == '-' && it != pending.end()) {
+            pending.erase(it);
+        }
+    }
+
+    // Changes are unwound newest first, like the owners do it live: e.g. a
+    // cpuset parent is widened before the children narrowed after it, and
+    // a devfreq cap is raised before the floor below it
+    std::reverse(pending.begin(), pending.end());
+    return pending;
+}
+
+std::string RestoreJournal::formatLine(char op, const Entry& entry) {
+    // "+\tsysfs\t<path>\t<value>\n" / "-\tsysfs\t<path>\t\n"
+    std::string line(1, op);
+    line += "\t";
+    line += kindName(entry.kind);
+    line += "\t" + entry.target + "\t";
+    if (op == '+') line += entry.value;
+    line += "\n";
+    return line;
+}
+
+bool RestoreJournal::parseLine(const std::string& line, char* op, Entry* entry) {
+    size_t kindStart = 2;
+    size_t targetStart = line.find('\t', kindStart);
+    if (line.size() < 2 || (line[0] != '+' && line[0] != '-') || line[1] != '\t' ||
+        targetStart == std::string::npos) {
+        return false;
+    }
+    size_t valueStart = line.find('\t', targetStart + 1);
+    if (valueStart == std::string::npos) return false;
+
+    std::string kind = line.substr(kindStart, targetStart - kindStart);
+    if (kind == "sysfs") {
+        entry->kind = Kind::Sysfs;
+    } else if (kind == "qdisc") {
+        entry->kind = Kind::Qdisc;
+    } else {
+        return false;
+    }
+    *op = line[0];
+    entry->target = line.substr(targetStart + 1, valueStart - targetStart - 1);
+    entry->value = line.substr(valueStart + 1);
+    return !entry->target.empty();
+}
+
+bool RestoreJournal::undo(const Entry& entry) {
+    if (entry.kind == Kind::Sysfs) {
+        return SysfsAccessor::writeFile(entry.target, entry.value);
+    }
+
+    // Deleting the root qdisc puts the interface's default back. An
+    // interface that has gone away took its qdiscs along.
+    int ifindex = TcNetlink::interfaceIndex(entry.target);
+    if (ifindex == 0) return true;
+
+    TcNetlink netlink;
+    if (!netlink.open()) return false;
+    netlink.deleteQdisc(ifindex, TC_H_ROOT);
+    return netlink.commit() || netlink.lastErrorCode() == ENOENT;
+}
+
+} // namespace danr
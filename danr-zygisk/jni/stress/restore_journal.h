@@ -0,0 +1,72 @@
+#pragma once
+
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// Write-ahead log of how to undo every system change the stressors make,
+// so a killed webserver doesn't leave the device throttled or shaped until
+// reboot. Each change is recorded (and fdatasync'd) before it is made and
+// released once its owner has undone it; whatever is still recorded at
+// startup is undone by replay(). The ingress redirect is not journaled:
+// its IFB's ifalias already serves that purpose (see cleanupStaleIngress).
+class RestoreJournal {
+public:
+    enum class Kind {
+        Sysfs,    // target: attribute path, value: what to write back
+        Qdisc     // target: interface whose root qdisc to delete
+    };
+
+    struct Entry {
+        Kind kind;
+        std::string target;
+        std::string value;
+    };
+
+    static RestoreJournal& getInstance();
+
+    // A target already recorded keeps its first value, which is the state
+    // from before any stressor touched it. Returns false if the journal
+    // can't be written; the caller goes ahead regardless.
+    bool record(const std::vector<Entry>& entries);
+    bool recordSysfs(const std::string& path, const std::string& original);
+    bool recordQdisc(const std::string& iface);
+
+    // Entries are matched by kind and target; value is ignored
+    void release(const std::vector<Entry>& entries);
+    void releaseSysfs(const std::string& path);
+    void releaseQdisc(const std::string& iface);
+
+    // Undoes what a previous instance left recorded, newest first, and
+    // empties the journal. Returns the number of entries replayed.
+    size_t replay();
+
+    // The entries a journal leaves to undo, in the order replay() undoes them
+    static std::vector<Entry> pendingEntries(std::istream& in);
+
+private:
+    RestoreJournal() = default;
+    ~RestoreJournal();
+    RestoreJournal(const RestoreJournal&) = delete;
+    RestoreJournal& operator=(const RestoreJournal&) = delete;
+
+    std::mutex mutex_;
+    int fd_ = -1;
+    bool failed_ = false;         // Logged once, then records are dropped quietly
+    std::vector<Entry> live_;     // In recording order
+    size_t appendedLines_ = 0;
+
+    bool ensureOpen();
+    bool append(const std::string& lines);
+    void compact();
+    Entry* find(Kind kind, const std::string& target);
+
+    static std::string formatLine(char op, const Entry& entry);
+    static bool parseLine(const std::string& line, char* op, Entry* entry);
+    static bool undo(const Entry& entry);
+};
+
+} // namespace danr
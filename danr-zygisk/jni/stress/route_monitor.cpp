@@ -0,0 +1,256 @@
+#include "route_monitor.h"
+#include "monotonic_clock.h"
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-RouteMonitor", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-RouteMonitor", __VA_ARGS__)
+
+namespace danr {
+
+// A network switch is a burst of link, address, route and rule messages;
+// wait until it has been quiet this long, but never longer than the cap
+static const int SETTLE_MS = 10;
+static const int MAX_SETTLE_MS = 100;
+
+// Any global address does; only the default route can match it
+static const char* PROBE_DESTINATION_V4 = "8.8.8.8";
+static const char* PROBE_DESTINATION_V6 = "2001:4860:4860::8888";
+
+static int openRequestSocket() {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Sends one request and hands every reply message to onMessage, until the
+// end of a dump or a single (non-multipart) answer
+static bool transact(int fd, const void* request, size_t length,
+                     const std::function<void(const struct nlmsghdr*)>& onMessage) {
+    if (send(fd, request, length, 0) < 0) return false;
+
+    char buffer[32768];
+    for (;;) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+
+        int len = static_cast<int>(received);
+        for (struct nlmsghdr* nh = reinterpret_cast<struct nlmsghdr*>(buffer);
+             NLMSG_OK(nh, len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == NLMSG_DONE) return true;
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                return static_cast<const struct nlmsgerr*>(NLMSG_DATA(nh))->error == 0;
+            }
+            onMessage(nh);
+            if (!(nh->nlmsg_flags & NLM_F_MULTI)) return true;
+        }
+    }
+}
+
+RouteMonitor::~RouteMonitor() {
+    close();
+}
+
+bool RouteMonitor::open() {
+    if (fd_ >= 0) return true;
+
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (fd_ < 0) {
+        LOGE("Failed to create netlink socket: %s", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                     RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOGE("Failed to subscribe to route changes: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    // Android switches the default network by rewriting an ip rule rather
+    // than a route, and rule groups have no legacy bitmask
+    int groups[] = { RTNLGRP_IPV4_RULE, RTNLGRP_IPV6_RULE };
+    for (int group : groups) {
+        setsockopt(fd_, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group));
+    }
+    return true;
+}
+
+void RouteMonitor::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool RouteMonitor::drain() {
+    char buffer[16384];
+    bool any = false;
+    for (;;) {
+        ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            any = true;
+            continue;
+        }
+        // ENOBUFS: notifications were lost, so something certainly changed
+        if (received < 0 && errno == ENOBUFS) {
+            any = true;
+            continue;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        return any;
+    }
+}
+
+bool RouteMonitor::waitForChange(int timeoutMs) {
+    if (fd_ < 0) {
+        usleep(timeoutMs * 1000);
+        return false;
+    }
+
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, timeoutMs) <= 0 || !drain()) {
+        return false;
+    }
+
+    long settleUntil = monotonicMs() + MAX_SETTLE_MS;
+    while (monotonicMs() < settleUntil) {
+        if (poll(&pfd, 1, SETTLE_MS) <= 0) break;
+        drain();
+    }
+    return true;
+}
+
+std::vector<std::string> RouteMonitor::defaultInterfaces() {
+    std::vector<std::string> result;
+    int fd = openRequestSocket();
+    if (fd < 0) return result;
+
+    struct Query {
+        int family;
+        const char* destination;
+    };
+    const Query queries[] = {
+        { AF_INET, PROBE_DESTINATION_V4 },
+        { AF_INET6, PROBE_DESTINATION_V6 },
+    };
+
+    for (const auto& query : queries) {
+        struct {
+            struct nlmsghdr nh;
+            struct rtmsg rtm;
+            char attrs[64];
+        } request;
+        memset(&request, 0, sizeof(request));
+
+        unsigned char address[16];
+        size_t addressLength = query.family == AF_INET ? 4 : 16;
+        inet_pton(query.family, query.destination, address);
+
+        request.nh.nlmsg_type = RTM_GETROUTE;
+        request.nh.nlmsg_flags = NLM_F_REQUEST;
+        request.nh.nlmsg_seq = 1;
+        request.rtm.rtm_family = static_cast<unsigned char>(query.family);
+        request.rtm.rtm_dst_len = static_cast<unsigned char>(addressLength * 8);
+
+        struct rtattr* rta = reinterpret_cast<struct rtattr*>(request.attrs);
+        rta->rta_type = RTA_DST;
+        rta->rta_len = static_cast<unsigned short>(RTA_LENGTH(addressLength));
+        memcpy(RTA_DATA(rta), address, addressLength);
+        request.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg)) + RTA_ALIGN(rta->rta_len);
+
+        // An unreachable destination is answered with an error, which
+        // simply means there is no default route for this family
+        transact(fd, &request, request.nh.nlmsg_len, [&result](const struct nlmsghdr* nh) {
+            if (nh->nlmsg_type != RTM_NEWROUTE) return;
+            const struct rtmsg* rtm = static_cast<const struct rtmsg*>(NLMSG_DATA(nh));
+            int attrLen = static_cast<int>(RTM_PAYLOAD(nh));
+            for (const struct rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, attrLen); attr = RTA_NEXT(attr, attrLen)) {
+                if (attr->rta_type != RTA_OIF) continue;
+
+                int oif;
+                memcpy(&oif, RTA_DATA(attr), sizeof(oif));
+                char name[IF_NAMESIZE];
+                if (!if_indextoname(static_cast<unsigned int>(oif), name)) continue;
+                if (strncmp(name, "v4-", 3) == 0 || strcmp(name, "lo") == 0) continue;
+                if (std::find(result.begin(), result.end(), name) == result.end()) {
+                    result.push_back(name);
+                }
+            }
+        });
+    }
+
+    ::close(fd);
+    return result;
+}
+
+std::string RouteMonitor::defaultGateway(const std::string& iface) {
+    int ifindex = static_cast<int>(if_nametoindex(iface.c_str()));
+    if (ifindex == 0) return "";
+
+    int fd = openRequestSocket();
+    if (fd < 0) return "";
+
+    // Android keeps each network's routes in its own policy routing table,
+    // which /proc/net/route (main table only) does not show, so dump them all
+    struct {
+        struct nlmsghdr nh;
+        struct rtmsg rtm;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.nh.nlmsg_len = sizeof(request);
+    request.nh.nlmsg_type = RTM_GETROUTE;
+    request.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nh.nlmsg_seq = 1;
+    request.rtm.rtm_family = AF_INET;
+
+    std::string gateway;
+    transact(fd, &request, sizeof(request), [&gateway, ifindex](const struct nlmsghdr* nh) {
+        if (nh->nlmsg_type != RTM_NEWROUTE || !gateway.empty()) return;
+        const struct rtmsg* rtm = static_cast<const struct rtmsg*>(NLMSG_DATA(nh));
+        if (rtm->rtm_dst_len != 0 || rtm->rtm_type != RTN_UNICAST) return;
+
+        int oif = 0;
+        struct in_addr via;
+        bool hasGateway = false;
+        int attrLen = static_cast<int>(RTM_PAYLOAD(nh));
+        for (const struct rtattr* rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+            if (rta->rta_type == RTA_OIF) {
+                memcpy(&oif, RTA_DATA(rta), sizeof(oif));
+            } else if (rta->rta_type == RTA_GATEWAY && RTA_PAYLOAD(rta) >= sizeof(via)) {
+                memcpy(&via, RTA_DATA(rta), sizeof(via));
+                hasGateway = true;
+            }
+        }
+
+        char text[INET_ADDRSTRLEN];
+        if (oif == ifindex && hasGateway && inet_ntop(AF_INET, &via, text, sizeof(text))) {
+            gateway = text;
+        }
+    });
+
+    ::close(fd);
+    return gateway;
+}
+
+} // namespace danr
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// Watches the kernel's links and routes over rtnetlink and answers which
+// interfaces currently carry default traffic.
+class RouteMonitor {
+public:
+    RouteMonitor() = default;
+    ~RouteMonitor();
+
+    RouteMonitor(const RouteMonitor&) = delete;
+    RouteMonitor& operator=(const RouteMonitor&) = delete;
+
+    // Subscribes to link, address and route changes
+    bool open();
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    // Blocks for up to timeoutMs. Returns true if anything changed; a burst
+    // of notifications (a network switch produces dozens) is drained as one.
+    bool waitForChange(int timeoutMs);
+
+    // Interfaces the kernel would route Internet traffic from this process
+    // through, for IPv4 and IPv6. This asks the kernel rather than reading
+    // tables, so Android's per-network tables and policy rules are honoured.
+    // clat (v4-*) devices are left out since their traffic leaves again
+    // through the underlying interface.
+    static std::vector<std::string> defaultInterfaces();
+
+    // IPv4 next hop of a default route through iface, empty if there is none
+    // (e.g. point-to-point cellular links)
+    static std::string defaultGateway(const std::string& iface);
+
+private:
+    int fd_ = -1;
+
+    bool drain();
+};
+
+} // namespace danr
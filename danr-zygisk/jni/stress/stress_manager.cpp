@@ -16,6 +16,7 @@ StressManager::StressManager()
     , memoryStressor_(std::make_unique<MemoryStressor>())
     , diskStressor_(std::make_unique<DiskStressor>())
     , networkStressor_(std::make_unique<NetworkStressor>())
+    , trafficStressor_(std::make_unique<TrafficStressor>())
     , thermalStressor_(std::make_unique<ThermalStressor>())
 {
     LOGD("StressManager initialized");
@@ -90,6 +91,22 @@ StressStatus StressManager::getNetworkStatus() const {
     return networkStressor_->getStatus();
 }
 
+// Traffic generator
+bool StressManager::startTrafficStress(const TrafficStressConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return trafficStressor_->start(config);
+}
+
+void StressManager::stopTrafficStress() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trafficStressor_->stop();
+}
+
+StressStatus StressManager::getTrafficStatus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return trafficStressor_->getStatus();
+}
+
 // Thermal stress
 bool StressManager::startThermalStress(const ThermalStressConfig& config) {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -114,6 +131,7 @@ void StressManager::stopAll() {
     memoryStressor_->stop();
     diskStressor_->stop();
     networkStressor_->stop();
+    trafficStressor_->stop();
     thermalStressor_->stop();
 }
 
@@ -123,6 +141,7 @@ bool StressManager::isAnyRunning() const {
            memoryStressor_->isRunning() ||
            diskStressor_->isRunning() ||
            networkStressor_->isRunning() ||
+           trafficStressor_->isRunning() ||
            thermalStressor_->isRunning();
 }
 
@@ -135,6 +154,7 @@ std::string StressManager::getAllStatusJson() const {
     ss << "\"memory\":" << memoryStressor_->getStatus().toJson() << ",";
     ss << "\"disk_io\":" << diskStressor_->getStatus().toJson() << ",";
     ss << "\"network\":" << networkStressor_->getStatus().toJson() << ",";
+    ss << "\"traffic\":" << trafficStressor_->getStatus().toJson() << ",";
     ss << "\"thermal\":" << thermalStressor_->getStatus().toJson();
     ss << "}";
 
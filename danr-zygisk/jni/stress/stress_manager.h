@@ -4,6 +4,7 @@
 #include "memory_stressor.h"
 #include "disk_stressor.h"
 #include "network_stressor.h"
+#include "traffic_stressor.h"
 #include "thermal_stressor.h"
 #include <memory>
 #include <mutex>
@@ -34,6 +35,11 @@ public:
     void stopNetworkStress();
     StressStatus getNetworkStatus() const;
 
+    // Traffic generator controls
+    bool startTrafficStress(const TrafficStressConfig& config);
+    void stopTrafficStress();
+    StressStatus getTrafficStatus() const;
+
     // Thermal stress controls
     bool startThermalStress(const ThermalStressConfig& config);
     void stopThermalStress();
@@ -54,6 +60,7 @@ private:
     std::unique_ptr<MemoryStressor> memoryStressor_;
     std::unique_ptr<DiskStressor> diskStressor_;
     std::unique_ptr<NetworkStressor> networkStressor_;
+    std::unique_ptr<TrafficStressor> trafficStressor_;
     std::unique_ptr<ThermalStressor> thermalStressor_;
 
     mutable std::mutex mutex_;
@@ -0,0 +1,257 @@
+#include "sysfs_accessor.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-Sysfs", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-Sysfs", __VA_ARGS__)
+
+namespace danr {
+
+static const size_t LINE_BUFFER_SIZE = 4096;
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Cuts raw file content down to its first line, trimmed, in place
+static int trimFirstLine(char* buffer, size_t length) {
+    size_t end = 0;
+    while (end < length && buffer[end] != '\n') end++;
+    while (end > 0 && isSpace(buffer[end - 1])) end--;
+
+    size_t start = 0;
+    while (start < end && isSpace(buffer[start])) start++;
+    if (start > 0) memmove(buffer, buffer + start, end - start);
+
+    buffer[end - start] = '\0';
+    return static_cast<int>(end - start);
+}
+
+// The descriptor went stale (the attribute's kobject was removed and
+// re-added, e.g. by CPU hotplug), as opposed to the value being rejected
+static bool isStale(int error) {
+    return error == ENODEV || error == ENOENT || error == EBADF || error == ESTALE;
+}
+
+SysfsAttribute::~SysfsAttribute() {
+    closeFd();
+}
+
+bool SysfsAttribute::ensureOpen() {
+    if (fd_ >= 0) return true;
+
+    // kernfs refuses to open for writing if the attribute has no store
+    // method, and for reading if it has no show method
+    fd_ = open(path_.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ >= 0) {
+        readable_ = writable_ = true;
+        return true;
+    }
+    fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ >= 0) {
+        readable_ = true;
+        writable_ = false;
+        return true;
+    }
+    fd_ = open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd_ >= 0) {
+        readable_ = false;
+        writable_ = true;
+        return true;
+    }
+    return false;
+}
+
+void SysfsAttribute::closeFd() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+int SysfsAttribute::readAll(char* buffer, size_t size) {
+    if (size == 0) return -1;
+    buffer[0] = '\0';
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!ensureOpen() || !readable_) return -1;
+
+        ssize_t length = pread(fd_, buffer, size - 1, 0);
+        if (length >= 0) {
+            buffer[length] = '\0';
+            return static_cast<int>(length);
+        }
+        if (!isStale(errno)) return -1;
+        closeFd();
+    }
+    return -1;
+}
+
+int SysfsAttribute::read(char* buffer, size_t size) {
+    int length = readAll(buffer, size);
+    if (length < 0) return -1;
+    return trimFirstLine(buffer, static_cast<size_t>(length));
+}
+
+std::string SysfsAttribute::readString() {
+    std::string value;
+    readString(&value);
+    return value;
+}
+
+bool SysfsAttribute::readString(std::string* value) {
+    char buffer[LINE_BUFFER_SIZE];
+    int length = read(buffer, sizeof(buffer));
+    if (length < 0) return false;
+    value->assign(buffer, static_cast<size_t>(length));
+    return true;
+}
+
+bool SysfsAttribute::readLong(long* value) {
+    char buffer[64];
+    if (read(buffer, sizeof(buffer)) <= 0) return false;
+
+    char* end;
+    errno = 0;
+    long parsed = strtol(buffer, &end, 10);
+    if (end == buffer || errno != 0) return false;
+    *value = parsed;
+    return true;
+}
+
+long SysfsAttribute::readLong(long defaultValue) {
+    long value;
+    return readLong(&value) ? value : defaultValue;
+}
+
+bool SysfsAttribute::write(const char* value, size_t length) {
+    if (length == 0) {
+        value = "\n";
+        length = 1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!ensureOpen() || !writable_) {
+            LOGE("Failed to open %s for writing", path_.c_str());
+            return false;
+        }
+
+        // sysfs takes the whole value from a single write at offset 0
+        ssize_t written = pwrite(fd_, value, length, 0);
+        if (written == static_cast<ssize_t>(length)) return true;
+        if (written < 0 && isStale(errno)) {
+            closeFd();
+            continue;
+        }
+        LOGE("Failed to write to %s: %s", path_.c_str(), written < 0 ? strerror(errno) : "short write");
+        return false;
+    }
+    return false;
+}
+
+bool SysfsAttribute::writeLong(long value) {
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%ld", value);
+    return write(buffer, static_cast<size_t>(length));
+}
+
+SysfsAccessor& SysfsAccessor::getInstance() {
+    static SysfsAccessor instance;
+    return instance;
+}
+
+SysfsAttribute* SysfsAccessor::attribute(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = attributes_.find(path);
+    if (it != attributes_.end()) {
+        return it->second.get();
+    }
+
+    SysfsAttribute* attribute = new SysfsAttribute(path);
+    attributes_[path].reset(attribute);
+    return attribute;
+}
+
+size_t SysfsAccessor::writeAll(const std::vector<Write>& writes) {
+    size_t failures = 0;
+    char current[LINE_BUFFER_SIZE];
+    for (const Write& write : writes) {
+        if (!write.attribute) {
+            failures++;
+            continue;
+        }
+
+        int length = write.attribute->read(current, sizeof(current));
+        if (length >= 0 && write.value == current) {
+            continue;
+        }
+        if (!write.attribute->write(write.value)) {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+std::string SysfsAccessor::readFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return "";
+
+    char buffer[LINE_BUFFER_SIZE];
+    ssize_t length = ::read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) return "";
+
+    int trimmed = trimFirstLine(buffer, static_cast<size_t>(length));
+    return std::string(buffer, static_cast<size_t>(trimmed));
+}
+
+bool SysfsAccessor::writeFile(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open %s for writing", path.c_str());
+        return false;
+    }
+
+    // As in SysfsAttribute::write
+    std::string data = value.empty() ? "\n" : value;
+    ssize_t written = ::write(fd, data.data(), data.size());
+    bool success = written == static_cast<ssize_t>(data.size());
+    if (!success) {
+        LOGE("Failed to write to %s: %s", path.c_str(), written < 0 ? strerror(errno) : "short write");
+    }
+    close(fd);
+    return success;
+}
+
+std::vector<int> SysfsAccessor::parseCpuList(const std::string& value) {
+    std::vector<int> cpus;
+    std::string token;
+    std::istringstream iss(value);
+    while (iss >> token) {
+        std::istringstream ranges(token);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = atoi(range.c_str());
+            int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+} // namespace danr
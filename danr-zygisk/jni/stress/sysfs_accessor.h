@@ -0,0 +1,91 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// One sysfs or procfs attribute. The descriptor stays open and every read
+// is a pread at offset 0, which makes the kernel regenerate the value, so
+// polling an attribute costs one syscall and no allocation.
+class SysfsAttribute {
+public:
+    SysfsAttribute(const SysfsAttribute&) = delete;
+    SysfsAttribute& operator=(const SysfsAttribute&) = delete;
+    ~SysfsAttribute();
+
+    const std::string& path() const { return path_; }
+
+    // Reads the first line with surrounding whitespace trimmed into buffer
+    // (always NUL-terminated). Returns its length, or -1 if unreadable.
+    int read(char* buffer, size_t size);
+    std::string readString();
+    // Tells an empty attribute (e.g. an inherited cgroup v2 cpuset.cpus)
+    // from an unreadable one
+    bool readString(std::string* value);
+    // Whole content, untrimmed, for multi-line attributes such as
+    // stats/time_in_state. Returns the length, or -1.
+    int readAll(char* buffer, size_t size);
+    bool readLong(long* value);
+    long readLong(long defaultValue);
+
+    // An empty value goes out as a lone newline: a zero-length write never
+    // reaches the attribute's store method
+    bool write(const char* value, size_t length);
+    bool write(const std::string& value) { return write(value.data(), value.size()); }
+    bool writeLong(long value);
+
+private:
+    friend class SysfsAccessor;
+    explicit SysfsAttribute(const std::string& path) : path_(path) {}
+
+    std::string path_;
+    std::mutex mutex_;
+    int fd_ = -1;
+    bool readable_ = false;
+    bool writable_ = false;
+
+    bool ensureOpen();
+    void closeFd();
+};
+
+// Process-wide table of attributes. Attributes are interned by path and
+// live as long as the process, so callers look a path up once (building
+// the string once) and keep the pointer for their polling loops.
+class SysfsAccessor {
+public:
+    static SysfsAccessor& getInstance();
+
+    SysfsAttribute* attribute(const std::string& path);
+
+    struct Write {
+        SysfsAttribute* attribute;
+        std::string value;
+    };
+
+    // Applies writes in order. Attributes already holding the value are
+    // skipped: rewriting e.g. scaling_governor restarts the governor.
+    // Returns the number of writes that failed.
+    size_t writeAll(const std::vector<Write>& writes);
+
+    // Uncached helpers for paths read once, e.g. during discovery
+    static std::string readFile(const std::string& path);
+    static bool writeFile(const std::string& path, const std::string& value);
+
+    // Cores in a cpulist ("0-3,6") or space-separated list ("0 1 2 3", as
+    // in related_cpus), sorted and without duplicates
+    static std::vector<int> parseCpuList(const std::string& value);
+
+private:
+    SysfsAccessor() = default;
+    SysfsAccessor(const SysfsAccessor&) = delete;
+    SysfsAccessor& operator=(const SysfsAccessor&) = delete;
+
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<SysfsAttribute>> attributes_;
+};
+
+} // namespace danr
@@ -0,0 +1,722 @@
+#include "tc_netlink.h"
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/pkt_cls.h>
+#include <linux/tc_act/tc_mirred.h>
+#include <linux/if_link.h>
+#include <linux/if_ether.h>
+#include <linux/gen_stats.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-TcNetlink", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-TcNetlink", __VA_ARGS__)
+
+namespace danr {
+
+static const uint32_t DEFAULT_MTU = 1600;   // iproute2's HTB default
+static const int DIST_TABLE_SIZE = 4096;
+
+static uint16_t createFlags(TcOp op) {
+    return op == TcOp::Create ? NLM_F_CREATE | NLM_F_EXCL : 0;
+}
+
+static std::string describe(TcOp op, const char* object) {
+    return std::string(op == TcOp::Create ? "add " : "change ") + object;
+}
+
+// Probability in netem's fixed point encoding (0 = never, ~0 = always)
+static uint32_t probability(double percent) {
+    double clamped = std::min(std::max(percent, 0.0), 100.0);
+    return static_cast<uint32_t>(std::rint(clamped / 100.0 * UINT32_MAX));
+}
+static const int RECV_TIMEOUT_MS = 2000;
+
+TcNetlink::TcNetlink() = default;
+
+TcNetlink::~TcNetlink() {
+    close();
+}
+
+bool TcNetlink::open() {
+    if (fd_ >= 0) return true;
+
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd_ < 0) {
+        LOGE("Failed to create netlink socket: %s", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOGE("Failed to bind netlink socket: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = RECV_TIMEOUT_MS / 1000;
+    tv.tv_usec = (RECV_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    seq_ = static_cast<uint32_t>(time(nullptr));
+    return true;
+}
+
+void TcNetlink::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    discard();
+}
+
+int TcNetlink::interfaceIndex(const std::string& name) {
+    return static_cast<int>(if_nametoindex(name.c_str()));
+}
+
+bool TcNetlink::isKnownDistribution(const std::string& name) {
+    return name == "uniform" || distributionTable(name) != nullptr;
+}
+
+// ============================================================================
+// Batch building
+// ============================================================================
+
+void TcNetlink::addHtbQdisc(int ifindex, uint32_t parent, uint32_t handle, uint32_t defaultClass) {
+    size_t msg = beginMessage(RTM_NEWQDISC, NLM_F_CREATE | NLM_F_EXCL, ifindex, parent, handle,
+                              "add htb qdisc");
+    addAttrString(TCA_KIND, "htb");
+
+    struct tc_htb_glob glob;
+    memset(&glob, 0, sizeof(glob));
+    glob.version = TC_HTB_PROTOVER;
+    glob.rate2quantum = 10;
+    glob.defcls = defaultClass;
+
+    size_t options = beginNested(TCA_OPTIONS);
+    addAttr(TCA_HTB_INIT, &glob, sizeof(glob));
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::addHtbClass(int ifindex, uint32_t parent, uint32_t classId,
+                            uint64_t rateBytesPerSec, uint64_t ceilBytesPerSec, TcOp op) {
+    size_t msg = beginMessage(RTM_NEWTCLASS, createFlags(op), ifindex, parent, classId,
+                              describe(op, "htb class"));
+    addAttrString(TCA_KIND, "htb");
+
+    struct tc_htb_opt opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.rate.rate = static_cast<uint32_t>(std::min<uint64_t>(rateBytesPerSec, UINT32_MAX));
+    opt.ceil.rate = static_cast<uint32_t>(std::min<uint64_t>(ceilBytesPerSec, UINT32_MAX));
+
+    // Rate tables are only needed by pre-3.11 kernels but are harmless on newer ones
+    uint32_t rtab[256];
+    uint32_t ctab[256];
+    calcRateTable(rateBytesPerSec, rtab, &opt.rate.cell_log);
+    calcRateTable(ceilBytesPerSec, ctab, &opt.ceil.cell_log);
+    opt.rate.cell_align = -1;
+    opt.ceil.cell_align = -1;
+    opt.rate.linklayer = TC_LINKLAYER_ETHERNET;
+    opt.ceil.linklayer = TC_LINKLAYER_ETHERNET;
+
+    // Same default burst as iproute2: one timer tick worth of data plus an MTU
+    uint32_t hz = 100;
+    FILE* psched = fopen("/proc/net/psched", "r");
+    if (psched) {
+        unsigned int nom = 0, denom = 0;
+        if (fscanf(psched, "%*08x%*08x%08x%08x", &nom, &denom) == 2 && nom == 1000000) {
+            hz = denom;
+        }
+        fclose(psched);
+    }
+    opt.buffer = transmitTime(rateBytesPerSec, static_cast<uint32_t>(rateBytesPerSec / hz + DEFAULT_MTU));
+    opt.cbuffer = transmitTime(ceilBytesPerSec, static_cast<uint32_t>(ceilBytesPerSec / hz + DEFAULT_MTU));
+
+    size_t options = beginNested(TCA_OPTIONS);
+    addAttr(TCA_HTB_PARMS, &opt, sizeof(opt));
+    if (rateBytesPerSec >= (1ULL << 32)) {
+        addAttr(TCA_HTB_RATE64, &rateBytesPerSec, sizeof(rateBytesPerSec));
+    }
+    if (ceilBytesPerSec >= (1ULL << 32)) {
+        addAttr(TCA_HTB_CEIL64, &ceilBytesPerSec, sizeof(ceilBytesPerSec));
+    }
+    addAttr(TCA_HTB_RTAB, rtab, sizeof(rtab));
+    addAttr(TCA_HTB_CTAB, ctab, sizeof(ctab));
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::addTbfQdisc(int ifindex, uint32_t parent, uint32_t handle,
+                            uint64_t rateBytesPerSec, long latencyUs, TcOp op) {
+    size_t msg = beginMessage(RTM_NEWQDISC, createFlags(op), ifindex, parent, handle,
+                              describe(op, "tbf qdisc"));
+    addAttrString(TCA_KIND, "tbf");
+
+    // 20ms of traffic, but never less than a few full-size (GSO) packets
+    uint32_t burst = static_cast<uint32_t>(std::max<uint64_t>(rateBytesPerSec / 50, 16 * 1024));
+
+    struct tc_tbf_qopt opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.rate.rate = static_cast<uint32_t>(std::min<uint64_t>(rateBytesPerSec, UINT32_MAX));
+    opt.rate.cell_align = -1;
+    opt.rate.linklayer = TC_LINKLAYER_ETHERNET;
+    opt.buffer = transmitTime(rateBytesPerSec, burst);
+    opt.limit = static_cast<uint32_t>(
+        std::min<uint64_t>(rateBytesPerSec * std::max(latencyUs, 1L) / 1000000 + burst, UINT32_MAX));
+
+    uint32_t rtab[256];
+    calcRateTable(rateBytesPerSec, rtab, &opt.rate.cell_log);
+
+    size_t options = beginNested(TCA_OPTIONS);
+    addAttr(TCA_TBF_PARMS, &opt, sizeof(opt));
+    addAttr(TCA_TBF_BURST, &burst, sizeof(burst));
+    if (rateBytesPerSec >= (1ULL << 32)) {
+        addAttr(TCA_TBF_RATE64, &rateBytesPerSec, sizeof(rateBytesPerSec));
+    }
+    addAttr(TCA_TBF_RTAB, rtab, sizeof(rtab));
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::addNetemQdisc(int ifindex, uint32_t parent, uint32_t handle, const NetemParams& params,
+                              TcOp op) {
+    size_t msg = beginMessage(RTM_NEWQDISC, createFlags(op), ifindex, parent, handle,
+                              describe(op, "netem qdisc"));
+    addAttrString(TCA_KIND, "netem");
+
+    // Reordering sends every gap-th packet immediately while the rest wait
+    // for the configured delay, so it is meaningless without a delay
+    bool reorder = params.reorderPercent > 0 && params.delayUs > 0;
+
+    struct tc_netem_qopt opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.latency = timeToTicks(static_cast<double>(params.delayUs));
+    opt.jitter = timeToTicks(static_cast<double>(params.jitterUs));
+    opt.limit = params.limit;
+    opt.loss = params.gilbertElliott ? 0 : probability(params.lossPercent);
+    opt.duplicate = probability(params.duplicatePercent);
+    opt.gap = reorder ? 1 : 0;
+
+    // netem's TCA_OPTIONS is the fixed struct followed by optional attributes,
+    // not a regular nested attribute
+    size_t options = beginNested(TCA_OPTIONS);
+    appendRaw(&opt, sizeof(opt));
+
+    // Correlations and corruption are sent even when zero: on a change
+    // netem keeps the previous values of attributes left out, so stepping
+    // corruption down to 0 would otherwise leave it on
+    struct tc_netem_corr corr;
+    corr.delay_corr = probability(params.delayCorrelation);
+    corr.loss_corr = probability(params.lossCorrelation);
+    corr.dup_corr = probability(params.duplicateCorrelation);
+    addAttr(TCA_NETEM_CORR, &corr, sizeof(corr));
+
+    if (reorder) {
+        struct tc_netem_reorder reorderOpt;
+        reorderOpt.probability = probability(params.reorderPercent);
+        reorderOpt.correlation = probability(params.reorderCorrelation);
+        addAttr(TCA_NETEM_REORDER, &reorderOpt, sizeof(reorderOpt));
+    }
+
+    struct tc_netem_corrupt corrupt;
+    corrupt.probability = probability(params.corruptPercent);
+    corrupt.correlation = params.corruptPercent > 0 ? probability(params.corruptCorrelation) : 0;
+    addAttr(TCA_NETEM_CORRUPT, &corrupt, sizeof(corrupt));
+
+    if (params.gilbertElliott) {
+        // Kernel semantics: h is the chance a packet survives the bad state,
+        // k1 the chance one is lost in the good state
+        struct tc_netem_gemodel ge;
+        ge.p = probability(params.geGoodToBad);
+        ge.r = probability(params.geBadToGood);
+        ge.h = probability(100.0 - params.geBadLoss);
+        ge.k1 = probability(params.geGoodLoss);
+
+        size_t loss = beginNested(TCA_NETEM_LOSS);
+        addAttr(NETEM_LOSS_GE, &ge, sizeof(ge));
+        endNested(loss);
+    }
+
+    // Without a table netem draws jitter from a uniform distribution
+    const std::vector<int16_t>* table = distributionTable(params.distribution);
+    if (table && params.jitterUs > 0) {
+        addAttr(TCA_NETEM_DELAY_DIST, table->data(), table->size() * sizeof(int16_t));
+    }
+
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::addBpfFilter(int ifindex, uint32_t parent, uint16_t priority, int programFd,
+                             const std::string& name) {
+    // tcm_info carries the filter priority and the protocol it applies to
+    uint32_t info = (static_cast<uint32_t>(priority) << 16) | htons(ETH_P_ALL);
+    size_t msg = beginMessage(RTM_NEWTFILTER, NLM_F_CREATE | NLM_F_EXCL, ifindex, parent, 0,
+                              "add bpf filter", info);
+    addAttrString(TCA_KIND, "bpf");
+
+    // Not in direct-action mode: the program's return value is the classid
+    uint32_t fd = static_cast<uint32_t>(programFd);
+    size_t options = beginNested(TCA_OPTIONS);
+    addAttr(TCA_BPF_FD, &fd, sizeof(fd));
+    addAttrString(TCA_BPF_NAME, name);
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::deleteQdisc(int ifindex, uint32_t parent) {
+    size_t msg = beginMessage(RTM_DELQDISC, 0, ifindex, parent, 0, "delete qdisc");
+    endMessage(msg);
+}
+
+void TcNetlink::addClsactQdisc(int ifindex) {
+    size_t msg = beginMessage(RTM_NEWQDISC, NLM_F_CREATE | NLM_F_EXCL, ifindex, TC_H_CLSACT,
+                              TC_H_MAKE(TC_H_CLSACT, 0), "add clsact qdisc");
+    addAttrString(TCA_KIND, "clsact");
+    endMessage(msg);
+}
+
+void TcNetlink::addRedirectFilter(int ifindex, uint32_t parent, uint16_t priority, int targetIfindex) {
+    uint32_t info = (static_cast<uint32_t>(priority) << 16) | htons(ETH_P_ALL);
+    size_t msg = beginMessage(RTM_NEWTFILTER, NLM_F_CREATE | NLM_F_EXCL, ifindex, parent, 0,
+                              "add redirect filter", info);
+    addAttrString(TCA_KIND, "matchall");
+
+    struct tc_mirred mirred;
+    memset(&mirred, 0, sizeof(mirred));
+    mirred.action = TC_ACT_STOLEN;
+    mirred.eaction = TCA_EGRESS_REDIR;
+    mirred.ifindex = static_cast<uint32_t>(targetIfindex);
+
+    // Actions are a list of nested attributes keyed by their order
+    size_t options = beginNested(TCA_OPTIONS);
+    size_t actions = beginNested(TCA_MATCHALL_ACT);
+    size_t action = beginNested(1);
+    addAttrString(TCA_ACT_KIND, "mirred");
+    size_t actionOptions = beginNested(TCA_ACT_OPTIONS);
+    addAttr(TCA_MIRRED_PARMS, &mirred, sizeof(mirred));
+    endNested(actionOptions);
+    endNested(action);
+    endNested(actions);
+    endNested(options);
+    endMessage(msg);
+}
+
+void TcNetlink::deleteFilter(int ifindex, uint32_t parent, uint16_t priority) {
+    // Handle 0 with a priority removes every filter at that priority
+    uint32_t info = static_cast<uint32_t>(priority) << 16;
+    size_t msg = beginMessage(RTM_DELTFILTER, 0, ifindex, parent, 0, "delete filter", info);
+    endMessage(msg);
+}
+
+void TcNetlink::addIfbLink(const std::string& name, const std::string& alias) {
+    size_t msg = beginLinkMessage(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, "add ifb link");
+    struct ifinfomsg* ifi = reinterpret_cast<struct ifinfomsg*>(batch_.data() + msg + NLMSG_HDRLEN);
+    ifi->ifi_flags = IFF_UP;
+    ifi->ifi_change = IFF_UP;
+
+    addAttrString(IFLA_IFNAME, name);
+    size_t linkInfo = beginNested(IFLA_LINKINFO);
+    addAttrString(IFLA_INFO_KIND, "ifb");
+    endNested(linkInfo);
+    endMessage(msg);
+
+    // The alias is ignored on creation, so set it on the new link by name
+    msg = beginLinkMessage(RTM_NEWLINK, 0, "set ifb alias");
+    addAttrString(IFLA_IFNAME, name);
+    addAttr(IFLA_IFALIAS, alias.c_str(), alias.size());
+    endMessage(msg);
+}
+
+void TcNetlink::deleteLink(const std::string& name) {
+    size_t msg = beginLinkMessage(RTM_DELLINK, 0, "delete link");
+    addAttrString(IFLA_IFNAME, name);
+    endMessage(msg);
+}
+
+void TcNetlink::discard() {
+    batch_.clear();
+    pending_.clear();
+}
+
+bool TcNetlink::commit(std::string* error) {
+    lastErrorCode_ = 0;
+    if (pending_.empty()) return true;
+
+    if (fd_ < 0 && !open()) {
+        if (error) *error = "netlink socket unavailable";
+        lastErrorCode_ = EACCES;
+        discard();
+        return false;
+    }
+
+    std::vector<Request> requests = std::move(pending_);
+    std::vector<char> batch = std::move(batch_);
+    discard();
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    struct iovec iov = { batch.data(), batch.size() };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &kernel;
+    msg.msg_namelen = sizeof(kernel);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (sendmsg(fd_, &msg, 0) < 0) {
+        lastErrorCode_ = errno;
+        if (error) *error = std::string("sendmsg: ") + strerror(errno);
+        LOGE("Failed to send netlink batch: %s", strerror(errno));
+        return false;
+    }
+
+    // Collect one ack per request; the kernel answers in order
+    size_t outstanding = requests.size();
+    bool success = true;
+    std::string firstError;
+    char buffer[16384];
+
+    while (outstanding > 0) {
+        ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            lastErrorCode_ = errno;
+            firstError = std::string("recv: ") + strerror(errno);
+            success = false;
+            break;
+        }
+
+        int len = static_cast<int>(received);
+        for (struct nlmsghdr* nh = reinterpret_cast<struct nlmsghdr*>(buffer);
+             NLMSG_OK(nh, len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type != NLMSG_ERROR) continue;
+
+            auto it = std::find_if(requests.begin(), requests.end(),
+                                   [nh](const Request& r) { return r.seq == nh->nlmsg_seq; });
+            if (it == requests.end()) continue;
+            outstanding--;
+
+            const struct nlmsgerr* err = static_cast<const struct nlmsgerr*>(NLMSG_DATA(nh));
+            if (err->error != 0) {
+                std::string text = it->description + ": " + strerror(-err->error);
+                LOGE("Netlink request failed: %s", text.c_str());
+                if (success) {
+                    firstError = text;
+                    lastErrorCode_ = -err->error;
+                }
+                success = false;
+            }
+        }
+    }
+
+    if (!success && error) {
+        *error = firstError;
+    }
+    return success;
+}
+
+// ============================================================================
+// Statistics
+// ============================================================================
+
+bool TcNetlink::dumpQdiscStats(int ifindex, std::vector<TcStats>* stats, std::string* error) {
+    return dump(RTM_GETQDISC, ifindex, stats, error);
+}
+
+bool TcNetlink::dumpClassStats(int ifindex, std::vector<TcStats>* stats, std::string* error) {
+    return dump(RTM_GETTCLASS, ifindex, stats, error);
+}
+
+static void parseStats(const struct rtattr* stats2, TcStats* out) {
+    int len = RTA_PAYLOAD(stats2);
+    for (const struct rtattr* rta = static_cast<const struct rtattr*>(RTA_DATA(stats2));
+         RTA_OK(rta, len);
+         rta = RTA_NEXT(rta, len)) {
+        size_t payload = RTA_PAYLOAD(rta);
+        if (rta->rta_type == TCA_STATS_BASIC) {
+            struct gnet_stats_basic basic;
+            memset(&basic, 0, sizeof(basic));
+            memcpy(&basic, RTA_DATA(rta), std::min(payload, sizeof(basic)));
+            out->bytes = basic.bytes;
+            if (out->packets == 0) out->packets = basic.packets;
+        } else if (rta->rta_type == TCA_STATS_PKT64 && payload >= sizeof(uint64_t)) {
+            // 32-bit packet counters wrap; newer kernels add a 64-bit one
+            memcpy(&out->packets, RTA_DATA(rta), sizeof(uint64_t));
+        } else if (rta->rta_type == TCA_STATS_QUEUE) {
+            struct gnet_stats_queue queue;
+            memset(&queue, 0, sizeof(queue));
+            memcpy(&queue, RTA_DATA(rta), std::min(payload, sizeof(queue)));
+            out->queueLength = queue.qlen;
+            out->backlogBytes = queue.backlog;
+            out->drops = queue.drops;
+            out->overlimits = queue.overlimits;
+        }
+    }
+}
+
+bool TcNetlink::dump(uint16_t type, int ifindex, std::vector<TcStats>* stats, std::string* error) {
+    stats->clear();
+    if (fd_ < 0 && !open()) {
+        if (error) *error = "netlink socket unavailable";
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr nh;
+        struct tcmsg tcm;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.nh.nlmsg_len = sizeof(request);
+    request.nh.nlmsg_type = type;
+    request.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nh.nlmsg_seq = ++seq_;
+    request.tcm.tcm_family = AF_UNSPEC;
+    request.tcm.tcm_ifindex = ifindex;
+
+    if (send(fd_, &request, sizeof(request), 0) < 0) {
+        if (error) *error = std::string("send: ") + strerror(errno);
+        return false;
+    }
+
+    // Class dumps are per device, qdisc dumps cover every device and are
+    // filtered here
+    char buffer[32768];
+    for (;;) {
+        ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (error) *error = std::string("recv: ") + strerror(errno);
+            return false;
+        }
+
+        int len = static_cast<int>(received);
+        for (struct nlmsghdr* nh = reinterpret_cast<struct nlmsghdr*>(buffer);
+             NLMSG_OK(nh, len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != request.nh.nlmsg_seq) continue;
+            if (nh->nlmsg_type == NLMSG_DONE) return true;
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr* err = static_cast<const struct nlmsgerr*>(NLMSG_DATA(nh));
+                if (err->error == 0) return true;
+                if (error) *error = std::string("dump: ") + strerror(-err->error);
+                return false;
+            }
+
+            const struct tcmsg* tcm = static_cast<const struct tcmsg*>(NLMSG_DATA(nh));
+            if (tcm->tcm_ifindex != ifindex) continue;
+
+            TcStats entry;
+            entry.handle = tcm->tcm_handle;
+            entry.parent = tcm->tcm_parent;
+
+            int attrLen = static_cast<int>(NLMSG_PAYLOAD(nh, sizeof(*tcm)));
+            for (const struct rtattr* rta = TCA_RTA(tcm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+                if (rta->rta_type == TCA_KIND) {
+                    entry.kind = static_cast<const char*>(RTA_DATA(rta));
+                } else if (rta->rta_type == TCA_STATS2) {
+                    parseStats(rta, &entry);
+                }
+            }
+            stats->push_back(entry);
+        }
+    }
+}
+
+// ============================================================================
+// Message construction
+// ============================================================================
+
+size_t TcNetlink::beginMessage(uint16_t type, uint16_t flags, int ifindex, uint32_t parent,
+                               uint32_t handle, const std::string& description, uint32_t info) {
+    size_t start = batch_.size();
+
+    struct nlmsghdr nh;
+    memset(&nh, 0, sizeof(nh));
+    nh.nlmsg_type = type;
+    nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    nh.nlmsg_seq = ++seq_;
+    appendRaw(&nh, sizeof(nh));
+
+    struct tcmsg tcm;
+    memset(&tcm, 0, sizeof(tcm));
+    tcm.tcm_family = AF_UNSPEC;
+    tcm.tcm_ifindex = ifindex;
+    tcm.tcm_parent = parent;
+    tcm.tcm_handle = handle;
+    tcm.tcm_info = info;
+    appendRaw(&tcm, sizeof(tcm));
+
+    pending_.push_back({nh.nlmsg_seq, description});
+    return start;
+}
+
+size_t TcNetlink::beginLinkMessage(uint16_t type, uint16_t flags, const std::string& description) {
+    size_t start = batch_.size();
+
+    struct nlmsghdr nh;
+    memset(&nh, 0, sizeof(nh));
+    nh.nlmsg_type = type;
+    nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    nh.nlmsg_seq = ++seq_;
+    appendRaw(&nh, sizeof(nh));
+
+    struct ifinfomsg ifi;
+    memset(&ifi, 0, sizeof(ifi));
+    ifi.ifi_family = AF_UNSPEC;
+    appendRaw(&ifi, sizeof(ifi));
+
+    pending_.push_back({nh.nlmsg_seq, description});
+    return start;
+}
+
+void TcNetlink::endMessage(size_t start) {
+    struct nlmsghdr* nh = reinterpret_cast<struct nlmsghdr*>(batch_.data() + start);
+    nh->nlmsg_len = static_cast<uint32_t>(batch_.size() - start);
+    batch_.resize(start + NLMSG_ALIGN(nh->nlmsg_len), 0);
+}
+
+void TcNetlink::addAttr(uint16_t type, const void* data, size_t length) {
+    struct rtattr rta;
+    rta.rta_type = type;
+    rta.rta_len = static_cast<unsigned short>(RTA_LENGTH(length));
+    appendRaw(&rta, sizeof(rta));
+    appendRaw(data, length);
+    batch_.resize(batch_.size() + (RTA_ALIGN(length) - length), 0);
+}
+
+void TcNetlink::addAttrString(uint16_t type, const std::string& value) {
+    addAttr(type, value.c_str(), value.size() + 1);
+}
+
+size_t TcNetlink::beginNested(uint16_t type) {
+    size_t start = batch_.size();
+    struct rtattr rta;
+    rta.rta_type = type;
+    rta.rta_len = 0;
+    appendRaw(&rta, sizeof(rta));
+    return start;
+}
+
+void TcNetlink::endNested(size_t start) {
+    batch_.resize(start + RTA_ALIGN(batch_.size() - start), 0);
+    struct rtattr* rta = reinterpret_cast<struct rtattr*>(batch_.data() + start);
+    rta->rta_len = static_cast<unsigned short>(batch_.size() - start);
+}
+
+void TcNetlink::appendRaw(const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    batch_.insert(batch_.end(), bytes, bytes + length);
+}
+
+// ============================================================================
+// psched time conversion
+// ============================================================================
+
+double TcNetlink::tickInUsec() {
+    static const double value = []() {
+        unsigned int t2us = 1, us2t = 1, clockRes = 1000000;
+        FILE* fp = fopen("/proc/net/psched", "r");
+        if (fp) {
+            if (fscanf(fp, "%08x%08x%08x", &t2us, &us2t, &clockRes) != 3) {
+                t2us = us2t = 1;
+                clockRes = 1000000;
+            }
+            fclose(fp);
+        }
+        // Kernels with ns resolution advertise a 1000x tick multiplier for old
+        // binaries; iproute2 undoes it the same way
+        if (clockRes == 1000000000) t2us = us2t;
+        double clockFactor = static_cast<double>(clockRes) / 1000000;
+        return static_cast<double>(t2us) / us2t * clockFactor;
+    }();
+    return value;
+}
+
+uint32_t TcNetlink::timeToTicks(double usec) {
+    return static_cast<uint32_t>(std::min(usec * tickInUsec(), static_cast<double>(UINT32_MAX)));
+}
+
+uint32_t TcNetlink::transmitTime(uint64_t rateBytesPerSec, uint32_t size) {
+    if (rateBytesPerSec == 0) return 0;
+    return timeToTicks(1000000.0 * size / static_cast<double>(rateBytesPerSec));
+}
+
+void TcNetlink::calcRateTable(uint64_t rateBytesPerSec, uint32_t* table, uint8_t* cellLog) {
+    uint8_t log = 0;
+    while ((2047u >> log) > 255) log++;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        table[i] = transmitTime(rateBytesPerSec, (i + 1) << log);
+    }
+    *cellLog = log;
+}
+
+// ============================================================================
+// Delay distributions
+// ============================================================================
+
+// Inverse CDF sampled at DIST_TABLE_SIZE points and scaled by
+// NETEM_DIST_SCALE; netem computes delay + table[rnd] * jitter / scale
+static std::vector<int16_t> makeNormalTable() {
+    std::vector<int16_t> table(DIST_TABLE_SIZE);
+    for (int i = 0; i < DIST_TABLE_SIZE; i++) {
+        double target = (i + 0.125) / DIST_TABLE_SIZE;
+        double lo = -10.0, hi = 10.0;
+        for (int step = 0; step < 60; step++) {
+            double mid = (lo + hi) / 2;
+            if (0.5 + 0.5 * std::erf(mid / std::sqrt(2.0)) < target) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        double value = std::rint(lo * NETEM_DIST_SCALE);
+        table[i] = static_cast<int16_t>(std::min(std::max(value, -32768.0), 32767.0));
+    }
+    return table;
+}
+
+// Pareto with shape 3, shifted to zero mean; same values as iproute2's
+// pareto.dist
+static std::vector<int16_t> makeParetoTable() {
+    std::vector<int16_t> table(DIST_TABLE_SIZE);
+    for (int i = 0; i < DIST_TABLE_SIZE; i++) {
+        double x = static_cast<double>(65536 - i * 16) / 65536;
+        double value = (1.0 / std::pow(x, 1.0 / 3.0) - 1.5) * (4.0 / 3.0) * NETEM_DIST_SCALE;
+        table[i] = static_cast<int16_t>(std::min(std::rint(value), 32767.0));
+    }
+    return table;
+}
+
+const std::vector<int16_t>* TcNetlink::distributionTable(const std::string& name) {
+    if (name == "normal") {
+        static const std::vector<int16_t> normal = makeNormalTable();
+        return &normal;
+    }
+    if (name == "pareto") {
+        static const std::vector<int16_t> pareto = makeParetoTable();
+        return &pareto;
+    }
+    return nullptr;
+}
+
+} // namespace danr
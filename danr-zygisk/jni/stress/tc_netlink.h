@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// tc handle helpers, same encoding as TC_H_MAKE
+inline uint32_t tcHandle(uint32_t major, uint32_t minor) {
+    return (major << 16) | (minor & 0xFFFF);
+}
+
+struct NetemParams {
+    long delayUs = 0;
+    long jitterUs = 0;
+    std::string distribution = "uniform";  // Jitter distribution: "uniform", "normal" or "pareto"
+    double delayCorrelation = 0;  // Percentages below are all 0-100
+    double lossPercent = 0;
+    double lossCorrelation = 0;
+    double duplicatePercent = 0;
+    double duplicateCorrelation = 0;
+    double reorderPercent = 0;    // Ignored without delay, netem needs it to reorder
+    double reorderCorrelation = 0;
+    double corruptPercent = 0;
+    double corruptCorrelation = 0;
+
+    // Gilbert-Elliott loss, replaces lossPercent when enabled
+    bool gilbertElliott = false;
+    double geGoodToBad = 0;       // p
+    double geBadToGood = 100;     // r
+    double geBadLoss = 100;       // 1-h
+    double geGoodLoss = 0;        // 1-k
+
+    uint32_t limit = 1000;        // Packets queued inside netem
+};
+
+// Counters of one qdisc or class as reported in TCA_STATS2
+struct TcStats {
+    std::string kind;
+    uint32_t handle = 0;
+    uint32_t parent = 0;
+    uint64_t bytes = 0;
+    uint64_t packets = 0;
+    uint32_t drops = 0;
+    uint32_t overlimits = 0;
+    uint32_t backlogBytes = 0;
+    uint32_t queueLength = 0;
+};
+
+// Create adds a new object and fails if it exists; Change updates an
+// existing one in place (no NLM_F_CREATE), which keeps queued packets and
+// is cheap enough to issue several times per second
+enum class TcOp {
+    Create,
+    Change
+};
+
+// Minimal rtnetlink traffic-control client. Requests are queued into a batch
+// and sent to the kernel in a single sendmsg(); commit() then collects the
+// ack or error of every message. rtnetlink has no transactions, so callers
+// that need all-or-nothing semantics delete the root qdisc when commit fails
+// (see NetworkStressor::applyTcRules).
+class TcNetlink {
+public:
+    TcNetlink();
+    ~TcNetlink();
+
+    TcNetlink(const TcNetlink&) = delete;
+    TcNetlink& operator=(const TcNetlink&) = delete;
+
+    bool open();
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    static int interfaceIndex(const std::string& name);
+    static bool isKnownDistribution(const std::string& name);
+
+    // Batch building
+    void addHtbQdisc(int ifindex, uint32_t parent, uint32_t handle, uint32_t defaultClass);
+    void addHtbClass(int ifindex, uint32_t parent, uint32_t classId,
+                     uint64_t rateBytesPerSec, uint64_t ceilBytesPerSec, TcOp op = TcOp::Create);
+    void addTbfQdisc(int ifindex, uint32_t parent, uint32_t handle,
+                     uint64_t rateBytesPerSec, long latencyUs, TcOp op = TcOp::Create);
+    void addNetemQdisc(int ifindex, uint32_t parent, uint32_t handle, const NetemParams& params,
+                       TcOp op = TcOp::Create);
+    void addBpfFilter(int ifindex, uint32_t parent, uint16_t priority, int programFd,
+                      const std::string& name);
+    void deleteQdisc(int ifindex, uint32_t parent);
+
+    // Ingress redirection: a clsact qdisc whose ingress hook carries a
+    // matchall filter with a mirred action sending every packet to another
+    // device's egress path (usually an IFB)
+    void addClsactQdisc(int ifindex);
+    void addRedirectFilter(int ifindex, uint32_t parent, uint16_t priority, int targetIfindex);
+    void deleteFilter(int ifindex, uint32_t parent, uint16_t priority);
+
+    // Links. The IFB is created administratively up; alias is stored as its
+    // ifalias so a later run can tell what the device was set up for.
+    void addIfbLink(const std::string& name, const std::string& alias);
+    void deleteLink(const std::string& name);
+
+    size_t pendingCount() const { return pending_.size(); }
+    void discard();
+
+    // Sends the batch and waits for every ack. Returns false if any message
+    // failed; error then holds the first kernel error.
+    bool commit(std::string* error = nullptr);
+
+    // errno of the first failed message of the last commit, 0 on success
+    int lastErrorCode() const { return lastErrorCode_; }
+
+    // Statistics read back from the kernel. These are dumps, sent on their
+    // own rather than as part of the batch, and must not be interleaved with
+    // batch building on the same instance.
+    bool dumpQdiscStats(int ifindex, std::vector<TcStats>* stats, std::string* error = nullptr);
+    bool dumpClassStats(int ifindex, std::vector<TcStats>* stats, std::string* error = nullptr);
+
+private:
+    int fd_ = -1;
+    uint32_t seq_ = 0;
+    int lastErrorCode_ = 0;
+
+    struct Request {
+        uint32_t seq;
+        std::string description;
+    };
+    std::vector<char> batch_;
+    std::vector<Request> pending_;
+
+    // Message construction helpers (operate on the tail of batch_)
+    size_t beginMessage(uint16_t type, uint16_t flags, int ifindex, uint32_t parent,
+                        uint32_t handle, const std::string& description, uint32_t info = 0);
+    size_t beginLinkMessage(uint16_t type, uint16_t flags, const std::string& description);
+    void endMessage(size_t start);
+    void addAttr(uint16_t type, const void* data, size_t length);
+    void addAttrString(uint16_t type, const std::string& value);
+    size_t beginNested(uint16_t type);
+    void endNested(size_t start);
+    void appendRaw(const void* data, size_t length);
+
+    bool dump(uint16_t type, int ifindex, std::vector<TcStats>* stats, std::string* error);
+
+    // psched tick conversion, mirrors iproute2's tc_core
+    static double tickInUsec();
+    static uint32_t timeToTicks(double usec);
+    static uint32_t transmitTime(uint64_t rateBytesPerSec, uint32_t size);
+    static void calcRateTable(uint64_t rateBytesPerSec, uint32_t* table, uint8_t* cellLog);
+
+    // netem delay distribution tables, same shape as iproute2's *.dist files
+    static const std::vector<int16_t>* distributionTable(const std::string& name);
+};
+
+} // namespace danr
@@ -1,8 +1,19 @@
 #include "thermal_stressor.h"
-#include <fstream>
+#include "monotonic_clock.h"
+#include "sysfs_accessor.h"
+#include "restore_journal.h"
+#include "tunable_arbiter.h"
 #include <sstream>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include <android/log.h>
 
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-ThermalStressor", __VA_ARGS__)
@@ -10,6 +21,33 @@
 
 namespace danr {
 
+static const int HEATER_PERIOD_US = 10000;
+static const double DERIVATIVE_SMOOTHING = 0.3;
+static const long CONTROL_PERIOD_MS = 1000;
+static const int EMULATION_STEP_US = 100000;
+static const int THROTTLE_POLL_US = 10000;
+static const long THROTTLE_TIMEOUT_US = 10000000;
+// Holder name towards the TunableArbiter
+static const char* ARBITER_OWNER = "thermal";
+static const size_t MEMORY_HEATER_BYTES = 16 * 1024 * 1024;  // Well past any SoC's caches
+
+static std::string formatTenths(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", value);
+    return buffer;
+}
+
+// "kHz:ms,..." skipping frequencies never visited
+static std::string formatResidency(const std::vector<std::pair<long, long>>& residency) {
+    std::string result;
+    for (const auto& entry : residency) {
+        if (entry.second <= 0) continue;
+        if (!result.empty()) result += ",";
+        result += std::to_string(entry.first) + ":" + std::to_string(entry.second);
+    }
+    return result;
+}
+
 ThermalStressor::~ThermalStressor() {
     stop();
 }
@@ -29,13 +67,72 @@ bool ThermalStressor::start(const ThermalStressConfig& config) {
         return false;
     }
 
+    // Zones are looked up even without a target, for reporting
+    zones_ = ThermalZones::zones();
+    zone_ = ThermalZones::find(zones_, config.zone);
+    if (config.targetTempC > 0 && !zone_) {
+        LOGE("No thermal zone matches '%s'", config.zone.c_str());
+        return false;
+    }
+    if (config.targetTempC > 0 && !config.emulZones.empty()) {
+        LOGE("Heating and emulation can't be combined");
+        return false;
+    }
+    coolingDevices_ = ThermalZones::coolingDevices();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        emulTempC_ = 0;
+        throttleEvents_ = 0;
+        throttleTimeouts_ = 0;
+        lastThrottleMs_ = 0;
+        totalThrottleMs_ = 0;
+        lastThrottle_.clear();
+        emulatedZoneNames_.clear();
+
+        policyPaths_ = FreqResidency::policyPaths();
+        residency_.clear();
+        for (const std::string& path : policyPaths_) {
+            residency_.emplace_back(path);
+        }
+    }
+    throttleStartUs_ = 0;
+    if (!config.emulZones.empty() && !setupEmulation(config)) {
+        return false;
+    }
+
     {
         std::lock_guard<std::mutex> lock(mutex_);
         config_ = config;
-        originalSettings_.clear();
+        temperatureC_ = 0;
+        maxTemperatureC_ = 0;
+        tripsCrossed_.clear();
+        coolingStates_.clear();
+        activeCoolingDevices_ = 0;
+    }
+    priority_ = config.priority;
+    dutyPermille_.store(0);
+    integral_ = 0;
+    derivative_ = 0;
+    havePreviousTemp_ = false;
+
+    int numCores = getNumCores();
+    totalCores_.store(numCores);
+
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+    cpus_.clear();
+    for (int cpu = 0; cpu < numCores; cpu++) {
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        cpus_.push_back({
+            sysfs.attribute(base + "/online"),
+            sysfs.attribute(base + "/cpufreq/scaling_governor"),
+            sysfs.attribute(base + "/cpufreq/cpuinfo_max_freq"),
+            sysfs.attribute(base + "/cpufreq/cpuinfo_min_freq"),
+            sysfs.attribute(base + "/cpufreq/scaling_max_freq"),
+            sysfs.attribute(base + "/cpufreq/scaling_min_freq"),
+        });
     }
 
-    totalCores_.store(getNumCores());
     setDuration(config.durationMs);
     markStarted();
 
@@ -43,6 +140,12 @@ bool ThermalStressor::start(const ThermalStressConfig& config) {
          config.maxFrequencyPercent,
          config.forceAllCoresOnline ? "true" : "false",
          config.durationMs);
+    if (!emulated_.empty()) {
+        LOGD("Emulating %zu zones over a %zu point ramp", emulated_.size(), ramp_.size());
+    }
+    if (config.targetTempC > 0) {
+        LOGD("Heating %s (%s) to %.1f C", zone_->path.c_str(), zone_->type.c_str(), config.targetTempC);
+    }
 
     workerThread_ = std::thread(&ThermalStressor::workerFunction, this);
     return true;
@@ -62,6 +165,7 @@ void ThermalStressor::stop() {
         workerThread_.join();
     }
 
+    resetEmulation();
     restoreSettings();
 
     if (wasRunning) {
@@ -78,9 +182,51 @@ void ThermalStressor::workerFunction() {
 
     // Apply CPU settings
     applySettings();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (FreqResidency& residency : residency_) {
+            residency.start();
+        }
+    }
+
+    double targetTempC;
+    int cpuHeaters;
+    int memoryHeaters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        targetTempC = config_.targetTempC;
+        cpuHeaters = config_.heatThreads > 0 ? config_.heatThreads : totalCores_.load();
+        memoryHeaters = config_.heatMemory ? std::max(1, cpuHeaters / 4) : 0;
+    }
+    if (targetTempC > 0) {
+        startHeaters(cpuHeaters, memoryHeaters);
+    }
 
-    // Monitor and maintain settings for duration
+    // Monitor and maintain settings for duration. Emulation runs at a
+    // finer step, both for ramp resolution and to time throttling.
+    long startMs = getCurrentTimeMs();
+    long lastControlMs = 0;
     while (running_.load() && getCurrentTimeMs() < endTime) {
+        long nowMs = getCurrentTimeMs();
+        if (!emulated_.empty()) {
+            updateEmulation(nowMs - startMs);
+            checkThrottle();
+        }
+
+        if (lastControlMs != 0 && nowMs - lastControlMs < CONTROL_PERIOD_MS) {
+            usleep(throttleStartUs_ != 0 ? THROTTLE_POLL_US : EMULATION_STEP_US);
+            continue;
+        }
+        controlTemperature(lastControlMs != 0 ? (nowMs - lastControlMs) / 1000.0 : 0);
+        sampleCoolingDevices();
+        lastControlMs = nowMs;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (FreqResidency& residency : residency_) {
+                residency.sample();
+            }
+        }
+
         // Re-apply settings periodically in case system changes them
         int online = 0;
         int total = totalCores_.load();
@@ -107,11 +253,15 @@ void ThermalStressor::workerFunction() {
             }
         }
 
-        usleep(1000000); // Check every second
+        if (emulated_.empty()) {
+            usleep(1000000); // Check every second
+        }
     }
 
     // Mark as stopped when duration expires naturally
     markStopped();
+    stopHeaters();
+    resetEmulation();
 
     // Restore original settings when test completes
     restoreSettings();
@@ -119,6 +269,415 @@ void ThermalStressor::workerFunction() {
     LOGD("Thermal stress worker completed");
 }
 
+bool ThermalStressor::parseRamp(const std::string& spec, std::vector<std::pair<long, double>>* ramp) {
+    ramp->clear();
+    std::istringstream points(spec);
+    std::string point;
+    while (std::getline(points, point, ',')) {
+        size_t colon = point.find(':');
+        if (colon == std::string::npos) return false;
+        char* end;
+        long timeMs = strtol(point.c_str(), &end, 10);
+        if (end != point.c_str() + colon || timeMs < 0) return false;
+        double tempC = strtod(point.c_str() + colon + 1, &end);
+        if (end == point.c_str() + colon + 1) return false;
+        ramp->push_back({ timeMs, tempC });
+    }
+    std::sort(ramp->begin(), ramp->end());
+    return !ramp->empty();
+}
+
+bool ThermalStressor::setupEmulation(const ThermalStressConfig& config) {
+    emulated_.clear();
+    curFreqs_.clear();
+
+    if (!config.emulRamp.empty()) {
+        if (!parseRamp(config.emulRamp, &ramp_)) {
+            LOGE("Invalid emulation ramp '%s', expected timeMs:tempC,...", config.emulRamp.c_str());
+            return false;
+        }
+    } else if (config.emulTempC > 0) {
+        ramp_.assign(1, { 0L, config.emulTempC });
+    } else {
+        LOGE("Emulation needs emulTempC or emulRamp");
+        return false;
+    }
+
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+    bool all = config.emulZones == "all";
+    std::vector<const ThermalZone*> selected;
+    if (all) {
+        for (const ThermalZone& zone : zones_) selected.push_back(&zone);
+    } else {
+        std::istringstream specs(config.emulZones);
+        std::string spec;
+        while (std::getline(specs, spec, ',')) {
+            const ThermalZone* zone = ThermalZones::find(zones_, spec);
+            if (!zone) {
+                LOGE("No thermal zone matches '%s'", spec.c_str());
+                return false;
+            }
+            selected.push_back(zone);
+        }
+    }
+
+    for (const ThermalZone* zone : selected) {
+        std::string path = zone->path + "/emul_temp";
+        if (access(path.c_str(), W_OK) != 0) {
+            if (all) continue;
+            LOGE("%s missing, kernel built without CONFIG_THERMAL_EMULATION?", path.c_str());
+            return false;
+        }
+        emulated_.push_back({ zone, sysfs.attribute(path), 0 });
+    }
+    if (emulated_.empty()) {
+        LOGE("No thermal zone supports emulation");
+        return false;
+    }
+
+    // One scaling_cur_freq per cluster to time the throttling response
+    for (const std::string& path : policyPaths_) {
+        curFreqs_.push_back(sysfs.attribute(path + "/scaling_cur_freq"));
+    }
+
+    if (!startResetGuard()) {
+        LOGE("Failed to start the emulation reset guard, not emulating");
+        emulated_.clear();
+        return false;
+    }
+
+    // The guard undoes emulation the moment this process dies; the journal
+    // covers the guard being killed along with it, e.g. with its cgroup.
+    // Writing 0 hands a zone back to its sensor.
+    std::vector<RestoreJournal::Entry> journal;
+    for (const EmulatedZone& emulated : emulated_) {
+        journal.push_back({ RestoreJournal::Kind::Sysfs, emulated.emulTemp->path(), "0" });
+    }
+    RestoreJournal::getInstance().record(journal);
+
+    std::string names;
+    for (const EmulatedZone& emulated : emulated_) {
+        if (!names.empty()) names += ",";
+        names += "thermal_zone" + std::to_string(emulated.zone->id);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    emulatedZoneNames_ = names;
+    return true;
+}
+
+void ThermalStressor::updateEmulation(long elapsedMs) {
+    bool loop;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop = config_.emulLoop;
+    }
+
+    long rampMs = ramp_.back().first;
+    long t = (loop && rampMs > 0) ? elapsedMs % rampMs : elapsedMs;
+    double tempC = ramp_.back().second;
+    for (size_t i = 0; i < ramp_.size(); i++) {
+        if (t <= ramp_[i].first) {
+            if (i == 0) {
+                tempC = ramp_[0].second;
+            } else {
+                const auto& a = ramp_[i - 1];
+                const auto& b = ramp_[i];
+                double fraction = static_cast<double>(t - a.first) / (b.first - a.first);
+                tempC = a.second + (b.second - a.second) * fraction;
+            }
+            break;
+        }
+    }
+    // Steps of 0.1 C keep the number of writes down on slow ramps
+    long milliC = lround(tempC * 10) * 100;
+
+    bool crossing = false;
+    for (const EmulatedZone& emulated : emulated_) {
+        if (emulated.lastMilliC == milliC) continue;
+        for (const ThermalTrip& trip : emulated.zone->trips) {
+            if (emulated.lastMilliC < trip.tempMilliC && trip.tempMilliC <= milliC) {
+                crossing = true;
+            }
+        }
+    }
+
+    // Timed from just before the write, against frequencies sampled before it
+    if (crossing && throttleStartUs_ == 0) {
+        baselineFreqs_.clear();
+        for (SysfsAttribute* freq : curFreqs_) {
+            baselineFreqs_.push_back(freq->readLong(0L));
+        }
+        throttleStartUs_ = monotonicUs();
+    }
+
+    bool changed = false;
+    for (EmulatedZone& emulated : emulated_) {
+        if (emulated.lastMilliC == milliC) continue;
+        // 0 would switch emulation off, so clamp just above it
+        emulated.emulTemp->writeLong(milliC != 0 ? milliC : 1);
+        emulated.lastMilliC = milliC;
+        changed = true;
+    }
+
+    if (changed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        emulTempC_ = milliC / 1000.0;
+    }
+}
+
+void ThermalStressor::checkThrottle() {
+    if (throttleStartUs_ == 0) return;
+
+    long elapsedUs = monotonicUs() - throttleStartUs_;
+    for (size_t i = 0; i < curFreqs_.size() && i < baselineFreqs_.size(); i++) {
+        long freq = curFreqs_[i]->readLong(0L);
+        if (freq <= 0 || freq >= baselineFreqs_[i]) continue;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string cluster = FreqResidency::policyName(policyPaths_[i]);
+        throttleEvents_++;
+        lastThrottleMs_ = elapsedUs / 1000.0;
+        totalThrottleMs_ += lastThrottleMs_;
+        lastThrottle_ = cluster + ":" + std::to_string(baselineFreqs_[i]) + "->" + std::to_string(freq);
+        LOGD("Throttled after %.1f ms: %s", lastThrottleMs_, lastThrottle_.c_str());
+        throttleStartUs_ = 0;
+        return;
+    }
+
+    if (elapsedUs > THROTTLE_TIMEOUT_US) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        throttleTimeouts_++;
+        throttleStartUs_ = 0;
+        LOGD("No frequency drop within %ld ms of the trip crossing", THROTTLE_TIMEOUT_US / 1000);
+    }
+}
+
+void ThermalStressor::resetEmulation() {
+    std::vector<RestoreJournal::Entry> released;
+    for (EmulatedZone& emulated : emulated_) {
+        emulated.emulTemp->writeLong(0);
+        released.push_back({ RestoreJournal::Kind::Sysfs, emulated.emulTemp->path(), "0" });
+    }
+    RestoreJournal::getInstance().release(released);
+    if (!emulated_.empty()) {
+        LOGD("Emulation reset on %zu zones", emulated_.size());
+    }
+    emulated_.clear();
+    throttleStartUs_ = 0;
+    stopResetGuard();
+}
+
+bool ThermalStressor::startResetGuard() {
+    // A child process blocks on a pipe only we hold the write end of; when
+    // this process exits for any reason, SIGKILL included, the read returns
+    // EOF and the child writes 0 to every emulated zone. Paths are prepared
+    // here since the child of a multithreaded process must stick to
+    // async-signal-safe calls.
+    std::vector<std::string> paths;
+    for (const EmulatedZone& emulated : emulated_) {
+        paths.push_back(emulated.emulTemp->path());
+    }
+    std::vector<const char*> pathPointers;
+    for (const std::string& path : paths) {
+        pathPointers.push_back(path.c_str());
+    }
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    if (maxFd <= 0) maxFd = 1024;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        LOGE("pipe2 failed: %s", strerror(errno));
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOGE("fork failed: %s", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        // Leave the daemon's process group so signals aimed at it don't take
+        // the guard along, and drop its descriptors: an inherited listening
+        // socket would otherwise block the daemon's restart
+        setsid();
+        signal(SIGINT, SIG_IGN);
+        signal(SIGTERM, SIG_IGN);
+        signal(SIGHUP, SIG_IGN);
+        for (long fd = 3; fd < maxFd; fd++) {
+            if (fd != fds[0]) close(static_cast<int>(fd));
+        }
+
+        char byte;
+        for (;;) {
+            ssize_t n = read(fds[0], &byte, 1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+        }
+        for (const char* path : pathPointers) {
+            int fd = open(path, O_WRONLY);
+            if (fd >= 0) {
+                ssize_t ignored = write(fd, "0", 1);
+                (void)ignored;
+                close(fd);
+            }
+        }
+        _exit(0);
+    }
+
+    close(fds[0]);
+    guardFd_ = fds[1];
+    guardPid_ = pid;
+    LOGD("Emulation reset guard running as pid %d", pid);
+    return true;
+}
+
+void ThermalStressor::stopResetGuard() {
+    if (guardFd_ >= 0) {
+        close(guardFd_);
+        guardFd_ = -1;
+    }
+    if (guardPid_ > 0) {
+        waitpid(guardPid_, nullptr, 0);
+        guardPid_ = -1;
+    }
+}
+
+void ThermalStressor::startHeaters(int cpuThreads, int memoryThreads) {
+    for (int i = 0; i < cpuThreads; i++) {
+        heaterThreads_.emplace_back(&ThermalStressor::cpuHeaterFunction, this, i);
+    }
+    for (int i = 0; i < memoryThreads; i++) {
+        heaterThreads_.emplace_back(&ThermalStressor::memoryHeaterFunction, this, i);
+    }
+    heatThreadCount_.store(cpuThreads + memoryThreads);
+    LOGD("Started %d CPU and %d memory heaters", cpuThreads, memoryThreads);
+}
+
+void ThermalStressor::stopHeaters() {
+    for (auto& thread : heaterThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    heaterThreads_.clear();
+    heatThreadCount_.store(0);
+    dutyPermille_.store(0);
+}
+
+void ThermalStressor::cpuHeaterFunction(int threadId) {
+    volatile double sink = 0.0;
+    while (running_.load()) {
+        // Busy for the duty share of each period, asleep for the rest
+        long busyUs = static_cast<long>(HEATER_PERIOD_US) * dutyPermille_.load() / 1000;
+        long busyUntilUs = monotonicUs() + busyUs;
+        while (monotonicUs() < busyUntilUs && running_.load()) {
+            double result = 0.0;
+            for (int i = 0; i < 100; i++) {
+                result += std::sqrt(static_cast<double>(i))
+                        + std::sin(static_cast<double>(i))
+                        + std::cos(static_cast<double>(i));
+            }
+            sink = sink + result;
+        }
+        if (HEATER_PERIOD_US - busyUs > 0) {
+            usleep(static_cast<useconds_t>(HEATER_PERIOD_US - busyUs));
+        }
+    }
+    LOGD("CPU heater %d stopped", threadId);
+}
+
+void ThermalStressor::memoryHeaterFunction(int threadId) {
+    // Streaming copies between two halves keep DRAM and the interconnect
+    // busy, which heats parts of the SoC the ALU loop does not
+    std::unique_ptr<char[]> buffer(new char[MEMORY_HEATER_BYTES]);
+    memset(buffer.get(), threadId + 1, MEMORY_HEATER_BYTES);
+    size_t half = MEMORY_HEATER_BYTES / 2;
+    const size_t chunk = 64 * 1024;
+
+    size_t offset = 0;
+    while (running_.load()) {
+        long busyUs = static_cast<long>(HEATER_PERIOD_US) * dutyPermille_.load() / 1000;
+        long busyUntilUs = monotonicUs() + busyUs;
+        while (monotonicUs() < busyUntilUs && running_.load()) {
+            memcpy(buffer.get() + half + offset, buffer.get() + offset, chunk);
+            offset = (offset + chunk) % half;
+        }
+        if (HEATER_PERIOD_US - busyUs > 0) {
+            usleep(static_cast<useconds_t>(HEATER_PERIOD_US - busyUs));
+        }
+    }
+}
+
+void ThermalStressor::controlTemperature(double periodSec) {
+    if (!zone_) return;
+
+    double tempC;
+    if (!ThermalZones::readTemperature(*zone_, &tempC)) return;
+
+    double targetTempC, kp, ki, kd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        temperatureC_ = tempC;
+        maxTemperatureC_ = std::max(maxTemperatureC_, tempC);
+        for (const ThermalTrip& trip : zone_->trips) {
+            if (trip.tempMilliC <= tempC * 1000) {
+                if (tripsCrossed_.insert(trip.index).second) {
+                    LOGD("%s crossed %s trip %d at %.1f C", zone_->type.c_str(),
+                         trip.type.c_str(), trip.index, trip.tempMilliC / 1000.0);
+                }
+            }
+        }
+        targetTempC = config_.targetTempC;
+        kp = config_.kp;
+        ki = config_.ki;
+        kd = config_.kd;
+    }
+    if (targetTempC <= 0 || periodSec <= 0) return;
+
+    // PID with the derivative taken on the measurement, so a target change
+    // doesn't kick, and the integral frozen while the output is pinned in
+    // the direction it would push further (anti-windup)
+    double error = targetTempC - tempC;
+    // Sensors report in 0.1-1 C steps, so the rate is smoothed before use
+    if (havePreviousTemp_) {
+        double rate = (tempC - previousTempC_) / periodSec;
+        derivative_ += DERIVATIVE_SMOOTHING * (rate - derivative_);
+    }
+    double derivative = derivative_;
+    previousTempC_ = tempC;
+    havePreviousTemp_ = true;
+
+    double candidate = integral_ + error * periodSec;
+    double output = kp * error + ki * candidate - kd * derivative;
+    if ((output < 1.0 || error < 0) && (output > 0.0 || error > 0)) {
+        integral_ = candidate;
+    }
+    output = kp * error + ki * integral_ - kd * derivative;
+    output = std::max(0.0, std::min(1.0, output));
+    dutyPermille_.store(static_cast<int>(output * 1000));
+}
+
+void ThermalStressor::sampleCoolingDevices() {
+    // Which mitigations the thermal governors have engaged, e.g.
+    // "thermal-cpufreq-4=3/16"
+    std::string states;
+    int active = 0;
+    for (const CoolingDevice& device : coolingDevices_) {
+        long state = device.curState->readLong(0L);
+        if (state <= 0) continue;
+        if (!states.empty()) states += ",";
+        states += device.type + "=" + std::to_string(state) + "/" + std::to_string(device.maxState);
+        active++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    coolingStates_ = states;
+    activeCoolingDevices_ = active;
+}
+
 void ThermalStressor::applySettings() {
     int numCores = totalCores_.load();
     bool forceAllCores;
@@ -133,30 +692,16 @@ void ThermalStressor::applySettings() {
     // Force all cores online
     if (forceAllCores) {
         for (int cpu = 1; cpu < numCores; cpu++) {  // CPU0 is always online
-            std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/online";
-            std::string original = readSysFile(path);
-            if (!original.empty()) {
-                std::lock_guard<std::mutex> lock(mutex_);
-                originalSettings_[path] = original;
-            }
             setCoreOnline(cpu, true);
         }
         LOGD("Forced all %d cores online", numCores);
     }
 
-    // Set CPU frequency for all online cores
+    // Set CPU frequency for all online cores. The arbiter keeps the values
+    // found beforehand and puts them back on restore.
     for (int cpu = 0; cpu < numCores; cpu++) {
         if (!isCoreOnline(cpu)) continue;
 
-        // Save original governor
-        std::string govPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                              "/cpufreq/scaling_governor";
-        std::string origGov = getCpuGovernor(cpu);
-        if (!origGov.empty()) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            originalSettings_[govPath] = origGov;
-        }
-
         // Set to performance governor for max frequency
         setCpuGovernor(cpu, "performance");
 
@@ -166,13 +711,6 @@ void ThermalStressor::applySettings() {
 
         if (maxFreq > 0 && maxFreqPercent < 100) {
             long targetFreq = minFreq + ((maxFreq - minFreq) * maxFreqPercent) / 100;
-
-            // Save original max frequency
-            std::string maxPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                                  "/cpufreq/scaling_max_freq";
-            std::lock_guard<std::mutex> lock(mutex_);
-            originalSettings_[maxPath] = std::to_string(maxFreq);
-
             setMaxFrequency(cpu, targetFreq);
             LOGD("CPU%d: Set max frequency to %ld kHz (%d%% of max)", cpu, targetFreq, maxFreqPercent);
         }
@@ -180,14 +718,7 @@ void ThermalStressor::applySettings() {
 }
 
 void ThermalStressor::restoreSettings() {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    for (const auto& kv : originalSettings_) {
-        writeSysFile(kv.first, kv.second);
-        LOGD("Restored %s to %s", kv.first.c_str(), kv.second.c_str());
-    }
-
-    originalSettings_.clear();
+    TunableArbiter::getInstance().releaseAll(ARBITER_OWNER);
     LOGD("All original CPU settings restored");
 }
 
@@ -212,88 +743,50 @@ int ThermalStressor::getNumCores() const {
 
 bool ThermalStressor::setCoreOnline(int cpu, bool online) {
     if (cpu == 0) return true;  // CPU0 cannot be offlined
+    if (cpu >= static_cast<int>(cpus_.size())) return false;
 
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/online";
-    return writeSysFile(path, online ? "1" : "0");
+    return TunableArbiter::getInstance().request(cpus_[static_cast<size_t>(cpu)].online->path(), ARBITER_OWNER,
+                                                 online ? "1" : "0", TunableCombine::Override, priority_);
 }
 
 bool ThermalStressor::isCoreOnline(int cpu) const {
     if (cpu == 0) return true;  // CPU0 is always online
+    if (cpu >= static_cast<int>(cpus_.size())) return false;
 
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/online";
-    std::string value = readSysFile(path);
-    return value.find("1") != std::string::npos;
+    return cpus_[static_cast<size_t>(cpu)].online->readLong(0L) == 1;
 }
 
 std::string ThermalStressor::getCpuGovernor(int cpu) const {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_governor";
-    return readSysFile(path);
+    if (cpu >= static_cast<int>(cpus_.size())) return "";
+    return cpus_[static_cast<size_t>(cpu)].governor->readString();
 }
 
 bool ThermalStressor::setCpuGovernor(int cpu, const std::string& governor) {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_governor";
-    return writeSysFile(path, governor);
+    if (cpu >= static_cast<int>(cpus_.size())) return false;
+    return TunableArbiter::getInstance().request(cpus_[static_cast<size_t>(cpu)].governor->path(), ARBITER_OWNER,
+                                                 governor, TunableCombine::Override, priority_);
 }
 
 long ThermalStressor::getMaxFrequency(int cpu) const {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/cpuinfo_max_freq";
-    std::string value = readSysFile(path);
-    return value.empty() ? 0 : std::stol(value);
+    if (cpu >= static_cast<int>(cpus_.size())) return 0;
+    return cpus_[static_cast<size_t>(cpu)].cpuinfoMaxFreq->readLong(0L);
 }
 
 long ThermalStressor::getMinFrequency(int cpu) const {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/cpuinfo_min_freq";
-    std::string value = readSysFile(path);
-    return value.empty() ? 0 : std::stol(value);
+    if (cpu >= static_cast<int>(cpus_.size())) return 0;
+    return cpus_[static_cast<size_t>(cpu)].cpuinfoMinFreq->readLong(0L);
 }
 
 bool ThermalStressor::setMaxFrequency(int cpu, long frequency) {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_max_freq";
-    return writeSysFile(path, std::to_string(frequency));
+    if (cpu >= static_cast<int>(cpus_.size())) return false;
+    return TunableArbiter::getInstance().request(cpus_[static_cast<size_t>(cpu)].scalingMaxFreq->path(),
+                                                 ARBITER_OWNER, frequency, TunableCombine::Min, priority_);
 }
 
 bool ThermalStressor::setMinFrequency(int cpu, long frequency) {
-    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
-                       "/cpufreq/scaling_min_freq";
-    return writeSysFile(path, std::to_string(frequency));
-}
-
-std::string ThermalStressor::readSysFile(const std::string& path) const {
-    std::ifstream file(path);
-    if (!file.is_open()) return "";
-
-    std::string content;
-    std::getline(file, content);
-
-    // Trim whitespace
-    size_t start = content.find_first_not_of(" \t\n\r");
-    size_t end = content.find_last_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
-
-    return content.substr(start, end - start + 1);
-}
-
-bool ThermalStressor::writeSysFile(const std::string& path, const std::string& value) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        LOGE("Failed to open %s for writing", path.c_str());
-        return false;
-    }
-
-    file << value;
-    bool success = file.good();
-    file.close();
-
-    if (!success) {
-        LOGE("Failed to write to %s", path.c_str());
-    }
-
-    return success;
+    if (cpu >= static_cast<int>(cpus_.size())) return false;
+    return TunableArbiter::getInstance().request(cpus_[static_cast<size_t>(cpu)].scalingMinFreq->path(),
+                                                 ARBITER_OWNER, frequency, TunableCombine::Max, priority_);
 }
 
 StressStatus ThermalStressor::getStatus() const {
@@ -308,6 +801,51 @@ StressStatus ThermalStressor::getStatus() const {
         status.data["onlineCores"] = std::to_string(coresOnline_.load());
         status.data["maxFrequencyPercent"] = std::to_string(config_.maxFrequencyPercent);
         status.data["forceAllCoresOnline"] = config_.forceAllCoresOnline ? "true" : "false";
+
+        if (zone_) {
+            status.data["zone"] = "thermal_zone" + std::to_string(zone_->id);
+            status.data["zoneType"] = zone_->type;
+            status.data["temperatureC"] = formatTenths(temperatureC_);
+            status.data["maxTemperatureC"] = formatTenths(maxTemperatureC_);
+
+            std::string crossed;
+            for (const ThermalTrip& trip : zone_->trips) {
+                if (!tripsCrossed_.count(trip.index)) continue;
+                if (!crossed.empty()) crossed += ",";
+                crossed += trip.type + "@" + formatTenths(trip.tempMilliC / 1000.0);
+            }
+            status.data["tripsCrossed"] = crossed;
+        }
+        if (config_.targetTempC > 0) {
+            status.data["targetTempC"] = formatTenths(config_.targetTempC);
+            status.data["heaterDutyPercent"] = formatTenths(dutyPermille_.load() / 10.0);
+            status.data["heatThreads"] = std::to_string(heatThreadCount_.load());
+        }
+        if (!config_.emulZones.empty()) {
+            status.data["emulatedZones"] = emulatedZoneNames_;
+            status.data["emulTempC"] = formatTenths(emulTempC_);
+            status.data["throttleEvents"] = std::to_string(throttleEvents_);
+            status.data["throttleTimeouts"] = std::to_string(throttleTimeouts_);
+            status.data["lastThrottleMs"] = formatTenths(lastThrottleMs_);
+            status.data["avgThrottleMs"] = formatTenths(throttleEvents_ > 0 ? totalThrottleMs_ / throttleEvents_ : 0);
+            status.data["lastThrottle"] = lastThrottle_;
+        }
+        status.data["activeCoolingDevices"] = std::to_string(activeCoolingDevices_);
+        status.data["coolingStates"] = coolingStates_;
+
+        // "<policy>.<metric>", e.g. policy4.effectiveVsCapPercent
+        for (size_t i = 0; i < residency_.size() && i < policyPaths_.size(); i++) {
+            FreqResidencyStats stats = residency_[i].stats();
+            std::string prefix = FreqResidency::policyName(policyPaths_[i]) + ".";
+            status.data[prefix + "effectiveFreq"] = std::to_string(stats.effectiveFreq);
+            status.data[prefix + "meanCapFreq"] = std::to_string(stats.meanCapFreq);
+            status.data[prefix + "effectiveVsCapPercent"] = formatTenths(stats.effectiveVsCapPercent);
+            status.data[prefix + "atCapPercent"] = formatTenths(stats.atCapPercent);
+            status.data[prefix + "residencySource"] = stats.source;
+            status.data[prefix + "transitions"] = std::to_string(stats.transitions);
+            status.data[prefix + "timeInStateMs"] = formatResidency(stats.timeInStateMs);
+            status.data[prefix + "curFreqHistogramMs"] = formatResidency(stats.curFreqHistogramMs);
+        }
     }
 
     return status;
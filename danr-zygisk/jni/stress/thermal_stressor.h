@@ -1,17 +1,43 @@
 #pragma once
 
 #include "stressor_base.h"
+#include "thermal_zones.h"
+#include "freq_residency.h"
+#include <set>
 #include <thread>
+#include <utility>
+#include <sys/types.h>
 #include <string>
-#include <map>
+#include <vector>
 
 namespace danr {
 
+class SysfsAttribute;
+
 struct ThermalStressConfig {
     bool disableThermalThrottling = false;  // Try to disable thermal daemon
     int maxFrequencyPercent = 100;          // Lock CPU freq to percentage of max
     bool forceAllCoresOnline = true;        // Prevent core hotplugging
     long durationMs = 300000;               // 5 minutes default
+    int priority = 0;                       // Against other controllers' settings (TunableArbiter)
+
+    // Closed-loop heating: drive load until the zone reaches and holds this
+    // temperature. 0 = off (only the governor/frequency/core settings apply)
+    double targetTempC = 0;
+    std::string zone;                       // thermal_zoneN, id or type; empty = skin sensor
+    int heatThreads = 0;                    // 0 = one per core
+    bool heatMemory = false;                // Add memory-bandwidth heaters (DRAM, SoC fabric)
+    double kp = 0.15;                       // Duty per degree of error
+    double ki = 0.01;                       // Duty per degree-second
+    double kd = 0.5;                        // Duty per degree/second of rise (on measurement)
+
+    // Emulation: make the kernel read these zones as a given temperature
+    // through emul_temp (CONFIG_THERMAL_EMULATION), which trips the thermal
+    // governors deterministically and without heat. Exclusive with heating.
+    std::string emulZones;                  // Comma-separated zone specs or "all"; empty = off
+    double emulTempC = 0;                   // Constant temperature when there is no ramp
+    std::string emulRamp;                   // "timeMs:tempC,...", linearly interpolated
+    bool emulLoop = false;                  // Restart the ramp when it ends
 };
 
 class ThermalStressor : public StressorBase {
@@ -30,10 +56,86 @@ public:
 private:
     ThermalStressConfig config_;
     std::thread workerThread_;
-    std::map<std::string, std::string> originalSettings_;
+    int priority_ = 0;      // Set on start, read by the worker
     std::atomic<int> coresOnline_{0};
     std::atomic<int> totalCores_{0};
 
+    // Looked up once per start, so the monitor loop builds no paths
+    struct CpuAttributes {
+        SysfsAttribute* online;
+        SysfsAttribute* governor;
+        SysfsAttribute* cpuinfoMaxFreq;
+        SysfsAttribute* cpuinfoMinFreq;
+        SysfsAttribute* scalingMaxFreq;
+        SysfsAttribute* scalingMinFreq;
+    };
+    std::vector<CpuAttributes> cpus_;
+
+    // Temperature control, owned by the worker after start
+    std::vector<ThermalZone> zones_;
+    const ThermalZone* zone_ = nullptr;
+    std::vector<CoolingDevice> coolingDevices_;
+    std::vector<std::thread> heaterThreads_;
+    std::atomic<int> dutyPermille_{0};
+    std::atomic<int> heatThreadCount_{0};
+    double integral_ = 0;
+    double derivative_ = 0;
+    double previousTempC_ = 0;
+    bool havePreviousTemp_ = false;
+
+    // Shared with getStatus
+    double temperatureC_ = 0;
+    double maxTemperatureC_ = 0;
+    std::set<int> tripsCrossed_;
+    std::string coolingStates_;
+    int activeCoolingDevices_ = 0;
+
+    // Where each cpufreq policy actually ran, sampled every control period
+    // from the point the settings are applied. Shared with getStatus.
+    std::vector<std::string> policyPaths_;
+    std::vector<FreqResidency> residency_;
+
+    // Emulation, owned by the worker after start
+    struct EmulatedZone {
+        const ThermalZone* zone;
+        SysfsAttribute* emulTemp;
+        long lastMilliC;
+    };
+    std::vector<EmulatedZone> emulated_;
+    std::vector<std::pair<long, double>> ramp_;    // (timeMs, tempC)
+    pid_t guardPid_ = -1;
+    int guardFd_ = -1;
+
+    // Throttle response: time from an emulated trip crossing until a
+    // cluster's scaling_cur_freq drops below what it was before the write
+    std::vector<SysfsAttribute*> curFreqs_;
+    std::vector<long> baselineFreqs_;
+    long throttleStartUs_ = 0;
+
+    // Shared with getStatus
+    double emulTempC_ = 0;
+    long throttleEvents_ = 0;
+    long throttleTimeouts_ = 0;
+    double lastThrottleMs_ = 0;
+    double totalThrottleMs_ = 0;
+    std::string lastThrottle_;
+    std::string emulatedZoneNames_;
+
+    bool setupEmulation(const ThermalStressConfig& config);
+    void updateEmulation(long elapsedMs);
+    void checkThrottle();
+    void resetEmulation();
+    bool startResetGuard();
+    void stopResetGuard();
+    static bool parseRamp(const std::string& spec, std::vector<std::pair<long, double>>* ramp);
+
+    void startHeaters(int cpuThreads, int memoryThreads);
+    void stopHeaters();
+    void cpuHeaterFunction(int threadId);
+    void memoryHeaterFunction(int threadId);
+    void controlTemperature(double periodSec);
+    void sampleCoolingDevices();
+
     void workerFunction();
     void applySettings();
     void restoreSettings();
@@ -50,10 +152,6 @@ private:
     long getMinFrequency(int cpu) const;
     bool setMaxFrequency(int cpu, long frequency);
     bool setMinFrequency(int cpu, long frequency);
-
-    // File helpers
-    std::string readSysFile(const std::string& path) const;
-    bool writeSysFile(const std::string& path, const std::string& value);
 };
 
 } // namespace danr
@@ -0,0 +1,134 @@
+#include "thermal_zones.h"
+#include "sysfs_accessor.h"
+#include <dirent.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-ThermalZones", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-ThermalZones", __VA_ARGS__)
+
+namespace danr {
+
+static const char* THERMAL_CLASS = "/sys/class/thermal";
+
+// Type names vendors use for the case/skin sensor, which is what "the
+// device feels hot" refers to
+static const char* SKIN_TYPES[] = { "skin", "shell", "quiet-therm", "back-therm" };
+
+static std::vector<int> listIds(const char* prefix) {
+    std::vector<int> ids;
+    DIR* dir = opendir(THERMAL_CLASS);
+    if (!dir) return ids;
+
+    size_t prefixLength = strlen(prefix);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncmp(entry->d_name, prefix, prefixLength) != 0) continue;
+        char* endptr;
+        long id = strtol(entry->d_name + prefixLength, &endptr, 10);
+        if (*endptr == '\0' && endptr != entry->d_name + prefixLength && id >= 0) {
+            ids.push_back(static_cast<int>(id));
+        }
+    }
+    closedir(dir);
+
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+std::vector<ThermalZone> ThermalZones::zones() {
+    std::vector<ThermalZone> result;
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+
+    for (int id : listIds("thermal_zone")) {
+        ThermalZone zone;
+        zone.id = id;
+        zone.path = std::string(THERMAL_CLASS) + "/thermal_zone" + std::to_string(id);
+        zone.type = SysfsAccessor::readFile(zone.path + "/type");
+        zone.temp = sysfs.attribute(zone.path + "/temp");
+
+        for (int trip = 0;; trip++) {
+            std::string prefix = zone.path + "/trip_point_" + std::to_string(trip);
+            std::string temp = SysfsAccessor::readFile(prefix + "_temp");
+            if (temp.empty()) break;
+
+            ThermalTrip entry;
+            entry.index = trip;
+            entry.tempMilliC = strtol(temp.c_str(), nullptr, 10);
+            entry.type = SysfsAccessor::readFile(prefix + "_type");
+            // Disabled trips are parked at absurd values
+            if (entry.tempMilliC > 0 && entry.tempMilliC < 200000) {
+                zone.trips.push_back(entry);
+            }
+        }
+        std::sort(zone.trips.begin(), zone.trips.end(), [](const ThermalTrip& a, const ThermalTrip& b) {
+            return a.tempMilliC < b.tempMilliC;
+        });
+
+        result.push_back(zone);
+    }
+    return result;
+}
+
+std::vector<CoolingDevice> ThermalZones::coolingDevices() {
+    std::vector<CoolingDevice> result;
+    SysfsAccessor& sysfs = SysfsAccessor::getInstance();
+
+    for (int id : listIds("cooling_device")) {
+        std::string path = std::string(THERMAL_CLASS) + "/cooling_device" + std::to_string(id);
+        CoolingDevice device;
+        device.id = id;
+        device.type = SysfsAccessor::readFile(path + "/type");
+        device.curState = sysfs.attribute(path + "/cur_state");
+        device.maxState = strtol(SysfsAccessor::readFile(path + "/max_state").c_str(), nullptr, 10);
+        result.push_back(device);
+    }
+    return result;
+}
+
+const ThermalZone* ThermalZones::find(const std::vector<ThermalZone>& zones, const std::string& spec) {
+    if (zones.empty()) return nullptr;
+
+    if (spec.empty()) {
+        for (const char* skin : SKIN_TYPES) {
+            for (const ThermalZone& zone : zones) {
+                if (zone.type.find(skin) != std::string::npos) return &zone;
+            }
+        }
+        for (const ThermalZone& zone : zones) {
+            if (zone.type.find("cpu") != std::string::npos) return &zone;
+        }
+        return &zones.front();
+    }
+
+    std::string idText = spec.compare(0, 12, "thermal_zone") == 0 ? spec.substr(12) : spec;
+    char* endptr;
+    long id = strtol(idText.c_str(), &endptr, 10);
+    if (!idText.empty() && *endptr == '\0') {
+        for (const ThermalZone& zone : zones) {
+            if (zone.id == id) return &zone;
+        }
+        return nullptr;
+    }
+
+    for (const ThermalZone& zone : zones) {
+        if (zone.type == spec) return &zone;
+    }
+    for (const ThermalZone& zone : zones) {
+        if (zone.type.find(spec) != std::string::npos) return &zone;
+    }
+    return nullptr;
+}
+
+bool ThermalZones::readTemperature(const ThermalZone& zone, double* celsius) {
+    long value;
+    if (!zone.temp->readLong(&value)) return false;
+
+    // The ABI is millidegrees, but a few vendor drivers report degrees
+    *celsius = (value > 1000 || value < -1000) ? value / 1000.0 : static_cast<double>(value);
+    return true;
+}
+
+} // namespace danr
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace danr {
+
+class SysfsAttribute;
+
+struct ThermalTrip {
+    int index;
+    long tempMilliC;
+    std::string type;    // passive, active, hot, critical
+};
+
+struct ThermalZone {
+    int id;
+    std::string path;    // /sys/class/thermal/thermal_zoneN
+    std::string type;    // e.g. skin-therm, battery, cpu-1-0-usr
+    SysfsAttribute* temp;
+    std::vector<ThermalTrip> trips;    // Sorted by temperature
+};
+
+struct CoolingDevice {
+    int id;
+    std::string type;    // e.g. thermal-cpufreq-0, battery, fan
+    SysfsAttribute* curState;
+    long maxState;
+};
+
+// Thermal framework view from /sys/class/thermal: zones with their trip
+// points, and the cooling devices the governors step when trips are hit.
+class ThermalZones {
+public:
+    static std::vector<ThermalZone> zones();
+    static std::vector<CoolingDevice> coolingDevices();
+
+    // spec is "thermal_zoneN", a zone id, or a type; an exact type match
+    // wins over a substring. An empty spec picks a skin sensor if there is
+    // one, else the first CPU zone, else the first zone.
+    static const ThermalZone* find(const std::vector<ThermalZone>& zones, const std::string& spec);
+
+    static bool readTemperature(const ThermalZone& zone, double* celsius);
+};
+
+} // namespace danr
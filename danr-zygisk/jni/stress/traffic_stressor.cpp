@@ -0,0 +1,634 @@
+#include "traffic_stressor.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-TrafficStressor", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-TrafficStressor", __VA_ARGS__)
+
+namespace danr {
+
+static const int SOCKET_TIMEOUT_MS = 200;          // Bounds how long stop() waits on a blocked call
+static const int SOCKET_BUFFER_BYTES = 4 * 1024 * 1024;
+static const size_t TCP_READ_BUFFER = 256 * 1024;
+static const int MAX_BATCH = 1024;
+
+static bool parseAddress(const std::string& address, int port,
+                         struct sockaddr_storage* out, socklen_t* length) {
+    memset(out, 0, sizeof(*out));
+
+    struct sockaddr_in* v4 = reinterpret_cast<struct sockaddr_in*>(out);
+    if (inet_pton(AF_INET, address.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(static_cast<uint16_t>(port));
+        *length = sizeof(*v4);
+        return true;
+    }
+
+    struct sockaddr_in6* v6 = reinterpret_cast<struct sockaddr_in6*>(out);
+    if (inet_pton(AF_INET6, address.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(static_cast<uint16_t>(port));
+        *length = sizeof(*v6);
+        return true;
+    }
+    return false;
+}
+
+static int portOf(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &length) < 0) return 0;
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port);
+}
+
+static void setSocketTimeouts(int fd) {
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = SOCKET_TIMEOUT_MS * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// Larger buffers than the sysctl default; the FORCE variants need root but
+// are allowed to exceed rmem_max/wmem_max
+static void setSocketBuffers(int fd) {
+    int size = SOCKET_BUFFER_BYTES;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+}
+
+static std::string formatGbps(long bitsPerSec) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", bitsPerSec / 1e9);
+    return buffer;
+}
+
+static std::string formatPermille(int permille) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", permille / 10.0);
+    return buffer;
+}
+
+TrafficStressor::~TrafficStressor() {
+    stop();
+}
+
+void TrafficStressor::setConfig(const TrafficStressConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+bool TrafficStressor::start() {
+    return start(config_);
+}
+
+bool TrafficStressor::start(const TrafficStressConfig& config) {
+    if (isRunning()) {
+        LOGD("Traffic stress test already running");
+        return false;
+    }
+
+    // Threads of a run that ended on its own are still waiting to be joined
+    stop();
+
+    if (config.protocol != "udp" && config.protocol != "tcp") {
+        LOGE("Unknown protocol: %s", config.protocol.c_str());
+        return false;
+    }
+
+    if (config.flowCount < 1 || config.packetSize < 1 || config.batchSize < 1) {
+        LOGE("flowCount, packetSize and batchSize must be positive");
+        return false;
+    }
+
+    if (config.protocol == "udp" && config.packetSize > 65507) {
+        LOGE("UDP packet size %d exceeds the datagram limit", config.packetSize);
+        return false;
+    }
+
+    TrafficStressConfig effective = config;
+    effective.batchSize = std::min(config.batchSize, MAX_BATCH);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = effective;
+    }
+
+    txBytes_.store(0);
+    txPackets_.store(0);
+    rxBytes_.store(0);
+    rxPackets_.store(0);
+    sendErrors_.store(0);
+    idleOpen_.store(0);
+    txPps_.store(0);
+    rxPps_.store(0);
+    txBitsPerSec_.store(0);
+    rxBitsPerSec_.store(0);
+    softirqPermille_.store(0);
+    maxCpuSoftirqPermille_.store(0);
+
+    RateLimits limits;
+    limits.writeBytesPerSec = static_cast<long>(effective.rateMbps) * 1000000 / 8;
+    limiter_.configure(limits);
+
+    // running_ has to be set before the sink threads start
+    setDuration(effective.durationMs);
+    markStarted();
+
+    if (!setupSink(effective)) {
+        markStopped();
+        shutdownAll();
+        return false;
+    }
+
+    LOGD("Starting traffic stress: %s, %d flows, %d byte packets, %d Mbps, batch %d for %ld ms",
+         effective.protocol.c_str(), effective.flowCount, effective.packetSize,
+         effective.rateMbps, effective.batchSize, effective.durationMs);
+
+    for (int i = 0; i < effective.flowCount; i++) {
+        senderThreads_.emplace_back(&TrafficStressor::senderFunction, this, i);
+    }
+
+    if (effective.idleConnections > 0) {
+        openIdleConnections(effective.idleConnections);
+    }
+
+    monitorThread_ = std::thread(&TrafficStressor::monitorFunction, this);
+    return true;
+}
+
+void TrafficStressor::stop() {
+    bool wasRunning = isRunning();
+
+    if (wasRunning) {
+        LOGD("Stopping traffic stress test");
+        markStopped();
+    }
+
+    // Always try to join and cleanup, even if already stopped
+    // (handles case where duration expired naturally)
+    if (monitorThread_.joinable()) {
+        monitorThread_.join();
+    }
+    shutdownAll();
+
+    if (wasRunning) {
+        LOGD("Traffic stress test stopped");
+    }
+}
+
+void TrafficStressor::shutdownAll() {
+    // Every blocking call has a timeout, so the threads notice running_
+    for (auto& thread : senderThreads_) {
+        if (thread.joinable()) thread.join();
+    }
+    senderThreads_.clear();
+
+    for (auto& thread : sinkThreads_) {
+        if (thread.joinable()) thread.join();
+    }
+    sinkThreads_.clear();
+
+    for (int fd : idleFds_) close(fd);
+    idleFds_.clear();
+    idleOpen_.store(0);
+
+    for (int fd : sinkFds_) close(fd);
+    sinkFds_.clear();
+}
+
+// ============================================================================
+// Sink
+// ============================================================================
+
+bool TrafficStressor::setupSink(const TrafficStressConfig& config) {
+    bool needTcp = config.protocol == "tcp" || config.idleConnections > 0;
+    bool needUdp = config.protocol == "udp";
+
+    if (!parseAddress(config.sinkAddress, config.sinkPort, &udpSink_, &sinkLength_)) {
+        LOGE("Invalid sink address: %s", config.sinkAddress.c_str());
+        return false;
+    }
+    tcpSink_ = udpSink_;
+
+    if (!config.useBuiltinSink) {
+        if (config.sinkPort <= 0) {
+            LOGE("An external sink needs sinkPort");
+            return false;
+        }
+        return true;
+    }
+
+    if (needUdp) {
+        // One SO_REUSEPORT socket per flow; the kernel spreads the flows
+        // across them so receiving scales like sending
+        int port = config.sinkPort;
+        for (int i = 0; i < config.flowCount; i++) {
+            int fd = openUdpSink(config, port);
+            if (fd < 0) return false;
+            sinkFds_.push_back(fd);
+            port = portOf(fd);
+            sinkThreads_.emplace_back(&TrafficStressor::udpSinkFunction, this, fd);
+        }
+        parseAddress(config.sinkAddress, port, &udpSink_, &sinkLength_);
+        LOGD("UDP sink listening on %s port %d", config.sinkAddress.c_str(), port);
+    }
+
+    if (needTcp) {
+        int fd = openTcpSink(config, config.sinkPort);
+        if (fd < 0) return false;
+        sinkFds_.push_back(fd);
+        int port = portOf(fd);
+        parseAddress(config.sinkAddress, port, &tcpSink_, &sinkLength_);
+        sinkThreads_.emplace_back(&TrafficStressor::tcpSinkFunction, this, fd);
+        LOGD("TCP sink listening on %s port %d", config.sinkAddress.c_str(), port);
+    }
+
+    return true;
+}
+
+int TrafficStressor::openUdpSink(const TrafficStressConfig& config, int port) {
+    struct sockaddr_storage addr;
+    socklen_t length;
+    parseAddress(config.sinkAddress, port, &addr, &length);
+
+    int fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("Failed to create UDP sink socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    setSocketBuffers(fd);
+    setSocketTimeouts(fd);
+
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), length) < 0) {
+        LOGE("Failed to bind UDP sink to port %d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int TrafficStressor::openTcpSink(const TrafficStressConfig& config, int port) {
+    struct sockaddr_storage addr;
+    socklen_t length;
+    parseAddress(config.sinkAddress, port, &addr, &length);
+
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("Failed to create TCP sink socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), length) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        LOGE("Failed to listen for TCP on port %d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void TrafficStressor::udpSinkFunction(int fd) {
+    int batch;
+    int packetSize;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch = config_.batchSize;
+        packetSize = config_.packetSize;
+    }
+
+    // Every message gets its own slot; the payload itself is discarded
+    std::vector<char> buffer(static_cast<size_t>(batch) * packetSize);
+    std::vector<struct iovec> iov(batch);
+    std::vector<struct mmsghdr> msgs(batch);
+    for (int i = 0; i < batch; i++) {
+        iov[i].iov_base = buffer.data() + static_cast<size_t>(i) * packetSize;
+        iov[i].iov_len = packetSize;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (running_.load()) {
+        // MSG_WAITFORONE: block (up to SO_RCVTIMEO) for the first datagram
+        // only, then take whatever else is already queued
+        int received = recvmmsg(fd, msgs.data(), batch, MSG_WAITFORONE, nullptr);
+        if (received <= 0) continue;
+
+        long bytes = 0;
+        for (int i = 0; i < received; i++) {
+            bytes += msgs[i].msg_len;
+        }
+        rxPackets_ += received;
+        rxBytes_ += bytes;
+    }
+}
+
+void TrafficStressor::tcpSinkFunction(int listenFd) {
+    int packetSize;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        packetSize = config_.packetSize;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        LOGE("epoll_create1 failed: %s", strerror(errno));
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    std::vector<int> connections;
+    std::vector<char> buffer(TCP_READ_BUFFER);
+    struct epoll_event events[64];
+    long partial = 0;
+
+    while (running_.load()) {
+        int ready = epoll_wait(epollFd, events, 64, SOCKET_TIMEOUT_MS);
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listenFd) {
+                int conn;
+                while ((conn = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    ev.events = EPOLLIN;
+                    ev.data.fd = conn;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, conn, &ev);
+                    connections.push_back(conn);
+                }
+                continue;
+            }
+
+            // Drain until EAGAIN so one busy flow cannot starve the others
+            // for longer than a buffer's worth of reads
+            for (;;) {
+                ssize_t n = read(fd, buffer.data(), buffer.size());
+                if (n > 0) {
+                    rxBytes_ += n;
+                    partial += n;
+                    rxPackets_ += partial / packetSize;
+                    partial %= packetSize;
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EINTR)) break;
+
+                // Closed by the sender or failed
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                connections.erase(std::remove(connections.begin(), connections.end(), fd),
+                                  connections.end());
+                break;
+            }
+        }
+    }
+
+    for (int fd : connections) close(fd);
+    close(epollFd);
+}
+
+// ============================================================================
+// Senders
+// ============================================================================
+
+void TrafficStressor::senderFunction(int flowId) {
+    TrafficStressConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+    }
+    bool tcp = config.protocol == "tcp";
+    const struct sockaddr_storage& sink = tcp ? tcpSink_ : udpSink_;
+
+    int fd = socket(sink.ss_family, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("Flow %d: failed to create socket: %s", flowId, strerror(errno));
+        return;
+    }
+    setSocketBuffers(fd);
+    setSocketTimeouts(fd);
+
+    if (connect(fd, reinterpret_cast<const struct sockaddr*>(&sink), sinkLength_) < 0) {
+        LOGE("Flow %d: failed to connect to sink: %s", flowId, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    size_t batchBytes = static_cast<size_t>(config.batchSize) * config.packetSize;
+    std::vector<char> buffer(tcp ? batchBytes : static_cast<size_t>(config.packetSize));
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = static_cast<char>(i * 31 + flowId);
+    }
+
+    // UDP: every message of the batch points at the same payload
+    struct iovec iov;
+    iov.iov_base = buffer.data();
+    iov.iov_len = config.packetSize;
+    std::vector<struct mmsghdr> msgs(config.batchSize);
+    for (auto& msg : msgs) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_hdr.msg_iov = &iov;
+        msg.msg_hdr.msg_iovlen = 1;
+    }
+
+    while (running_.load()) {
+        limiter_.acquire(RateLimiter::Op::Write, batchBytes);
+        if (!running_.load()) break;
+
+        if (tcp) {
+            ssize_t sent = send(fd, buffer.data(), batchBytes, MSG_NOSIGNAL);
+            if (sent > 0) {
+                txBytes_ += sent;
+                txPackets_ += sent / config.packetSize;
+            } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+                sendErrors_++;
+                LOGE("Flow %d: send failed: %s", flowId, strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        int sent = sendmmsg(fd, msgs.data(), config.batchSize, 0);
+        if (sent > 0) {
+            txPackets_ += sent;
+            txBytes_ += static_cast<long>(sent) * config.packetSize;
+        } else {
+            // ENOBUFS/ECONNREFUSED are expected under overload; back off briefly
+            sendErrors_++;
+            usleep(1000);
+        }
+    }
+
+    close(fd);
+}
+
+void TrafficStressor::openIdleConnections(int count) {
+    // Each connection costs two descriptors with the built-in sink
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    for (int i = 0; i < count && running_.load(); i++) {
+        int fd = socket(tcpSink_.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            LOGE("Stopped at %d idle connections: %s", i, strerror(errno));
+            break;
+        }
+        setSocketTimeouts(fd);
+        if (connect(fd, reinterpret_cast<const struct sockaddr*>(&tcpSink_), sinkLength_) < 0) {
+            LOGE("Stopped at %d idle connections: %s", i, strerror(errno));
+            close(fd);
+            break;
+        }
+        idleFds_.push_back(fd);
+        idleOpen_++;
+    }
+
+    LOGD("Holding %d idle connections", idleOpen_.load());
+}
+
+// ============================================================================
+// Monitoring
+// ============================================================================
+
+std::vector<TrafficStressor::CpuTimes> TrafficStressor::readCpuTimes() {
+    std::vector<CpuTimes> result;
+    std::ifstream file("/proc/stat");
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.compare(0, 3, "cpu") != 0) break;
+
+        std::istringstream fields(line);
+        std::string label;
+        fields >> label;
+
+        // user nice system idle iowait irq softirq steal
+        long long values[8] = {0};
+        for (int i = 0; i < 8 && fields >> values[i]; i++) {}
+
+        CpuTimes times;
+        for (long long value : values) times.total += value;
+        times.softirq = values[6];
+        result.push_back(times);
+    }
+    return result;
+}
+
+void TrafficStressor::monitorFunction() {
+    long endTime;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        endTime = startTimeMs_.load() + durationMs_.load();
+    }
+
+    std::vector<CpuTimes> lastCpu = readCpuTimes();
+    long lastTx = 0, lastTxPackets = 0, lastRx = 0, lastRxPackets = 0;
+    long lastSampleMs = getCurrentTimeMs();
+
+    while (running_.load() && getCurrentTimeMs() < endTime) {
+        long remaining = endTime - getCurrentTimeMs();
+        usleep(static_cast<useconds_t>(std::max(std::min(remaining, 1000L), 1L)) * 1000);
+
+        long now = getCurrentTimeMs();
+        double seconds = std::max(now - lastSampleMs, 1L) / 1000.0;
+        lastSampleMs = now;
+
+        long tx = txBytes_.load(), txPackets = txPackets_.load();
+        long rx = rxBytes_.load(), rxPackets = rxPackets_.load();
+        txBitsPerSec_.store(static_cast<long>((tx - lastTx) * 8 / seconds));
+        rxBitsPerSec_.store(static_cast<long>((rx - lastRx) * 8 / seconds));
+        txPps_.store(static_cast<long>((txPackets - lastTxPackets) / seconds));
+        rxPps_.store(static_cast<long>((rxPackets - lastRxPackets) / seconds));
+        lastTx = tx;
+        lastTxPackets = txPackets;
+        lastRx = rx;
+        lastRxPackets = rxPackets;
+
+        // Line 0 is the aggregate, the rest are single CPUs. Network softirq
+        // work tends to pile up on a few cores, so report the busiest too.
+        std::vector<CpuTimes> cpu = readCpuTimes();
+        if (!cpu.empty() && cpu.size() == lastCpu.size()) {
+            int maxPermille = 0;
+            for (size_t i = 0; i < cpu.size(); i++) {
+                long long total = cpu[i].total - lastCpu[i].total;
+                long long softirq = cpu[i].softirq - lastCpu[i].softirq;
+                int permille = total > 0 ? static_cast<int>(softirq * 1000 / total) : 0;
+                if (i == 0) {
+                    softirqPermille_.store(permille);
+                } else {
+                    maxPermille = std::max(maxPermille, permille);
+                }
+            }
+            maxCpuSoftirqPermille_.store(maxPermille);
+        }
+        lastCpu = cpu;
+    }
+
+    // Mark as stopped when duration expires naturally
+    markStopped();
+    LOGD("Traffic stress monitor completed: sent %ld bytes, received %ld bytes",
+         txBytes_.load(), rxBytes_.load());
+}
+
+StressStatus TrafficStressor::getStatus() const {
+    StressStatus status;
+    status.type = "traffic";
+    status.isRunning = isRunning();
+    status.remainingTimeMs = getRemainingTimeMs();
+
+    if (status.isRunning) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        status.data["protocol"] = config_.protocol;
+        status.data["flowCount"] = std::to_string(config_.flowCount);
+        status.data["packetSize"] = std::to_string(config_.packetSize);
+        status.data["batchSize"] = std::to_string(config_.batchSize);
+        status.data["targetMbps"] = std::to_string(config_.rateMbps);
+        status.data["sink"] = config_.useBuiltinSink ? "builtin" : config_.sinkAddress;
+        status.data["txPps"] = std::to_string(txPps_.load());
+        status.data["rxPps"] = std::to_string(rxPps_.load());
+        status.data["txGbps"] = formatGbps(txBitsPerSec_.load());
+        status.data["rxGbps"] = formatGbps(rxBitsPerSec_.load());
+        status.data["txBytes"] = std::to_string(txBytes_.load());
+        status.data["rxBytes"] = std::to_string(rxBytes_.load());
+        status.data["sendErrors"] = std::to_string(sendErrors_.load());
+        status.data["idleConnections"] = std::to_string(idleOpen_.load());
+        status.data["softirqPercent"] = formatPermille(softirqPermille_.load());
+        status.data["maxCpuSoftirqPercent"] = formatPermille(maxCpuSoftirqPermille_.load());
+    }
+
+    return status;
+}
+
+} // namespace danr
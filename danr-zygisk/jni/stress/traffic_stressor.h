@@ -0,0 +1,92 @@
+#pragma once
+
+#include "stressor_base.h"
+#include "rate_limiter.h"
+#include <thread>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+namespace danr {
+
+struct TrafficStressConfig {
+    std::string protocol = "udp";  // "udp" or "tcp"
+    int flowCount = 4;             // Sender threads, one socket each
+    int packetSize = 1200;         // UDP payload or TCP write size in bytes
+    int rateMbps = 0;              // Aggregate send budget, 0 = as fast as possible
+    int batchSize = 32;            // Messages per sendmmsg/recvmmsg call
+    long durationMs = 300000;      // 5 minutes default
+
+    // The built-in sink listens on sinkAddress; without it traffic goes to
+    // an existing endpoint at sinkAddress:sinkPort (e.g. a discard service)
+    bool useBuiltinSink = true;
+    std::string sinkAddress = "127.0.0.1";
+    int sinkPort = 0;              // 0 = any free port for the built-in sink
+
+    int idleConnections = 0;       // Extra TCP connections held open without traffic
+};
+
+// Generates network load that competes for the stack itself: socket
+// buffers, softirq processing and, with many idle connections, kernel
+// memory and file descriptors. Unlike NetworkStressor it does not degrade a
+// link; both can run together to load a shaped path.
+class TrafficStressor : public StressorBase {
+public:
+    TrafficStressor() = default;
+    ~TrafficStressor() override;
+
+    bool start() override;
+    bool start(const TrafficStressConfig& config);
+    void stop() override;
+    StressStatus getStatus() const override;
+    std::string getType() const override { return "traffic"; }
+
+    void setConfig(const TrafficStressConfig& config);
+
+private:
+    TrafficStressConfig config_;
+    std::thread monitorThread_;
+    std::vector<std::thread> senderThreads_;
+    std::vector<std::thread> sinkThreads_;
+    std::vector<int> sinkFds_;
+    std::vector<int> idleFds_;
+    RateLimiter limiter_;
+
+    struct sockaddr_storage udpSink_;
+    struct sockaddr_storage tcpSink_;
+    socklen_t sinkLength_ = 0;
+
+    std::atomic<long> txBytes_{0};
+    std::atomic<long> txPackets_{0};
+    std::atomic<long> rxBytes_{0};
+    std::atomic<long> rxPackets_{0};
+    std::atomic<long> sendErrors_{0};
+    std::atomic<int> idleOpen_{0};
+
+    // Sampled once per second by the monitor
+    std::atomic<long> txPps_{0};
+    std::atomic<long> rxPps_{0};
+    std::atomic<long> txBitsPerSec_{0};
+    std::atomic<long> rxBitsPerSec_{0};
+    std::atomic<int> softirqPermille_{0};
+    std::atomic<int> maxCpuSoftirqPermille_{0};
+
+    bool setupSink(const TrafficStressConfig& config);
+    int openUdpSink(const TrafficStressConfig& config, int port);
+    int openTcpSink(const TrafficStressConfig& config, int port);
+    void udpSinkFunction(int fd);
+    void tcpSinkFunction(int listenFd);
+    void senderFunction(int flowId);
+    void monitorFunction();
+    void openIdleConnections(int count);
+    void shutdownAll();
+
+    // Softirq share of CPU time from /proc/stat, per "cpu" line
+    struct CpuTimes {
+        long long total = 0;
+        long long softirq = 0;
+    };
+    static std::vector<CpuTimes> readCpuTimes();
+};
+
+} // namespace danr
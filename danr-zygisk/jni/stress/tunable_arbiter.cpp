@@ -0,0 +1,274 @@
+#include "tunable_arbiter.h"
+#include "sysfs_accessor.h"
+#include "restore_journal.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-TunableArbiter", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-TunableArbiter", __VA_ARGS__)
+
+namespace danr {
+
+static const char* combineName(TunableCombine combine) {
+    switch (combine) {
+        case TunableCombine::Min: return "min";
+        case TunableCombine::Max: return "max";
+        default: return "override";
+    }
+}
+
+static bool parseLong(const std::string& value, long* result) {
+    char* end;
+    *result = strtol(value.c_str(), &end, 10);
+    return end != value.c_str() && *end == '\0';
+}
+
+TunableArbiter& TunableArbiter::getInstance() {
+    static TunableArbiter instance;
+    return instance;
+}
+
+std::string TunableArbiter::canonicalPath(const std::string& path) {
+    auto it = canonicalPaths_.find(path);
+    if (it != canonicalPaths_.end()) return it->second;
+
+    char resolved[PATH_MAX];
+    std::string canonical = realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+    canonicalPaths_[path] = canonical;
+    return canonical;
+}
+
+std::string TunableArbiter::combineValue(const Tunable& tunable) {
+    int topPriority = INT_MIN;
+    for (const Holder& holder : tunable.holders) {
+        if (holder.priority > topPriority) topPriority = holder.priority;
+    }
+
+    const Holder* chosen = nullptr;
+    long chosenValue = 0;
+    for (const Holder& holder : tunable.holders) {
+        if (holder.priority != topPriority) continue;
+        if (!chosen) {
+            chosen = &holder;
+            parseLong(holder.value, &chosenValue);
+            continue;
+        }
+
+        long value;
+        bool numeric = parseLong(holder.value, &value);
+        bool better;
+        if (tunable.combine == TunableCombine::Min && numeric) {
+            better = value < chosenValue;
+        } else if (tunable.combine == TunableCombine::Max && numeric) {
+            better = value > chosenValue;
+        } else {
+            better = holder.sequence > chosen->sequence;
+        }
+        if (better) {
+            chosen = &holder;
+            chosenValue = value;
+        }
+    }
+    return chosen ? chosen->value : tunable.baseline;
+}
+
+bool TunableArbiter::apply(Tunable& tunable) {
+    tunable.effective = combineValue(tunable);
+
+    // Writing the value a tunable already has isn't always free: a
+    // governor write restarts the governor
+    std::string current = tunable.attribute->readString();
+    if (current == tunable.effective) return true;
+    return tunable.attribute->write(tunable.effective);
+}
+
+bool TunableArbiter::request(const std::string& path, const std::string& owner, const std::string& value,
+                             TunableCombine combine, int priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = canonicalPath(path);
+
+    auto it = tunables_.find(key);
+    if (it == tunables_.end()) {
+        Tunable tunable;
+        tunable.path = key;
+        tunable.attribute = SysfsAccessor::getInstance().attribute(key);
+        tunable.combine = combine;
+        if (!tunable.attribute->readString(&tunable.baseline)) {
+            LOGE("Can't read %s, not changing it", key.c_str());
+            return false;
+        }
+
+        // Journaled before the first write, so a crash can't lose it
+        RestoreJournal::getInstance().recordSysfs(key, tunable.baseline);
+        it = tunables_.emplace(key, tunable).first;
+        LOGD("Holding %s, baseline %s", key.c_str(), tunable.baseline.c_str());
+    } else if (it->second.combine != combine) {
+        LOGE("%s requested as %s, but is arbitrated as %s", key.c_str(), combineName(combine),
+             combineName(it->second.combine));
+    }
+
+    Tunable& tunable = it->second;
+    Holder* holder = nullptr;
+    for (Holder& candidate : tunable.holders) {
+        if (candidate.owner == owner) holder = &candidate;
+    }
+    bool existed = holder != nullptr;
+    if (!holder) {
+        tunable.holders.push_back({ owner, "", 0, 0 });
+        holder = &tunable.holders.back();
+    }
+    Holder previous = *holder;
+    holder->value = value;
+    holder->priority = priority;
+    holder->sequence = ++sequence_;
+
+    if (!apply(tunable)) {
+        // Callers treat false as not holding and never release, so the
+        // constraint is taken back rather than left pinning the tunable
+        LOGE("%s couldn't set %s = %s, dropping the request", owner.c_str(), key.c_str(),
+             tunable.effective.c_str());
+        if (existed) {
+            *holder = previous;
+        } else {
+            tunable.holders.pop_back();
+        }
+        if (tunable.holders.empty()) {
+            RestoreJournal::getInstance().releaseSysfs(key);
+            tunables_.erase(it);
+        } else {
+            apply(tunable);
+        }
+        return false;
+    }
+
+    if (tunable.effective != value) {
+        LOGD("%s asked for %s = %s, holding %s", owner.c_str(), key.c_str(), value.c_str(),
+             tunable.effective.c_str());
+    }
+    return true;
+}
+
+bool TunableArbiter::request(const std::string& path, const std::string& owner, long value,
+                             TunableCombine combine, int priority) {
+    return request(path, owner, std::to_string(value), combine, priority);
+}
+
+bool TunableArbiter::releaseLocked(const std::string& key, const std::string& owner) {
+    auto it = tunables_.find(key);
+    if (it == tunables_.end()) return true;
+
+    Tunable& tunable = it->second;
+    size_t before = tunable.holders.size();
+    for (auto holder = tunable.holders.begin(); holder != tunable.holders.end(); ++holder) {
+        if (holder->owner == owner) {
+            tunable.holders.erase(holder);
+            break;
+        }
+    }
+    if (tunable.holders.size() == before) return true;
+
+    if (!tunable.holders.empty()) {
+        return apply(tunable);
+    }
+
+    bool success = tunable.attribute->write(tunable.baseline);
+    LOGD("Released %s, restored %s", key.c_str(), tunable.baseline.c_str());
+    RestoreJournal::getInstance().releaseSysfs(key);
+    tunables_.erase(it);
+    return success;
+}
+
+bool TunableArbiter::release(const std::string& path, const std::string& owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = canonicalPath(path);
+    return releaseLocked(key, owner);
+}
+
+void TunableArbiter::releaseAll(const std::string& owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Undone in reverse order of the requests, so e.g. a core forced online
+    // first goes back offline only after its frequency settings are back
+    std::vector<std::pair<long, std::string>> keys;
+    for (const auto& kv : tunables_) {
+        for (const Holder& holder : kv.second.holders) {
+            if (holder.owner == owner) keys.push_back({ holder.sequence, kv.first });
+        }
+    }
+    std::sort(keys.rbegin(), keys.rend());
+    for (const auto& key : keys) {
+        releaseLocked(key.second, owner);
+    }
+}
+
+std::string TunableArbiter::effective(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = canonicalPath(path);
+    auto it = tunables_.find(key);
+    return it != tunables_.end() ? it->second.effective : std::string();
+}
+
+long TunableArbiter::effectiveLong(const std::string& path, long defaultValue) {
+    long value;
+    return parseLong(effective(path), &value) ? value : defaultValue;
+}
+
+bool TunableArbiter::enforce(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = canonicalPath(path);
+    auto it = tunables_.find(key);
+    if (it == tunables_.end()) return false;
+
+    Tunable& tunable = it->second;
+    if (tunable.attribute->readString() == tunable.effective) return false;
+    tunable.attribute->write(tunable.effective);
+    return true;
+}
+
+std::vector<TunableStatus> TunableArbiter::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TunableStatus> result;
+    for (const auto& kv : tunables_) {
+        const Tunable& tunable = kv.second;
+        TunableStatus status;
+        status.path = tunable.path;
+        status.combine = combineName(tunable.combine);
+        status.baseline = tunable.baseline;
+        status.effective = tunable.effective;
+        for (const Holder& holder : tunable.holders) {
+            status.holders.push_back({ holder.owner, holder.value, holder.priority });
+        }
+        result.push_back(status);
+    }
+    return result;
+}
+
+std::string TunableArbiter::toJson() {
+    std::ostringstream ss;
+    ss << "{\"tunables\":[";
+    std::vector<TunableStatus> tunables = getStatus();
+    for (size_t i = 0; i < tunables.size(); i++) {
+        const TunableStatus& tunable = tunables[i];
+        if (i > 0) ss << ",";
+        ss << "{";
+        ss << "\"path\":\"" << tunable.path << "\",";
+        ss << "\"combine\":\"" << tunable.combine << "\",";
+        ss << "\"baseline\":\"" << tunable.baseline << "\",";
+        ss << "\"effective\":\"" << tunable.effective << "\",";
+        ss << "\"holders\":[";
+        for (size_t j = 0; j < tunable.holders.size(); j++) {
+            const TunableHolderStatus& holder = tunable.holders[j];
+            if (j > 0) ss << ",";
+            ss << "{\"owner\":\"" << holder.owner << "\",\"value\":\"" << holder.value
+               << "\",\"priority\":" << holder.priority << "}";
+        }
+        ss << "]}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+} // namespace danr
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace danr {
+
+class SysfsAttribute;
+
+// How the constraints of several holders of one tunable combine. Only the
+// holders at the highest priority take part; lower ones wait underneath
+// and take effect again once the higher ones release.
+enum class TunableCombine {
+    Min,         // Caps, e.g. scaling_max_freq: the lowest wins
+    Max,         // Floors, e.g. scaling_min_freq: the highest wins
+    Override     // Anything else: the most recent request wins
+};
+
+struct TunableHolderStatus {
+    std::string owner;
+    std::string value;
+    int priority;
+};
+
+struct TunableStatus {
+    std::string path;          // Canonical (symlinks resolved)
+    std::string combine;       // "min", "max" or "override"
+    std::string baseline;      // Restored when the last holder releases
+    std::string effective;
+    std::vector<TunableHolderStatus> holders;
+};
+
+// Single writer for tunables several controllers may want to change at
+// once (CPUFreqManager and ThermalStressor both cap scaling_max_freq).
+// Controllers request constraints instead of writing; the arbiter writes
+// the combined value, saves the value it found as the baseline (journaled,
+// see RestoreJournal) and writes that back when the last holder releases.
+// Paths are keyed by realpath, so cpu0/cpufreq/X and policy0/X are one
+// tunable.
+class TunableArbiter {
+public:
+    static TunableArbiter& getInstance();
+
+    // Adds or replaces owner's constraint and writes the resulting value.
+    // Returns false if the tunable can't be read or the write fails; the
+    // request is then dropped, and any constraint owner had before stays.
+    bool request(const std::string& path, const std::string& owner, const std::string& value,
+                 TunableCombine combine, int priority = 0);
+    bool request(const std::string& path, const std::string& owner, long value,
+                 TunableCombine combine, int priority = 0);
+
+    // Drops owner's constraint; without holders the baseline goes back
+    bool release(const std::string& path, const std::string& owner);
+    void releaseAll(const std::string& owner);
+
+    // Value the arbiter holds the tunable at, empty if nobody holds it
+    std::string effective(const std::string& path);
+    long effectiveLong(const std::string& path, long defaultValue);
+
+    // Rewrites the effective value if something else changed the file.
+    // Returns true if it had to.
+    bool enforce(const std::string& path);
+
+    std::vector<TunableStatus> getStatus();
+    std::string toJson();
+
+private:
+    TunableArbiter() = default;
+    TunableArbiter(const TunableArbiter&) = delete;
+    TunableArbiter& operator=(const TunableArbiter&) = delete;
+
+    struct Holder {
+        std::string owner;
+        std::string value;
+        int priority;
+        long sequence;     // Request order, for Override
+    };
+
+    struct Tunable {
+        std::string path;
+        SysfsAttribute* attribute;
+        TunableCombine combine;
+        std::string baseline;
+        std::string effective;
+        std::vector<Holder> holders;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Tunable> tunables_;
+    std::map<std::string, std::string> canonicalPaths_;    // realpath cache
+    long sequence_ = 0;
+
+    std::string canonicalPath(const std::string& path);
+    static std::string combineValue(const Tunable& tunable);
+    bool apply(Tunable& tunable);
+    bool releaseLocked(const std::string& key, const std::string& owner);
+};
+
+} // namespace danr
@@ -0,0 +1,87 @@
+#include "uid_classifier.h"
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "DANR-UidClassifier", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "DANR-UidClassifier", __VA_ARGS__)
+
+namespace danr {
+
+static struct bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    struct bpf_insn i;
+    memset(&i, 0, sizeof(i));
+    i.code = code;
+    i.dst_reg = dst;
+    i.src_reg = src;
+    i.off = off;
+    i.imm = imm;
+    return i;
+}
+
+int loadUidClassifier(uint16_t qdiscMajor, std::string* error) {
+    // Hand-assembled so the build does not need a BPF toolchain:
+    //   r0 = bpf_get_socket_uid(skb)     overflowuid when there is no socket
+    //   r0 = (u32)r0 % PER_USER_RANGE
+    //   if r0 > 0xffff: return 0          no match, falls to the default class
+    //   return (qdiscMajor << 16) | r0
+    const struct bpf_insn program[] = {
+        insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_get_socket_uid),
+        insn(BPF_ALU | BPF_MOD | BPF_K, BPF_REG_0, 0, 0, PER_USER_RANGE),
+        insn(BPF_JMP | BPF_JGT | BPF_K, BPF_REG_0, 0, 2, 0xFFFF),
+        insn(BPF_ALU | BPF_OR | BPF_K, BPF_REG_0, 0, 0, static_cast<int32_t>(qdiscMajor) << 16),
+        insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, 0),
+        insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+
+    static const char license[] = "Apache 2.0";
+    char log[4096];
+    log[0] = '\0';
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SCHED_CLS;
+    attr.insns = reinterpret_cast<uint64_t>(program);
+    attr.insn_cnt = sizeof(program) / sizeof(program[0]);
+    attr.license = reinterpret_cast<uint64_t>(license);
+    attr.log_buf = reinterpret_cast<uint64_t>(log);
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+
+    int fd = static_cast<int>(syscall(__NR_bpf, BPF_PROG_LOAD, &attr, sizeof(attr)));
+    if (fd < 0) {
+        std::string text = std::string("bpf prog load: ") + strerror(errno);
+        if (log[0] != '\0') {
+            text += " (" + std::string(log) + ")";
+        }
+        LOGE("%s", text.c_str());
+        if (error) *error = text;
+        return -1;
+    }
+
+    LOGD("Loaded uid classifier for qdisc %x: (fd %d)", qdiscMajor, fd);
+    return fd;
+}
+
+int packageUid(const std::string& packageName) {
+    // Format: <package> <uid> <debuggable> <dataDir> <seinfo> <gids>
+    std::ifstream file("/data/system/packages.list");
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        int uid = -1;
+        if (fields >> name >> uid && name == packageName) {
+            return uid;
+        }
+    }
+    return -1;
+}
+
+} // namespace danr
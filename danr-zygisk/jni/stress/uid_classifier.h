@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace danr {
+
+// Android gives every user its own range of 100000 uids; the app id is the
+// part that identifies the package across users
+static const int PER_USER_RANGE = 100000;
+
+inline int appIdOf(int uid) {
+    return uid % PER_USER_RANGE;
+}
+
+// Loads a cls_bpf program that classifies each packet by the uid of its
+// socket: it returns classid <qdiscMajor>:<appId>. HTB sends packets whose
+// class does not exist to its default class, so only apps that were given a
+// class are shaped. Returns the program fd, or -1 with error set.
+int loadUidClassifier(uint16_t qdiscMajor, std::string* error);
+
+// Looks the uid of an installed package up in /data/system/packages.list.
+// Returns -1 if the package is unknown.
+int packageUid(const std::string& packageName);
+
+} // namespace danr
@@ -0,0 +1,103 @@
+// Replays journals left behind by a process that died:
+// - with a cpuset child and its parent both narrowed. CpusetLimiter records
+//   (and narrows) children before their parent, so the parent has to be
+//   widened first: a v1 kernel rejects a child mask wider than its parent's.
+// - in the middle of appending a record. The torn record's change was never
+//   made, so its truncated value must not be written back.
+
+#include "stress/restore_journal.h"
+#include "stress/sysfs_accessor.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using danr::RestoreJournal;
+using danr::SysfsAccessor;
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static const std::string dir = DANR_JOURNAL_DIR;
+static const std::string journalPath = dir + "/restore.journal";
+
+static void testNewestFirst() {
+    const std::string parent = dir + "/top-app";
+    const std::string child = parent + "/child";
+    mkdir(parent.c_str(), 0700);
+    mkdir(child.c_str(), 0700);
+    unlink(journalPath.c_str());
+
+    // Sysfs files exist already; writeFile doesn't create them
+    std::ofstream(parent + "/cpus") << "0-7";
+    std::ofstream(child + "/cpus") << "0-7";
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        RestoreJournal& journal = RestoreJournal::getInstance();
+        journal.recordSysfs(child + "/cpus", "0-7");
+        SysfsAccessor::writeFile(child + "/cpus", "0-3");
+        journal.recordSysfs(parent + "/cpus", "0-7");
+        SysfsAccessor::writeFile(parent + "/cpus", "0-3");
+        _exit(0);   // Dies holding both, nothing released
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    std::ifstream file(journalPath);
+    std::vector<RestoreJournal::Entry> pending = RestoreJournal::pendingEntries(file);
+    file.close();
+    CHECK(pending.size() == 2);
+    if (pending.size() == 2) {
+        CHECK(pending[0].target == parent + "/cpus");
+        CHECK(pending[1].target == child + "/cpus");
+    }
+
+    CHECK(RestoreJournal::getInstance().replay() == 2);
+    CHECK(SysfsAccessor::readFile(parent + "/cpus") == "0-7");
+    CHECK(SysfsAccessor::readFile(child + "/cpus") == "0-7");
+    CHECK(RestoreJournal::getInstance().replay() == 0);
+}
+
+static void testTornRecord() {
+    const std::string capped = dir + "/scaling_max_freq";
+    const std::string torn = dir + "/scaling_min_freq";
+    std::ofstream(capped) << "1017600";
+    std::ofstream(torn) << "300000";
+
+    // The second append was cut off after two digits of its value
+    std::ofstream(journalPath) << "+\tsysfs\t" << capped << "\t2841600\n"
+                               << "+\tsysfs\t" << torn << "\t28";
+
+    std::ifstream file(journalPath);
+    std::vector<RestoreJournal::Entry> pending = RestoreJournal::pendingEntries(file);
+    file.close();
+    CHECK(pending.size() == 1);
+    if (pending.size() == 1) {
+        CHECK(pending[0].target == capped);
+    }
+
+    CHECK(RestoreJournal::getInstance().replay() == 1);
+    CHECK(SysfsAccessor::readFile(capped) == "2841600");
+    CHECK(SysfsAccessor::readFile(torn) == "300000");
+}
+
+int main() {
+    mkdir(dir.c_str(), 0700);
+    testNewestFirst();
+    testTornRecord();
+
+    if (failures == 0) printf("restore_journal_test: OK\n");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -17,7 +17,13 @@
 #include <android/log.h>
 
 #include "stress/stress_manager.h"
+#include "stress/restore_journal.h"
+#include "stress/tunable_arbiter.h"
 #include "cpu_freq_manager.h"
+#include "governor_tuner.h"
+#include "cpuset_limiter.h"
+#include "cpuidle_controller.h"
+#include "device_profile.h"
 
 #define PORT 8765
 #define BUFFER_SIZE 8192
@@ -299,6 +305,20 @@ long parse_json_long(const std::string& json, const std::string& key, long defau
     return atol(json.c_str() + valueStart);
 }
 
+double parse_json_double(const std::string& json, const std::string& key, double defaultVal) {
+    std::string searchKey = "\"" + key + "\"";
+    size_t keyPos = json.find(searchKey);
+    if (keyPos == std::string::npos) return defaultVal;
+
+    size_t colonPos = json.find(':', keyPos);
+    if (colonPos == std::string::npos) return defaultVal;
+
+    size_t valueStart = colonPos + 1;
+    while (valueStart < json.size() && isspace(json[valueStart])) valueStart++;
+
+    return atof(json.c_str() + valueStart);
+}
+
 bool parse_json_bool(const std::string& json, const std::string& key, bool defaultVal) {
     std::string searchKey = "\"" + key + "\"";
     size_t keyPos = json.find(searchKey);
@@ -330,6 +350,46 @@ std::string parse_json_string(const std::string& json, const std::string& key, c
     return json.substr(startQuote + 1, endQuote - startQuote - 1);
 }
 
+// Extracts the objects of an array-of-objects value and removes the whole
+// key from json, so the flat parsers above cannot pick up nested keys
+std::vector<std::string> take_json_object_array(std::string& json, const std::string& key) {
+    std::vector<std::string> result;
+    std::string searchKey = "\"" + key + "\"";
+    size_t keyPos = json.find(searchKey);
+    if (keyPos == std::string::npos) return result;
+
+    size_t colonPos = json.find(':', keyPos);
+    if (colonPos == std::string::npos) return result;
+
+    size_t bracketStart = json.find('[', colonPos);
+    if (bracketStart == std::string::npos) return result;
+
+    int depth = 0;
+    bool inString = false;
+    size_t objectStart = 0;
+    size_t pos = bracketStart + 1;
+    for (; pos < json.size(); pos++) {
+        char c = json[pos];
+        if (inString) {
+            if (c == '\\') pos++;
+            else if (c == '"') inString = false;
+            continue;
+        }
+        if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            if (depth++ == 0) objectStart = pos;
+        } else if (c == '}') {
+            if (--depth == 0) result.push_back(json.substr(objectStart, pos - objectStart + 1));
+        } else if (c == ']' && depth == 0) {
+            break;
+        }
+    }
+
+    json.erase(keyPos, std::min(pos + 1, json.size()) - keyPos);
+    return result;
+}
+
 // ============================================================================
 // Stress API Handlers
 // ============================================================================
@@ -361,6 +421,7 @@ void handle_stress_cpu_stop(int client_socket) {
 void handle_stress_memory_start(int client_socket, const std::string& body) {
     danr::MemoryStressConfig config;
     config.targetFreeMB = parse_json_int(body, "targetFreeMB", 100);
+    config.holdMB = parse_json_int(body, "holdMB", 0);
     config.chunkSizeMB = parse_json_int(body, "chunkSizeMB", 10);
     config.durationMs = parse_json_long(body, "durationMs", 300000);
     config.useAnonymousMmap = parse_json_bool(body, "useAnonymousMmap", true);
@@ -381,10 +442,30 @@ void handle_stress_memory_stop(int client_socket) {
 void handle_stress_disk_start(int client_socket, const std::string& body) {
     danr::DiskStressConfig config;
     config.throughputMBps = parse_json_int(body, "throughputMBps", 5);
+    config.readKBps = parse_json_int(body, "readKBps", 0);
+    config.writeKBps = parse_json_int(body, "writeKBps", 0);
+    config.readIops = parse_json_int(body, "readIops", 0);
+    config.writeIops = parse_json_int(body, "writeIops", 0);
+    config.workerCount = parse_json_int(body, "workerCount", 1);
     config.chunkSizeKB = parse_json_int(body, "chunkSizeKB", 100);
     config.durationMs = parse_json_long(body, "durationMs", 300000);
     config.useDirectIO = parse_json_bool(body, "useDirectIO", false);
     config.syncWrites = parse_json_bool(body, "syncWrites", false);
+    config.syncMode = parse_json_string(body, "syncMode", "none");
+    config.mode = parse_json_string(body, "mode", "mixed");
+    config.fileCount = parse_json_int(body, "fileCount", 4);
+    config.fileSizeMB = parse_json_int(body, "fileSizeMB", 64);
+    config.readPercent = parse_json_int(body, "readPercent", 50);
+    config.metadataFileCount = parse_json_int(body, "metadataFileCount", 2000);
+    config.metadataDirCount = parse_json_int(body, "metadataDirCount", 16);
+    config.metadataFileSizeKB = parse_json_int(body, "metadataFileSizeKB", 4);
+    config.dirtySetMB = parse_json_int(body, "dirtySetMB", 256);
+    config.dirtyRatio = parse_json_int(body, "dirtyRatio", -1);
+    config.dirtyBackgroundRatio = parse_json_int(body, "dirtyBackgroundRatio", -1);
+    config.latencyProbe = parse_json_bool(body, "latencyProbe", false);
+    config.probeIntervalMs = parse_json_int(body, "probeIntervalMs", 100);
+    config.verify = parse_json_bool(body, "verify", false);
+    config.seed = parse_json_long(body, "seed", 0);
 
     std::string testPath = parse_json_string(body, "testPath", "/data/local/tmp/danr_stress");
     if (!testPath.empty()) {
@@ -394,7 +475,7 @@ void handle_stress_disk_start(int client_socket, const std::string& body) {
     if (danr::StressManager::getInstance().startDiskStress(config)) {
         send_json(client_socket, "{\"success\":true,\"message\":\"Disk stress test started\"}");
     } else {
-        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to start disk stress test (may already be running)\"}");
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to start disk stress test (already running, or invalid chunkSizeKB or fileSizeMB?)\"}");
     }
 }
 
@@ -403,14 +484,57 @@ void handle_stress_disk_stop(int client_socket) {
     send_json(client_socket, "{\"success\":true,\"message\":\"Disk stress test stopped\"}");
 }
 
-void handle_stress_network_start(int client_socket, const std::string& body) {
+void handle_stress_network_start(int client_socket, const std::string& request) {
     danr::NetworkStressConfig config;
+
+    std::string body = request;
+    for (const std::string& app : take_json_object_array(body, "apps")) {
+        danr::NetworkAppConfig appConfig;
+        appConfig.packageName = parse_json_string(app, "packageName", "");
+        appConfig.uid = parse_json_int(app, "uid", -1);
+        appConfig.bandwidthLimitKbps = parse_json_int(app, "bandwidthLimitKbps", -1);
+        appConfig.latencyMs = parse_json_int(app, "latencyMs", -1);
+        appConfig.jitterMs = parse_json_int(app, "jitterMs", -1);
+        appConfig.packetLossPercent = parse_json_int(app, "packetLossPercent", -1);
+        appConfig.profile = parse_json_string(app, "profile", "");
+        config.apps.push_back(appConfig);
+    }
+
     config.bandwidthLimitKbps = parse_json_int(body, "bandwidthLimitKbps", 0);
+    config.shaper = parse_json_string(body, "shaper", "htb");
     config.latencyMs = parse_json_int(body, "latencyMs", 0);
     config.packetLossPercent = parse_json_int(body, "packetLossPercent", 0);
     config.durationMs = parse_json_long(body, "durationMs", 300000);
-
-    std::string iface = parse_json_string(body, "targetInterface", "wlan0");
+    config.jitterMs = parse_json_int(body, "jitterMs", 0);
+    config.delayDistribution = parse_json_string(body, "delayDistribution", "uniform");
+    config.delayCorrelationPercent = parse_json_double(body, "delayCorrelationPercent", 0);
+    config.lossCorrelationPercent = parse_json_double(body, "lossCorrelationPercent", 0);
+    config.duplicatePercent = parse_json_double(body, "duplicatePercent", 0);
+    config.reorderPercent = parse_json_double(body, "reorderPercent", 0);
+    config.corruptPercent = parse_json_double(body, "corruptPercent", 0);
+    config.lossModel = parse_json_string(body, "lossModel", "random");
+    config.geGoodToBadPercent = parse_json_double(body, "geGoodToBadPercent", 1);
+    config.geBadToGoodPercent = parse_json_double(body, "geBadToGoodPercent", 30);
+    config.geBadLossPercent = parse_json_double(body, "geBadLossPercent", 100);
+    config.geGoodLossPercent = parse_json_double(body, "geGoodLossPercent", 0);
+    config.profile = parse_json_string(body, "profile", "");
+    config.profilePath = parse_json_string(body, "profilePath", "");
+    config.profileLoop = parse_json_bool(body, "profileLoop", true);
+    config.profileUpdateMs = parse_json_int(body, "profileUpdateMs", 250);
+    config.shapeEgress = parse_json_bool(body, "shapeEgress", true);
+    config.shapeIngress = parse_json_bool(body, "shapeIngress", false);
+    config.downlinkBandwidthLimitKbps = parse_json_int(body, "downlinkBandwidthLimitKbps", -1);
+    config.downlinkLatencyMs = parse_json_int(body, "downlinkLatencyMs", -1);
+    config.downlinkJitterMs = parse_json_int(body, "downlinkJitterMs", -1);
+    config.downlinkPacketLossPercent = parse_json_int(body, "downlinkPacketLossPercent", -1);
+    config.downlinkProfile = parse_json_string(body, "downlinkProfile", "");
+    config.probe = parse_json_bool(body, "probe", false);
+    config.probeTarget = parse_json_string(body, "probeTarget", "");
+    config.probePort = parse_json_int(body, "probePort", 0);
+    config.probeIntervalMs = parse_json_int(body, "probeIntervalMs", 1000);
+    config.probeApp = parse_json_string(body, "probeApp", "");
+
+    std::string iface = parse_json_string(body, "targetInterface", "auto");
     if (!iface.empty()) {
         config.targetInterface = iface;
     }
@@ -418,7 +542,7 @@ void handle_stress_network_start(int client_socket, const std::string& body) {
     if (danr::StressManager::getInstance().startNetworkStress(config)) {
         send_json(client_socket, "{\"success\":true,\"message\":\"Network stress test started\"}");
     } else {
-        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to start network stress test (requires root and tc command)\"}");
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to start network stress test (requires root and an existing interface)\"}");
     }
 }
 
@@ -427,12 +551,49 @@ void handle_stress_network_stop(int client_socket) {
     send_json(client_socket, "{\"success\":true,\"message\":\"Network stress test stopped\"}");
 }
 
+void handle_stress_traffic_start(int client_socket, const std::string& body) {
+    danr::TrafficStressConfig config;
+    config.protocol = parse_json_string(body, "protocol", "udp");
+    config.flowCount = parse_json_int(body, "flowCount", 4);
+    config.packetSize = parse_json_int(body, "packetSize", 1200);
+    config.rateMbps = parse_json_int(body, "rateMbps", 0);
+    config.batchSize = parse_json_int(body, "batchSize", 32);
+    config.durationMs = parse_json_long(body, "durationMs", 300000);
+    config.useBuiltinSink = parse_json_bool(body, "useBuiltinSink", true);
+    config.sinkAddress = parse_json_string(body, "sinkAddress", "127.0.0.1");
+    config.sinkPort = parse_json_int(body, "sinkPort", 0);
+    config.idleConnections = parse_json_int(body, "idleConnections", 0);
+
+    if (danr::StressManager::getInstance().startTrafficStress(config)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Traffic stress test started\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to start traffic stress test (may already be running or the sink could not be opened)\"}");
+    }
+}
+
+void handle_stress_traffic_stop(int client_socket) {
+    danr::StressManager::getInstance().stopTrafficStress();
+    send_json(client_socket, "{\"success\":true,\"message\":\"Traffic stress test stopped\"}");
+}
+
 void handle_stress_thermal_start(int client_socket, const std::string& body) {
     danr::ThermalStressConfig config;
     config.disableThermalThrottling = parse_json_bool(body, "disableThermalThrottling", false);
     config.maxFrequencyPercent = parse_json_int(body, "maxFrequencyPercent", 100);
+    config.priority = parse_json_int(body, "priority", 0);
     config.forceAllCoresOnline = parse_json_bool(body, "forceAllCoresOnline", true);
     config.durationMs = parse_json_long(body, "durationMs", 300000);
+    config.targetTempC = parse_json_double(body, "targetTempC", 0);
+    config.zone = parse_json_string(body, "zone", "");
+    config.heatThreads = parse_json_int(body, "heatThreads", 0);
+    config.heatMemory = parse_json_bool(body, "heatMemory", false);
+    config.kp = parse_json_double(body, "kp", config.kp);
+    config.ki = parse_json_double(body, "ki", config.ki);
+    config.kd = parse_json_double(body, "kd", config.kd);
+    config.emulZones = parse_json_string(body, "emulZones", "");
+    config.emulTempC = parse_json_double(body, "emulTempC", 0);
+    config.emulRamp = parse_json_string(body, "emulRamp", "");
+    config.emulLoop = parse_json_bool(body, "emulLoop", false);
 
     if (danr::StressManager::getInstance().startThermalStress(config)) {
         send_json(client_socket, "{\"success\":true,\"message\":\"Thermal stress test started\"}");
@@ -492,6 +653,10 @@ void handle_cpu_freq_status(int client_socket) {
     send_json(client_socket, "{\"success\":true,\"data\":" + status.toJson() + "}");
 }
 
+void handle_tunables_status(int client_socket) {
+    send_json(client_socket, "{\"success\":true,\"data\":" + danr::TunableArbiter::getInstance().toJson() + "}");
+}
+
 void handle_cpu_freq_set(int client_socket, const std::string& body) {
     long frequency = parse_json_long(body, "frequency", 0);
     if (frequency <= 0) {
@@ -501,22 +666,189 @@ void handle_cpu_freq_set(int client_socket, const std::string& body) {
 
     std::vector<int> cores = parse_json_int_array(body, "cores");
     long autoRestoreMs = parse_json_long(body, "autoRestoreMs", 0);
+    int policy = parse_json_int(body, "policy", -1);
+    int priority = parse_json_int(body, "priority", 0);
 
-    if (danr::CPUFreqManager::getInstance().setMaxFrequency(frequency, cores, autoRestoreMs)) {
+    if (danr::CPUFreqManager::getInstance().setMaxFrequency(frequency, cores, autoRestoreMs, policy, priority)) {
         send_json(client_socket, "{\"success\":true,\"message\":\"CPU frequency set\"}");
     } else {
         send_json(client_socket, "{\"success\":false,\"error\":\"Failed to set CPU frequency\"}");
     }
 }
 
-void handle_cpu_freq_restore(int client_socket) {
-    if (danr::CPUFreqManager::getInstance().restore()) {
+void handle_cpu_freq_restore(int client_socket, const std::string& body) {
+    int policy = parse_json_int(body, "policy", -1);
+    if (danr::CPUFreqManager::getInstance().restore(policy)) {
         send_json(client_socket, "{\"success\":true,\"message\":\"CPU frequency restored\"}");
     } else {
         send_json(client_socket, "{\"success\":false,\"error\":\"Failed to restore CPU frequency\"}");
     }
 }
 
+void handle_cpu_cores_status(int client_socket) {
+    danr::CpusetLimitStatus status = danr::CpusetLimiter::getInstance().getStatus();
+    send_json(client_socket, "{\"success\":true,\"data\":" + status.toJson() + "}");
+}
+
+void handle_cpu_cores_set(int client_socket, const std::string& body) {
+    danr::CpusetLimitConfig config;
+    config.cores = parse_json_int(body, "cores", 0);
+    config.preferBig = parse_json_bool(body, "preferBig", false);
+    config.cpus = parse_json_int_array(body, "cpus");
+    config.priority = parse_json_int(body, "priority", 0);
+
+    // Comma separated, e.g. "top-app,foreground"
+    std::istringstream groups(parse_json_string(body, "groups", ""));
+    std::string group;
+    while (std::getline(groups, group, ',')) {
+        if (!group.empty()) config.groups.push_back(group);
+    }
+
+    if (danr::CpusetLimiter::getInstance().limit(config)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Cpusets limited\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to limit cpusets (no cpuset hierarchy, unknown group or invalid core count?)\"}");
+    }
+}
+
+void handle_cpu_cores_restore(int client_socket) {
+    if (danr::CpusetLimiter::getInstance().restore()) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Cpusets restored\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to restore cpusets\"}");
+    }
+}
+
+danr::CpuIdleConfig parse_cpu_idle_config(const std::string& body) {
+    danr::CpuIdleConfig config;
+    config.cores = parse_json_int_array(body, "cores");
+    config.policy = parse_json_int(body, "policy", -1);
+    config.states = parse_json_int_array(body, "states");
+    config.minLatencyUs = parse_json_long(body, "minLatencyUs", 0);
+    config.disable = parse_json_bool(body, "disable", true);
+    config.priority = parse_json_int(body, "priority", 0);
+    return config;
+}
+
+void handle_cpu_idle_status(int client_socket) {
+    danr::CpuIdleStatus status = danr::CpuIdleController::getInstance().getStatus();
+    send_json(client_socket, "{\"success\":true,\"data\":" + status.toJson() + "}");
+}
+
+void handle_cpu_idle_set(int client_socket, const std::string& body) {
+    if (danr::CpuIdleController::getInstance().set(parse_cpu_idle_config(body))) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Idle states set\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to set idle states (none matched?)\"}");
+    }
+}
+
+void handle_cpu_idle_restore(int client_socket, const std::string& body) {
+    if (danr::CpuIdleController::getInstance().restore(parse_cpu_idle_config(body))) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Idle states restored\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to restore idle states\"}");
+    }
+}
+
+// ============================================================================
+// Governor and devfreq API Handlers
+// ============================================================================
+
+void handle_governor_status(int client_socket) {
+    danr::GovernorStatus status = danr::GovernorTuner::getInstance().getStatus();
+    send_json(client_socket, "{\"success\":true,\"data\":" + status.toJson() + "}");
+}
+
+void handle_governor_cpu_set(int client_socket, const std::string& body) {
+    danr::GovernorTunables tunables;
+    tunables.governor = parse_json_string(body, "governor", "");
+    tunables.rateLimitUs = parse_json_long(body, "rateLimitUs", -1);
+    tunables.upRateLimitUs = parse_json_long(body, "upRateLimitUs", -1);
+    tunables.downRateLimitUs = parse_json_long(body, "downRateLimitUs", -1);
+    tunables.minFrequency = parse_json_long(body, "minFrequency", 0);
+    int policy = parse_json_int(body, "policy", -1);
+    int priority = parse_json_int(body, "priority", 0);
+
+    if (danr::GovernorTuner::getInstance().tunePolicies(tunables, policy, priority)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"CPU governor tuned\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to apply some CPU governor settings\"}");
+    }
+}
+
+void handle_governor_cpu_restore(int client_socket, const std::string& body) {
+    int policy = parse_json_int(body, "policy", -1);
+    if (danr::GovernorTuner::getInstance().restorePolicies(policy)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"CPU governor restored\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to restore CPU governor\"}");
+    }
+}
+
+void handle_governor_devfreq_set(int client_socket, const std::string& body) {
+    danr::DevfreqTunables tunables;
+    tunables.governor = parse_json_string(body, "governor", "");
+    tunables.minFrequency = parse_json_long(body, "minFrequency", 0);
+    tunables.maxFrequency = parse_json_long(body, "maxFrequency", 0);
+    std::string device = parse_json_string(body, "device", "");
+    int priority = parse_json_int(body, "priority", 0);
+
+    if (danr::GovernorTuner::getInstance().tuneDevfreq(tunables, device, priority)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Devfreq tuned\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to apply some devfreq settings (unknown device?)\"}");
+    }
+}
+
+void handle_governor_devfreq_restore(int client_socket, const std::string& body) {
+    std::string device = parse_json_string(body, "device", "");
+    if (danr::GovernorTuner::getInstance().restoreDevfreq(device)) {
+        send_json(client_socket, "{\"success\":true,\"message\":\"Devfreq restored\"}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Failed to restore devfreq\"}");
+    }
+}
+
+// ============================================================================
+// Device Profile API Handlers
+// ============================================================================
+
+void handle_profiles(int client_socket) {
+    send_json(client_socket, "{\"success\":true,\"data\":" + danr::DeviceProfileManager::getInstance().toJson() + "}");
+}
+
+void handle_profile_apply(int client_socket, const std::string& body) {
+    danr::DeviceProfileConfig config;
+    config.name = parse_json_string(body, "name", "");
+    config.durationMs = parse_json_long(body, "durationMs", 1800000);
+    config.memoryMB = parse_json_int(body, "memoryMB", 0);
+    config.cores = parse_json_int(body, "cores", 0);
+    config.maxFreqKHz = parse_json_long(body, "maxFreqKHz", 0);
+    config.storageMBps = parse_json_int(body, "storageMBps", 0);
+    config.readAheadKB = parse_json_int(body, "readAheadKB", 0);
+    config.memory = parse_json_bool(body, "memory", true);
+    config.cpu = parse_json_bool(body, "cpu", true);
+    config.storage = parse_json_bool(body, "storage", true);
+
+    danr::DeviceProfileManager& manager = danr::DeviceProfileManager::getInstance();
+    bool success = manager.apply(config);
+    danr::DeviceProfileStatus status = manager.getStatus();
+    if (success) {
+        send_json(client_socket, "{\"success\":true,\"data\":" + status.toJson() + "}");
+    } else if (status.isActive) {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Profile applied in part, see errors\",\"data\":" +
+                  status.toJson() + "}");
+    } else {
+        send_json(client_socket, "{\"success\":false,\"error\":\"Unknown profile or invalid duration\"}");
+    }
+}
+
+void handle_profile_stop(int client_socket) {
+    danr::DeviceProfileManager::getInstance().stop();
+    send_json(client_socket, "{\"success\":true,\"message\":\"Profile stopped\"}");
+}
+
 void* handle_client(void* arg) {
     int client_socket = *(int*)arg;
     free(arg);
@@ -563,6 +895,16 @@ void* handle_client(void* arg) {
             handle_stress_status(client_socket);
         } else if (strcmp(path, "/api/cpu/freq/status") == 0) {
             handle_cpu_freq_status(client_socket);
+        } else if (strcmp(path, "/api/cpu/cores/status") == 0) {
+            handle_cpu_cores_status(client_socket);
+        } else if (strcmp(path, "/api/cpu/idle/status") == 0) {
+            handle_cpu_idle_status(client_socket);
+        } else if (strcmp(path, "/api/profiles") == 0) {
+            handle_profiles(client_socket);
+        } else if (strcmp(path, "/api/tunables") == 0) {
+            handle_tunables_status(client_socket);
+        } else if (strcmp(path, "/api/governor/status") == 0) {
+            handle_governor_status(client_socket);
         } else if (strncmp(path, "/style.css", 10) == 0) {
             std::string css = read_file((std::string(WEB_ROOT) + "/style.css").c_str());
             if (!css.empty()) {
@@ -599,6 +941,10 @@ void* handle_client(void* arg) {
             handle_stress_network_start(client_socket, body);
         } else if (strcmp(path, "/api/stress/network/stop") == 0) {
             handle_stress_network_stop(client_socket);
+        } else if (strcmp(path, "/api/stress/traffic/start") == 0) {
+            handle_stress_traffic_start(client_socket, body);
+        } else if (strcmp(path, "/api/stress/traffic/stop") == 0) {
+            handle_stress_traffic_stop(client_socket);
         } else if (strcmp(path, "/api/stress/thermal/start") == 0) {
             handle_stress_thermal_start(client_socket, body);
         } else if (strcmp(path, "/api/stress/thermal/stop") == 0) {
@@ -608,7 +954,27 @@ void* handle_client(void* arg) {
         } else if (strcmp(path, "/api/cpu/freq/set") == 0) {
             handle_cpu_freq_set(client_socket, body);
         } else if (strcmp(path, "/api/cpu/freq/restore") == 0) {
-            handle_cpu_freq_restore(client_socket);
+            handle_cpu_freq_restore(client_socket, body);
+        } else if (strcmp(path, "/api/cpu/cores/set") == 0) {
+            handle_cpu_cores_set(client_socket, body);
+        } else if (strcmp(path, "/api/cpu/cores/restore") == 0) {
+            handle_cpu_cores_restore(client_socket);
+        } else if (strcmp(path, "/api/cpu/idle/set") == 0) {
+            handle_cpu_idle_set(client_socket, body);
+        } else if (strcmp(path, "/api/cpu/idle/restore") == 0) {
+            handle_cpu_idle_restore(client_socket, body);
+        } else if (strcmp(path, "/api/profiles/apply") == 0) {
+            handle_profile_apply(client_socket, body);
+        } else if (strcmp(path, "/api/profiles/stop") == 0) {
+            handle_profile_stop(client_socket);
+        } else if (strcmp(path, "/api/governor/cpu/set") == 0) {
+            handle_governor_cpu_set(client_socket, body);
+        } else if (strcmp(path, "/api/governor/cpu/restore") == 0) {
+            handle_governor_cpu_restore(client_socket, body);
+        } else if (strcmp(path, "/api/governor/devfreq/set") == 0) {
+            handle_governor_devfreq_set(client_socket, body);
+        } else if (strcmp(path, "/api/governor/devfreq/restore") == 0) {
+            handle_governor_devfreq_restore(client_socket, body);
         } else {
             send_404(client_socket);
         }
@@ -640,6 +1006,13 @@ int main() {
 
     LOGD("Starting DANR configuration web server on port %d", PORT);
 
+    // A previous instance may have been killed mid test. Put back the CPU,
+    // governor, devfreq, cpuset, cpuidle, thermal and VM settings and root
+    // qdiscs it changed, and tear down its ingress redirect: one to a
+    // missing IFB would drop all received traffic.
+    danr::RestoreJournal::getInstance().replay();
+    danr::NetworkStressor::cleanupStaleIngress();
+
     int server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket < 0) {
         LOGE("Failed to create socket");
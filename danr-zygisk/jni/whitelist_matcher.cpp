@@ -0,0 +1,219 @@
+#include "whitelist_matcher.h"
+#include <algorithm>
+#include <map>
+
+namespace danr {
+
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+// Trie edge for '?', next to the 256 literal bytes
+static const int ANY_BYTE = 256;
+
+// Glob trie. A '*' hangs off its parent as an epsilon edge to a node that
+// loops on every byte; the rest of the pattern continues from that node.
+struct GlobNode {
+    std::map<int, int> next;
+    int star = -1;
+    bool loops = false;
+    bool accept = false;
+};
+
+static bool isPattern(const std::string& entry) {
+    return entry.find_first_of("*?") != std::string::npos;
+}
+
+WhitelistMatcher::WhitelistMatcher() {
+    memset(classes_, 0, sizeof(classes_));
+}
+
+WhitelistMatcher::WhitelistMatcher(const std::vector<std::string>& entries) : WhitelistMatcher() {
+    std::vector<std::string> names;
+    std::vector<std::string> patterns;
+    for (const std::string& entry : entries) {
+        if (entry.empty()) continue;
+        (isPattern(entry) ? patterns : names).push_back(entry);
+    }
+    buildHash(std::move(names));
+    buildPatterns(patterns);
+}
+
+uint32_t WhitelistMatcher::hash(const char* data, size_t length, uint32_t seed) {
+    // FNV-1a, with a murmur3 finalizer so the low bits used for the modulo
+    // depend on every byte
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < length; i++) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+void WhitelistMatcher::buildHash(std::vector<std::string> names) {
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    exactCount_ = names.size();
+    if (names.empty()) return;
+
+    seeds_.assign(std::max<size_t>(1, names.size() / 2), 0);
+    slots_.assign(names.size() + names.size() / 4 + 1, Slot{0, EMPTY_SLOT});
+
+    std::vector<std::vector<size_t>> buckets(seeds_.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        buckets[hash(names[i].data(), names[i].size(), 0) % seeds_.size()].push_back(i);
+    }
+
+    // Largest buckets first, while most slots are still free
+    std::vector<size_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<bool> taken(slots_.size(), false);
+    std::vector<size_t> placed;
+    for (size_t bucket : order) {
+        if (buckets[bucket].empty()) break;
+        for (uint32_t seed = 1; ; seed++) {
+            placed.clear();
+            for (size_t name : buckets[bucket]) {
+                size_t slot = hash(names[name].data(), names[name].size(), seed) % slots_.size();
+                if (taken[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end()) break;
+                placed.push_back(slot);
+            }
+            if (placed.size() < buckets[bucket].size()) continue;
+
+            seeds_[bucket] = seed;
+            for (size_t i = 0; i < placed.size(); i++) {
+                const std::string& name = names[buckets[bucket][i]];
+                taken[placed[i]] = true;
+                slots_[placed[i]] = Slot{static_cast<uint32_t>(keys_.size()), static_cast<uint32_t>(name.size())};
+                keys_ += name;
+            }
+            break;
+        }
+    }
+}
+
+void WhitelistMatcher::buildPatterns(const std::vector<std::string>& patterns) {
+    patternCount_ = patterns.size();
+    if (patterns.empty()) return;
+
+    std::vector<GlobNode> nodes(1);
+    bool literal[256] = {};
+    for (const std::string& pattern : patterns) {
+        int node = 0;
+        for (char c : pattern) {
+            if (c == '*') {
+                if (nodes[node].loops) continue;    // "**" is "*"
+                if (nodes[node].star < 0) {
+                    nodes[node].star = static_cast<int>(nodes.size());
+                    nodes.emplace_back();
+                    nodes.back().loops = true;
+                }
+                node = nodes[node].star;
+                continue;
+            }
+            int edge = c == '?' ? ANY_BYTE : static_cast<uint8_t>(c);
+            if (edge != ANY_BYTE) literal[edge] = true;
+            auto it = nodes[node].next.find(edge);
+            if (it == nodes[node].next.end()) {
+                it = nodes[node].next.emplace(edge, static_cast<int>(nodes.size())).first;
+                nodes.emplace_back();
+            }
+            node = it->second;
+        }
+        nodes[node].accept = true;
+    }
+
+    // Bytes that appear literally get a class each; the rest behave alike
+    std::vector<uint8_t> representatives(1, 0);
+    for (int c = 0; c < 256; c++) {
+        if (!literal[c]) continue;
+        classes_[c] = static_cast<uint8_t>(representatives.size());
+        representatives.push_back(static_cast<uint8_t>(c));
+    }
+    for (int c = 0; c < 256; c++) {
+        if (!literal[c]) {
+            representatives[0] = static_cast<uint8_t>(c);
+            break;
+        }
+    }
+    classCount_ = static_cast<uint32_t>(representatives.size());
+
+    auto close = [&nodes](std::vector<int> set) {
+        for (size_t i = 0; i < set.size(); i++) {
+            if (nodes[set[i]].star >= 0) set.push_back(nodes[set[i]].star);
+        }
+        std::sort(set.begin(), set.end());
+        set.erase(std::unique(set.begin(), set.end()), set.end());
+        return set;
+    };
+
+    // Subset construction; state 0 is the empty (dead) set
+    std::map<std::vector<int>, uint32_t> states;
+    std::vector<std::vector<int>> sets;
+    auto stateOf = [&](const std::vector<int>& set) {
+        auto it = states.find(set);
+        if (it != states.end()) return it->second;
+        uint32_t state = static_cast<uint32_t>(sets.size());
+        states.emplace(set, state);
+        sets.push_back(set);
+        bool accept = false;
+        for (int node : set) accept = accept || nodes[node].accept;
+        accepting_.push_back(accept);
+        transitions_.resize(transitions_.size() + classCount_, 0);
+        return state;
+    };
+    stateOf({});
+    stateOf(close({0}));
+
+    for (uint32_t state = 1; state < sets.size(); state++) {
+        for (uint32_t cls = 0; cls < classCount_; cls++) {
+            std::vector<int> next;
+            for (int node : sets[state]) {
+                const GlobNode& glob = nodes[node];
+                if (glob.loops) next.push_back(node);
+                auto it = glob.next.find(representatives[cls]);
+                if (it != glob.next.end()) next.push_back(it->second);
+                it = glob.next.find(ANY_BYTE);
+                if (it != glob.next.end()) next.push_back(it->second);
+            }
+            uint32_t target = stateOf(close(next));
+            transitions_[state * classCount_ + cls] = target;
+        }
+    }
+}
+
+bool WhitelistMatcher::matchesExact(const char* name, size_t length) const {
+    if (slots_.empty()) return false;
+    uint32_t seed = seeds_[hash(name, length, 0) % seeds_.size()];
+    const Slot& slot = slots_[hash(name, length, seed) % slots_.size()];
+    return slot.length == length && memcmp(keys_.data() + slot.offset, name, length) == 0;
+}
+
+bool WhitelistMatcher::matchesPattern(const char* name, size_t length, size_t packageLength) const {
+    if (transitions_.empty()) return false;
+    uint32_t state = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (i == packageLength && accepting_[state]) return true;
+        state = transitions_[state * classCount_ + classes_[static_cast<uint8_t>(name[i])]];
+        if (state == 0) return false;
+    }
+    return accepting_[state];
+}
+
+bool WhitelistMatcher::matches(const char* name, size_t length) const {
+    const char* colon = static_cast<const char*>(memchr(name, ':', length));
+    size_t packageLength = colon ? static_cast<size_t>(colon - name) : length;
+
+    if (matchesExact(name, length)) return true;
+    if (packageLength < length && matchesExact(name, packageLength)) return true;
+    return matchesPattern(name, length, packageLength);
+}
+
+} // namespace danr
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace danr {
+
+// Decides whether a process gets DANR injected. Whitelist entries are
+// exact names ("com.example.app") or globs, where '*' matches any run of
+// characters and '?' any one ("com.example.*", "com.*.debug"), so one
+// entry can cover a package family. A process name's ":suffix" names a
+// process within the package: "com.example.app:remote" matches an entry
+// for "com.example.app" as well as one for itself.
+//
+// Built once per config. Exact names go into a perfect hash and globs are
+// compiled into a DFA over their trie, so matches() is a single pass over
+// the name per structure and never allocates.
+class WhitelistMatcher {
+public:
+    WhitelistMatcher();
+    explicit WhitelistMatcher(const std::vector<std::string>& entries);
+
+    bool matches(const char* name, size_t length) const;
+    bool matches(const char* name) const { return matches(name, strlen(name)); }
+
+    size_t exactCount() const { return exactCount_; }
+    size_t patternCount() const { return patternCount_; }
+
+private:
+    // Hash and displace: a name's bucket picks the seed that sends it to
+    // its slot, chosen at build time so no two names share a slot
+    struct Slot {
+        uint32_t offset;        // Into keys_
+        uint32_t length;        // EMPTY_SLOT if unused
+    };
+
+    std::string keys_;
+    std::vector<uint32_t> seeds_;
+    std::vector<Slot> slots_;
+    size_t exactCount_ = 0;
+
+    // State 0 is dead, 1 the start. Bytes no pattern names literally share
+    // class 0, so a row is classCount_ wide rather than 256.
+    uint8_t classes_[256];
+    uint32_t classCount_ = 1;
+    std::vector<uint32_t> transitions_;     // [state * classCount_ + class]
+    std::vector<uint8_t> accepting_;
+    size_t patternCount_ = 0;
+
+    void buildHash(std::vector<std::string> names);
+    void buildPatterns(const std::vector<std::string>& patterns);
+    bool matchesExact(const char* name, size_t length) const;
+    bool matchesPattern(const char* name, size_t length, size_t packageLength) const;
+
+    static uint32_t hash(const char* data, size_t length, uint32_t seed);
+};
+
+} // namespace danr
@@ -532,7 +532,7 @@ function DeviceControlPanel({ device }: DeviceControlPanelProps) {
 
   const activeSdkStressCount = Object.values(sdkStressStatuses).filter(s => s.isRunning).length
   const activeDaemonStressCount = daemonStressStatus ?
-    [daemonStressStatus.cpu, daemonStressStatus.memory, daemonStressStatus.disk_io, daemonStressStatus.network, daemonStressStatus.thermal]
+    [daemonStressStatus.cpu, daemonStressStatus.memory, daemonStressStatus.disk_io, daemonStressStatus.network, daemonStressStatus.traffic, daemonStressStatus.thermal]
       .filter(s => s?.isRunning).length : 0
 
   return (
@@ -769,6 +769,30 @@ function DeviceControlPanel({ device }: DeviceControlPanelProps) {
                   </div>
                 </div>
 
+                {/* Per-cluster status */}
+                {(cpuFreqStatus.clusters.length > 1 || cpuFreqStatus.clusters.some((cluster) => cluster.residency)) && (
+                  <div className="space-y-2">
+                    {cpuFreqStatus.clusters.map((cluster) => (
+                      <div key={cluster.policy} className="px-3 py-2 bg-slate-50 rounded-lg border border-slate-200 text-sm">
+                        <div className="flex items-center justify-between">
+                          <span className="text-slate-600">
+                            CPU {cluster.cpus[0]}-{cluster.cpus[cluster.cpus.length - 1]}
+                          </span>
+                          <span className={cluster.isLimited ? 'font-semibold text-blue-700' : 'text-slate-900'}>
+                            {formatFrequency(cluster.actualMaxFreq)} / {formatFrequency(cluster.originalMaxFreq)}
+                          </span>
+                        </div>
+                        {cluster.residency && cluster.residency.effectiveFreq > 0 && (
+                          <div className="flex items-center justify-between text-xs text-slate-500 mt-1">
+                            <span>Ran at {formatFrequency(cluster.residency.effectiveFreq)} avg</span>
+                            <span>{cluster.residency.effectiveVsCapPercent.toFixed(0)}% of cap</span>
+                          </div>
+                        )}
+                      </div>
+                    ))}
+                  </div>
+                )}
+
                 {/* Auto-restore countdown */}
                 {cpuFreqStatus.isLimited && cpuFreqStatus.remainingRestoreMs > 0 && (
                   <div className="flex items-center gap-2 px-3 py-2 bg-amber-50 rounded-lg border border-amber-200">
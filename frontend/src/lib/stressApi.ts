@@ -13,6 +13,7 @@ export interface AllStressStatus {
   memory: StressStatus;
   disk_io: StressStatus;
   network: StressStatus;
+  traffic: StressStatus;
   thermal: StressStatus;
 }
 
@@ -25,27 +26,113 @@ export interface CPUStressConfig {
 
 export interface MemoryStressConfig {
   targetFreeMB?: number;
+  holdMB?: number;         // Hold exactly this much instead of tracking targetFreeMB
   chunkSizeMB?: number;
   durationMs?: number;
   useAnonymousMmap?: boolean;
   lockMemory?: boolean;
 }
 
+export type DiskStressMode = 'mixed' | 'data' | 'metadata' | 'writeback';
+
+export type DiskSyncMode = 'none' | 'fsync' | 'fdatasync' | 'dsync' | 'sync_file_range' | 'syncfs';
+
 export interface DiskStressConfig {
+  mode?: DiskStressMode;
   throughputMBps?: number;
+  readKBps?: number;
+  writeKBps?: number;
+  readIops?: number;
+  writeIops?: number;
+  workerCount?: number;
   chunkSizeKB?: number;
   durationMs?: number;
   testPath?: string;
   useDirectIO?: boolean;
   syncWrites?: boolean;
+  syncMode?: DiskSyncMode;
+  // Data mode
+  fileCount?: number;
+  fileSizeMB?: number;
+  readPercent?: number;
+  // Metadata mode
+  metadataFileCount?: number;
+  metadataDirCount?: number;
+  metadataFileSizeKB?: number;
+  // Writeback mode
+  dirtySetMB?: number;
+  dirtyRatio?: number;
+  dirtyBackgroundRatio?: number;
+  // Data verification
+  verify?: boolean;
+  seed?: number;
+  // Writeback latency probe
+  latencyProbe?: boolean;
+  probeIntervalMs?: number;
+}
+
+export type NetworkProfileName = '3g' | 'congested_lte' | 'flaky_wifi';
+
+export interface NetworkAppConfig {
+  packageName: string;
+  uid?: number;
+  bandwidthLimitKbps?: number;
+  latencyMs?: number;
+  jitterMs?: number;
+  packetLossPercent?: number;
+  profile?: NetworkProfileName;
 }
 
 export interface NetworkStressConfig {
   bandwidthLimitKbps?: number;
+  shaper?: 'htb' | 'tbf';
   latencyMs?: number;
   packetLossPercent?: number;
   durationMs?: number;
-  targetInterface?: string;
+  targetInterface?: string;  // Comma-separated; "auto" follows the default route
+  jitterMs?: number;
+  delayDistribution?: 'uniform' | 'normal' | 'pareto';
+  delayCorrelationPercent?: number;
+  lossCorrelationPercent?: number;
+  duplicatePercent?: number;
+  reorderPercent?: number;
+  corruptPercent?: number;
+  lossModel?: 'random' | 'gemodel';
+  geGoodToBadPercent?: number;
+  geBadToGoodPercent?: number;
+  geBadLossPercent?: number;
+  geGoodLossPercent?: number;
+  profile?: NetworkProfileName;
+  profilePath?: string;
+  profileLoop?: boolean;
+  profileUpdateMs?: number;
+  apps?: NetworkAppConfig[];
+  shapeEgress?: boolean;
+  shapeIngress?: boolean;
+  downlinkBandwidthLimitKbps?: number;
+  downlinkLatencyMs?: number;
+  downlinkJitterMs?: number;
+  downlinkPacketLossPercent?: number;
+  downlinkProfile?: NetworkProfileName;
+  // Active verification; observed values and qdisc counters appear in the status
+  probe?: boolean;
+  probeTarget?: string;      // IPv4 echo target, defaults to the gateway
+  probePort?: number;        // UDP echo port, 0 = ICMP
+  probeIntervalMs?: number;
+  probeApp?: string;         // Per-app mode: package whose class is probed
+}
+
+export interface TrafficStressConfig {
+  protocol?: 'udp' | 'tcp';
+  flowCount?: number;
+  packetSize?: number;
+  rateMbps?: number;  // 0 = unpaced
+  batchSize?: number;
+  durationMs?: number;
+  useBuiltinSink?: boolean;
+  sinkAddress?: string;
+  sinkPort?: number;
+  idleConnections?: number;
 }
 
 export interface ThermalStressConfig {
@@ -53,13 +140,84 @@ export interface ThermalStressConfig {
   maxFrequencyPercent?: number;
   forceAllCoresOnline?: boolean;
   durationMs?: number;
+  priority?: number;       // Against other controllers' settings, e.g. a CPU frequency limit
+  // Closed-loop heating to a zone temperature; 0/unset = off
+  targetTempC?: number;
+  zone?: string;           // thermal_zoneN, id or type; default: skin sensor
+  heatThreads?: number;    // 0 = one per core
+  heatMemory?: boolean;    // Also drive memory bandwidth
+  kp?: number;
+  ki?: number;
+  kd?: number;
+  // Zone emulation through emul_temp; exclusive with targetTempC
+  emulZones?: string;      // Comma-separated zone specs or "all"
+  emulTempC?: number;      // Constant temperature when there is no ramp
+  emulRamp?: string;       // "timeMs:tempC,...", e.g. "0:35,60000:55"
+  emulLoop?: boolean;
 }
 
 // CPU Frequency Control types
 export interface CPUFreqConfig {
   frequency: number;
-  cores?: number[];
+  cores?: number[];        // Limits the whole cluster each core belongs to
+  policy?: number;         // Only this cpufreq policy (cluster)
   autoRestoreMs?: number;  // 0 = no auto-restore (default)
+  priority?: number;       // Against other controllers' caps; equal priority = lowest cap wins
+}
+
+export interface CPUFreqClusterStatus {
+  policy: number;
+  cpus: number[];
+  isLimited: boolean;
+  targetMaxFreq: number;   // Snapped to this cluster's frequency table
+  actualMaxFreq: number;
+  originalMaxFreq: number;
+  availableFreqs: number[];
+  // Changes made by someone else (thermal HAL, PerfHAL) while limited
+  overrides: number;
+  overridesSeenByWatch: number;
+  overridesSeenByPoll: number;
+  lastOverrideFreq: number;
+  lastOverrideMs: number;  // Epoch ms, 0 = none yet
+  avgOverrideMs: number;   // How long an override stood before re-applying
+  maxOverrideMs: number;
+  // Frequencies actually run at since the cluster was limited, null if never
+  residency: FreqResidency | null;
+}
+
+export interface FreqResidencyBucket {
+  freq: number;  // kHz
+  ms: number;
+}
+
+export interface FreqResidency {
+  elapsedMs: number;
+  source: 'time_in_state' | 'sampled' | '';
+  effectiveFreq: number;          // Time-weighted mean kHz
+  meanCapFreq: number;            // Time-weighted mean scaling_max_freq
+  effectiveVsCapPercent: number;
+  atCapPercent: number;
+  transitions: number;            // -1 = stats/total_trans unavailable
+  samples: number;
+  timeInState: FreqResidencyBucket[];
+  curFreqHistogram: FreqResidencyBucket[];
+}
+
+// A system setting several controllers may hold at once. Holders at the
+// highest priority decide; among them caps combine by min, floors by max,
+// anything else by the latest request.
+export interface TunableHolder {
+  owner: string;     // "cpufreq", "governor", "cpuset", "cpuidle", "profile", "thermal", "disk"
+  value: string;
+  priority: number;
+}
+
+export interface TunableStatus {
+  path: string;
+  combine: 'min' | 'max' | 'override';
+  baseline: string;  // Restored when the last holder releases
+  effective: string;
+  holders: TunableHolder[];
 }
 
 export interface CPUFreqStatus {
@@ -71,6 +229,153 @@ export interface CPUFreqStatus {
   availableFreqs: number[];
   autoRestoreMs: number;
   remainingRestoreMs: number;
+  enforcement: 'watch' | 'poll';
+  pollIntervalMs: number;  // Current fallback interval, adaptive
+  clusters: CPUFreqClusterStatus[];
+}
+
+// Core count emulation through cpusets
+export interface CpusetLimitConfig {
+  cores?: number;            // Keep this many cores, the slowest unless preferBig
+  preferBig?: boolean;
+  cpus?: number[];           // Or exactly these
+  groups?: string;           // Comma separated, default 'top-app,foreground,background'
+  priority?: number;
+}
+
+export interface CpusetGroupStatus {
+  name: string;
+  cpus: string;              // cpulist format, e.g. '0-3'
+  isLimited: boolean;
+}
+
+export interface CpusetLimitStatus {
+  isLimited: boolean;
+  hierarchy: 'v1' | 'v2' | '';
+  totalCores: number;
+  cpus: number[];
+  groups: CpusetGroupStatus[];
+}
+
+// cpuidle state control. States are picked by index, or by exit latency:
+// minLatencyUs picks every state at least that slow to leave.
+export interface CpuIdleConfig {
+  cores?: number[];          // Default all, unless policy is set
+  policy?: number;           // Every core of this cpufreq policy
+  states?: number[];
+  minLatencyUs?: number;
+  disable?: boolean;         // Default true
+  priority?: number;
+}
+
+// Counters are deltas over the window since the last set or restore
+export interface CpuIdleStateStatus {
+  index: number;
+  name: string;
+  latencyUs: number;         // Exit latency
+  residencyUs: number;       // Target residency
+  disabled: boolean;
+  isHeld: boolean;
+  usage: number;
+  timeUs: number;
+  above: number;             // Woken before the target residency, -1 = not reported
+  below: number;             // A deeper state would have paid off, -1 = not reported
+  avgResidencyUs: number;
+}
+
+export interface CpuIdleStatus {
+  driver: string;
+  governor: string;
+  windowMs: number;
+  cores: { cpu: number; states: CpuIdleStateStatus[] }[];
+}
+
+// Low-end device profiles. Config fields left out take the profile's values.
+export interface DeviceProfile {
+  name: string;
+  description: string;
+  memoryMB: number;          // MemTotal the device would report
+  cores: number;
+  maxFreqKHz: number;
+  storageMBps: number;       // Sequential read bandwidth
+  readAheadKB: number;
+}
+
+export interface DeviceProfileConfig {
+  name: string;
+  durationMs?: number;       // Default 30 minutes
+  memoryMB?: number;
+  cores?: number;
+  maxFreqKHz?: number;
+  storageMBps?: number;
+  readAheadKB?: number;
+  memory?: boolean;          // Which parts to apply, default all
+  cpu?: boolean;
+  storage?: boolean;
+}
+
+export interface DeviceProfileStatus {
+  isActive: boolean;
+  profile: string;
+  remainingMs: number;
+  hostMemTotalMB: number;
+  hostCores: number;
+  hostReadMBps: number;      // Storage probe, 0 if not run
+  hostWriteMBps: number;
+  holdMB: number;            // Memory the profile takes away
+  heldMB: number;            // So far; less if MemAvailable ran out
+  cpus: number[];            // Cores kept
+  maxFreqKHz: number;
+  contentionMBps: number;    // Direct reads taking up the difference
+  readAheadKB: number;
+  errors: string[];          // Parts that couldn't be applied
+}
+
+// Governor and devfreq tuning types. Fields left out aren't touched.
+export interface GovernorTuningConfig {
+  policy?: number;           // Only this cpufreq policy, default all
+  governor?: string;         // e.g. 'schedutil', 'powersave'
+  rateLimitUs?: number;      // schedutil rate_limit_us (or both halves of the up/down pair)
+  upRateLimitUs?: number;
+  downRateLimitUs?: number;
+  minFrequency?: number;     // scaling_min_freq floor, kHz
+  priority?: number;
+}
+
+export interface DevfreqTuningConfig {
+  device?: string;           // Substring of the device name, e.g. 'ddr', 'gpu'; default all
+  governor?: string;
+  minFrequency?: number;     // Hz, snapped to the device's table
+  maxFrequency?: number;     // Hz
+  priority?: number;
+}
+
+export interface GovernorPolicyStatus {
+  policy: number;
+  governor: string;
+  availableGovernors: string[];
+  rateLimitUs: number;       // -1 = not a tunable of the active governor
+  upRateLimitUs: number;
+  downRateLimitUs: number;
+  minFreq: number;
+  maxFreq: number;
+  isTuned: boolean;
+}
+
+export interface DevfreqDeviceStatus {
+  name: string;
+  governor: string;
+  availableGovernors: string[];
+  curFreq: number;           // Hz
+  minFreq: number;
+  maxFreq: number;
+  availableFreqs: number[];
+  isTuned: boolean;
+}
+
+export interface GovernorStatus {
+  policies: GovernorPolicyStatus[];
+  devices: DevfreqDeviceStatus[];
 }
 
 // Configuration types
@@ -242,6 +547,26 @@ class StressApiClient {
     }
   }
 
+  // Traffic generator
+  async startTraffic(config: TrafficStressConfig = {}): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/stress/traffic/start', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to start traffic stress');
+    }
+  }
+
+  async stopTraffic(): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/stress/traffic/stop', {
+      method: 'POST',
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to stop traffic stress');
+    }
+  }
+
   // Thermal stress
   async startThermal(config: ThermalStressConfig = {}): Promise<void> {
     const response = await this.request<ApiResponse>('/api/stress/thermal/start', {
@@ -338,14 +663,161 @@ class StressApiClient {
     }
   }
 
-  async restoreCpuFrequency(): Promise<void> {
+  async getTunables(): Promise<TunableStatus[]> {
+    const response = await this.request<{ success: boolean; data?: { tunables: TunableStatus[] }; error?: string }>('/api/tunables');
+    if (!response.success || !response.data) {
+      throw new Error(response.error || 'Failed to get tunables');
+    }
+    return response.data.tunables;
+  }
+
+  async restoreCpuFrequency(policy?: number): Promise<void> {
     const response = await this.request<ApiResponse>('/api/cpu/freq/restore', {
       method: 'POST',
+      body: JSON.stringify(policy === undefined ? {} : { policy }),
     });
     if (!response.success) {
       throw new Error(response.error || 'Failed to restore CPU frequency');
     }
   }
+
+  // Core count emulation
+  async getCpuCoresStatus(): Promise<CpusetLimitStatus> {
+    const response = await this.request<{ success: boolean; data?: CpusetLimitStatus; error?: string }>('/api/cpu/cores/status');
+    if (!response.success || !response.data) {
+      throw new Error(response.error || 'Failed to get cpuset status');
+    }
+    return response.data;
+  }
+
+  async limitCpuCores(config: CpusetLimitConfig): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/cpu/cores/set', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to limit cpusets');
+    }
+  }
+
+  async restoreCpuCores(): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/cpu/cores/restore', {
+      method: 'POST',
+      body: JSON.stringify({}),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to restore cpusets');
+    }
+  }
+
+  // cpuidle state control
+  async getCpuIdleStatus(): Promise<CpuIdleStatus> {
+    const response = await this.request<{ success: boolean; data?: CpuIdleStatus; error?: string }>('/api/cpu/idle/status');
+    if (!response.success || !response.data) {
+      throw new Error(response.error || 'Failed to get cpuidle status');
+    }
+    return response.data;
+  }
+
+  async setCpuIdleStates(config: CpuIdleConfig): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/cpu/idle/set', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to set idle states');
+    }
+  }
+
+  async restoreCpuIdleStates(config: Pick<CpuIdleConfig, 'cores' | 'policy'> = {}): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/cpu/idle/restore', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to restore idle states');
+    }
+  }
+
+  // Low-end device profiles
+  async getProfiles(): Promise<{ profiles: DeviceProfile[]; status: DeviceProfileStatus }> {
+    const response = await this.request<{ success: boolean; data?: { profiles: DeviceProfile[]; status: DeviceProfileStatus }; error?: string }>('/api/profiles');
+    if (!response.success || !response.data) {
+      throw new Error(response.error || 'Failed to get profiles');
+    }
+    return response.data;
+  }
+
+  async applyProfile(config: DeviceProfileConfig): Promise<DeviceProfileStatus> {
+    const response = await this.request<{ success: boolean; data?: DeviceProfileStatus; error?: string }>('/api/profiles/apply', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success || !response.data) {
+      const errors = response.data?.errors.join(', ');
+      throw new Error((response.error || 'Failed to apply profile') + (errors ? `: ${errors}` : ''));
+    }
+    return response.data;
+  }
+
+  async stopProfile(): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/profiles/stop', {
+      method: 'POST',
+      body: JSON.stringify({}),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to stop profile');
+    }
+  }
+
+  // Governor and devfreq tuning
+  async getGovernorStatus(): Promise<GovernorStatus> {
+    const response = await this.request<{ success: boolean; data?: GovernorStatus; error?: string }>('/api/governor/status');
+    if (!response.success || !response.data) {
+      throw new Error(response.error || 'Failed to get governor status');
+    }
+    return response.data;
+  }
+
+  async tuneCpuGovernor(config: GovernorTuningConfig): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/governor/cpu/set', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to tune CPU governor');
+    }
+  }
+
+  async restoreCpuGovernor(policy?: number): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/governor/cpu/restore', {
+      method: 'POST',
+      body: JSON.stringify(policy === undefined ? {} : { policy }),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to restore CPU governor');
+    }
+  }
+
+  async tuneDevfreq(config: DevfreqTuningConfig): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/governor/devfreq/set', {
+      method: 'POST',
+      body: JSON.stringify(config),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to tune devfreq');
+    }
+  }
+
+  async restoreDevfreq(device?: string): Promise<void> {
+    const response = await this.request<ApiResponse>('/api/governor/devfreq/restore', {
+      method: 'POST',
+      body: JSON.stringify(device === undefined ? {} : { device }),
+    });
+    if (!response.success) {
+      throw new Error(response.error || 'Failed to restore devfreq');
+    }
+  }
 }
 
 export const stressApi = new StressApiClient();